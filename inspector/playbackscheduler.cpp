@@ -0,0 +1,93 @@
+#include "playbackscheduler.h"
+#include "renderer.h"
+#include "acstrace.h"
+
+#include <QCoreApplication>
+#include <QPointer>
+
+// Deadlines this close after the earliest one share its tick, frame
+// durations are whole hundredths so nothing shows visibly early
+#define SCHEDULER_COALESCE_MS 4
+
+PlaybackScheduler *PlaybackScheduler::instance()
+{
+    static QPointer<PlaybackScheduler> scheduler;
+    if(!scheduler)
+        scheduler = new PlaybackScheduler(QCoreApplication::instance());
+    return scheduler;
+}
+
+PlaybackScheduler::PlaybackScheduler(QObject *parent)
+    : QObject(parent)
+    , m_scheduler(SCHEDULER_COALESCE_MS)
+{
+    m_clock.start();
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &PlaybackScheduler::tick);
+}
+
+PlaybackScheduler::Client PlaybackScheduler::attach(CharacterWindow *window)
+{
+    Client client = m_scheduler.Add();
+    if(client >= static_cast<Client>(m_windows.size()))
+        m_windows.resize(client + 1);
+    m_windows[client] = window;
+    return client;
+}
+
+void PlaybackScheduler::detach(Client client)
+{
+    if(client >= static_cast<Client>(m_windows.size()))
+        return;
+    m_windows[client] = nullptr;
+    m_scheduler.Remove(client);
+}
+
+qint64 PlaybackScheduler::now() const
+{
+    return m_clock.elapsed();
+}
+
+void PlaybackScheduler::schedule(Client client, qint64 deadline)
+{
+    m_scheduler.Schedule(client, static_cast<uint64_t>(qMax<qint64>(deadline, 0)));
+    if(!m_ticking && (m_armed < 0 || deadline < m_armed))
+        rearm();
+}
+
+void PlaybackScheduler::cancel(Client client)
+{
+    m_scheduler.Schedule(client, libacsfile::FrameScheduler::Never);
+}
+
+void PlaybackScheduler::tick()
+{
+    ACS_TRACE_SCOPE("playback", "PlaybackScheduler::tick");
+    // everything due by the end of the window moves to that instant, the
+    // windows only call update() so their paints are merged afterwards
+    const qint64 current = now();
+    const qint64 tickTime = current + SCHEDULER_COALESCE_MS;
+    m_due.clear();
+    m_scheduler.TakeDue(static_cast<uint64_t>(current), m_due);
+    m_ticking = true;
+    for(Client client : m_due)
+        if(client < static_cast<Client>(m_windows.size()) && m_windows[client])
+            m_windows[client]->advancePlayback(tickTime);
+    m_ticking = false;
+    rearm();
+}
+
+void PlaybackScheduler::rearm()
+{
+    const uint64_t next = m_scheduler.NextWakeup();
+    if(next == libacsfile::FrameScheduler::Never)
+    {
+        m_timer.stop();
+        m_armed = -1;
+        return;
+    }
+
+    m_armed = static_cast<qint64>(next);
+    m_timer.start(static_cast<int>(qMax<qint64>(m_armed - now(), 0)));
+}
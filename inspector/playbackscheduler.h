@@ -0,0 +1,40 @@
+#pragma once
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+
+#include <vector>
+#include <acsscheduler.h>
+
+class CharacterWindow;
+
+// Wakes every character window from one timer. Windows register their
+// next frame deadline, the ones due within a few milliseconds of each
+// other advance in the same tick and repaint together afterwards.
+class PlaybackScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    typedef libacsfile::FrameScheduler::Client Client;
+    static PlaybackScheduler* instance();
+
+    Client attach(CharacterWindow *window);
+    void detach(Client client);
+    // Milliseconds on the clock shared by all windows
+    qint64 now() const;
+    void schedule(Client client, qint64 deadline);
+    void cancel(Client client);
+private:
+    explicit PlaybackScheduler(QObject *parent = nullptr);
+    void tick();
+    void rearm();
+
+    libacsfile::FrameScheduler m_scheduler;
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+    qint64 m_armed = -1;
+    bool m_ticking = false;
+    QVector<CharacterWindow*> m_windows;
+    std::vector<Client> m_due;
+};
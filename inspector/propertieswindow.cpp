@@ -1,10 +1,15 @@
 #include "propertieswindow.h"
 #include "renderer.h"
+#include "acsgif.h"
 
+#include <QApplication>
 #include <QVBoxLayout>
 #include <QListWidget>
 #include <QCloseEvent>
 #include <QLabel>
+#include <QDir>
+#include <QFileDialog>
+#include <QMessageBox>
 
 PropertiesWindow::PropertiesWindow(const QString &filename, QWidget *parent)
     : QDialog(parent)
@@ -61,6 +66,48 @@ QString PropertiesWindow::getLastError() const
     return QString();
 }
 
+void PropertiesWindow::exportGIF()
+{
+    if(!isLoaded())
+        return;
+
+    auto character = m_render->Character();
+    QList<QPair<QString, QString>> exports;
+    if(auto item = m_animationList->currentItem())
+    {
+        auto fn = QFileDialog::getSaveFileName(this, tr("Export GIF"), QDir::home().filePath(item->text() + ".gif"),
+                                               tr("GIF Images (*.gif)"));
+        if(fn.isEmpty())
+            return;
+        exports.append(qMakePair(item->text(), fn));
+    }
+    else
+    {
+        auto dir = QFileDialog::getExistingDirectory(this, tr("Export All Animations as GIF"), QDir::homePath());
+        if(dir.isEmpty())
+            return;
+        for(auto &name : character->AnimationNames())
+            exports.append(qMakePair(QString::fromStdString(name),
+                                     QDir(dir).filePath(QString::fromStdString(name) + ".gif")));
+    }
+
+    // frames are encoded on every core, the same seed always picks the
+    // same branches
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QStringList failed;
+    for(auto &[name, fn] : exports)
+    {
+        std::string animationName = name.toStdString();
+        auto animation = character->GetAnimation(animationName);
+        if(!animation || !libacsrender::WriteGIF(*character, *animation, fn.toStdString()))
+            failed.append(fn);
+    }
+    QApplication::restoreOverrideCursor();
+
+    if(!failed.isEmpty())
+        QMessageBox::critical(this, tr("Export GIF"), tr("Could not write %1").arg(failed.join(", ")));
+}
+
 void PropertiesWindow::closeEvent(QCloseEvent *event)
 {
     if(!m_hiding)
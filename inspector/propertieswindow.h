@@ -14,6 +14,9 @@ public:
     PropertiesWindow(const QString &filename, QWidget *parent = nullptr);
     bool isLoaded();
     QString getLastError() const;
+public slots:
+    // The selected animation, or every one into a folder without a selection
+    void exportGIF();
 protected:
     void closeEvent(QCloseEvent *event) override;
 private:
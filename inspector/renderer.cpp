@@ -1,12 +1,20 @@
 #include "renderer.h"
+#include "playbackscheduler.h"
+#include "acstrace.h"
+#include "acsrender.h"
+#include "acsframecache.h"
+#include "acsprefetcher.h"
+#include "acsplayer.h"
 
 #include <QMouseEvent>
 #include <QPaintEvent>
 #include <QPainter>
 #include <QImage>
-#include <QTimer>
 #include <QRgb>
 #include <QUuid>
+#include <QPointer>
+#include <QBuffer>
+#include <QAudioFormat>
 #include <random>
 
 #if QT_VERSION >= 0x060200
@@ -28,6 +36,20 @@ typedef QtAudioOutput AudioSink;
 using namespace std;
 using namespace libacsfile;
 
+// Composited frames kept per character, about 170 frames at 320x300
+#define FRAME_CACHE_BYTES (64 * 1024 * 1024)
+// Frames ahead composited while the shown one plays, and the chance in
+// percent of reaching one below which it is left for drawFrame
+#define PREFETCH_DEPTH 3
+#define PREFETCH_MIN_PROBABILITY 10
+// Frames whose time passed while the window was busy are skipped so the
+// animation stays on time with its sounds, see PlayerOptions
+#define LATE_FRAME_POLICY libacsfile::PlayerOptions::Skip
+// While one of the character's sounds plays, its frames follow how much
+// of the sound the audio device has consumed instead of the wall clock,
+// see CharacterWindow::setAudioClockEnabled
+#define AUDIO_CLOCK_SYNC true
+
 #define CHAR_LOG(a) qDebug() << QString("[R:%1] %2 %3") \
                         .arg(__LINE__) \
                         .arg(QString::fromStdString(d_ptr->m_char->Name())) \
@@ -42,17 +64,23 @@ using namespace libacsfile;
 class CharacterWindowPrivate {
 public:
     libacsfile::Character *m_char = nullptr;
-    libacsfile::Animation *m_currentAnimation = nullptr;
-    QList<libacsfile::Animation*> m_animationQueue;
+    // playback state, the shared scheduler calls back at the player's
+    // next deadline. m_lastTick is the scheduler time of the last step.
+    QScopedPointer<libacsfile::AnimationPlayer> m_player;
+    PlaybackScheduler::Client m_schedulerClient = 0;
+    qint64 m_lastTick = 0;
+    // the sink of the sound started last and the player time its first
+    // sample belongs to, the player follows it while it is active
+    bool m_audioClock = AUDIO_CLOCK_SYNC;
+    QPointer<AudioSink> m_clockSink;
+    uint64_t m_clockStart = 0;
 
     bool m_dragging = false;
-    bool m_animating = false;
     QPoint m_dragPosition;
-    QImage currentFrame;
-    bool m_hasAnimation = false;
-    bool m_stopRequested = false;
-    uint m_frame = 0;
-    QString m_doNextAfterReverse{};
+    QScopedPointer<libacsrender::Compositor> m_compositor;
+    QScopedPointer<libacsrender::FrameCache> m_frameCache;
+    // declared after the cache so it stops before the cache goes away
+    QScopedPointer<libacsrender::FramePrefetcher> m_prefetcher;
 
     bool m_idle = false;
 };
@@ -62,24 +90,54 @@ CharacterWindow::CharacterWindow(const QString &filename, QWidget *parent)
     , d_ptr(new CharacterWindowPrivate)
 {
     d_ptr->m_char = new libacsfile::Character();
+    std::random_device rd;
+    libacsfile::PlayerOptions playerOptions;
+    playerOptions.Late = LATE_FRAME_POLICY;
+    d_ptr->m_player.reset(new libacsfile::AnimationPlayer((static_cast<uint64_t>(rd()) << 32) | rd(),
+                                                          playerOptions));
+    d_ptr->m_schedulerClient = PlaybackScheduler::instance()->attach(this);
+    d_ptr->m_lastTick = PlaybackScheduler::instance()->now();
     if(parent == nullptr)
     {
         setAttribute(Qt::WA_TranslucentBackground);
         setWindowFlags(Qt::WindowStaysOnTopHint | Qt::FramelessWindowHint | Qt::Window);
     }
 
-    if(d_ptr->m_char->Load(filename.toStdString()))
+    libacsfile::LoadOptions options;
+    options.DeduplicateImages = true;
+    options.BuildTransparentRuns = true;
+    options.DeltaEncodeImages = true;
+    if(d_ptr->m_char->Load(filename.toStdString(), options))
     {
         CHAR_LOG("Loaded");
+        CHAR_LOG(QString("Image deduplication saved %1 bytes")
+                     .arg(QString::number(d_ptr->m_char->DeduplicatedBytes())));
+        auto stats = d_ptr->m_char->Stats();
+        CHAR_LOG(QString("Load took %1 us (images %2 us, decode %3 us), %4 allocations, %5 bytes")
+                     .arg(stats.TotalTime / 1000)
+                     .arg((stats.ImageReadTime + stats.ImageDecodeTime) / 1000)
+                     .arg(stats.ImageDecodeTime / 1000)
+                     .arg(stats.Allocations)
+                     .arg(stats.AllocatedBytes));
         setWindowTitle(QString::fromStdString(d_ptr->m_char->Name()));
         setMaximumWidth(d_ptr->m_char->Width());
         setMaximumHeight(d_ptr->m_char->Height());
         setMinimumWidth(d_ptr->m_char->Width());
         setMinimumHeight(d_ptr->m_char->Height());
+
+        d_ptr->m_compositor.reset(new libacsrender::Compositor(*d_ptr->m_char));
+        d_ptr->m_frameCache.reset(new libacsrender::FrameCache(*d_ptr->m_compositor, FRAME_CACHE_BYTES));
+        libacsrender::PrefetchOptions prefetch;
+        prefetch.Depth = PREFETCH_DEPTH;
+        prefetch.MinProbability = PREFETCH_MIN_PROBABILITY;
+        d_ptr->m_prefetcher.reset(new libacsrender::FramePrefetcher(*d_ptr->m_frameCache, prefetch));
     }
 }
 
-CharacterWindow::~CharacterWindow() {}
+CharacterWindow::~CharacterWindow()
+{
+    PlaybackScheduler::instance()->detach(d_ptr->m_schedulerClient);
+}
 
 void CharacterWindow::Animate(const QString &name)
 {
@@ -88,29 +146,13 @@ void CharacterWindow::Animate(const QString &name)
     auto animation = d->m_char->GetAnimation(cname);
     if(animation != nullptr)
     {
-        if(d->m_animating)
-        {
+        // a playing animation leaves through its exit frames first, the
+        // player queues this one behind it
+        if(d->m_player->Playing())
             gracefulStop();
-            queueAnimation(animation);
-        }
-        else
-        {
-            if(d->m_currentAnimation != nullptr)
-            {
-                // see if we need to process a return animation
-                if(d->m_currentAnimation->Transition() == libacsfile::Animation::TransitionExitBranches)
-                {
-                    d->m_stopRequested = true;
-                    d->m_frame--;
-                    d->m_doNextAfterReverse = name;
-                    doAnimation(d->m_currentAnimation);
-                    return;
-                }
-            }
-            d->m_currentAnimation = animation;
-            d->m_frame = 0;
-            doAnimation(animation);
-        }
+        CHAR_LOG(QString("queueing up animation %1").arg(name));
+        d->m_player->Play(animation);
+        advancePlayback(PlaybackScheduler::instance()->now());
     }
 }
 
@@ -161,12 +203,36 @@ void CharacterWindow::setIdleEnabled(const bool idle)
     d->m_idle = idle;
 }
 
+bool CharacterWindow::audioClockEnabled() const
+{
+    Q_D(const CharacterWindow);
+    return d->m_audioClock;
+}
+
+void CharacterWindow::setAudioClockEnabled(const bool enabled)
+{
+    Q_D(CharacterWindow);
+    d->m_audioClock = enabled;
+}
+
 libacsfile::Character *CharacterWindow::Character() const
 {
     Q_D(const CharacterWindow);
     return d->m_char;
 }
 
+libacsrender::FrameCache *CharacterWindow::frameCache() const
+{
+    Q_D(const CharacterWindow);
+    return d->m_frameCache.data();
+}
+
+libacsfile::PlayerMetrics CharacterWindow::playbackMetrics() const
+{
+    Q_D(const CharacterWindow);
+    return d->m_player->Metrics();
+}
+
 void CharacterWindow::mousePressEvent(QMouseEvent *event)
 {
     Q_D(CharacterWindow);
@@ -207,8 +273,8 @@ void CharacterWindow::paintEvent(QPaintEvent *event)
 {
     Q_UNUSED(event);
     Q_D(CharacterWindow);
-    if(d->m_currentAnimation)
-        drawFrame(d->m_currentAnimation->Frames()[d->m_frame]);
+    if(auto frame = d->m_player->Current().Frame)
+        drawFrame(frame);
 }
 
 void CharacterWindow::showEvent(QShowEvent *event)
@@ -242,16 +308,6 @@ void CharacterWindow::hideEvent(QHideEvent *event)
     QWidget::hideEvent(event);
 }
 
-void CharacterWindow::queueAnimation(libacsfile::Animation *a)
-{
-    Q_D(CharacterWindow);
-    if(a)
-    {
-        CHAR_LOG(QString("queueing up animation %1").arg(QString::fromStdString(a->Name())));
-        d->m_animationQueue.append(a);
-    }
-}
-
 void CharacterWindow::setState(const QString &state)
 {
     Q_D(CharacterWindow);
@@ -270,245 +326,141 @@ void CharacterWindow::setState(const QString &state)
 void CharacterWindow::gracefulStop()
 {
     Q_D(CharacterWindow);
-    ANI_LOG(d->m_currentAnimation->Name(), QString("gracefully stopping animation"));
-    d->m_stopRequested = true;
-}
-
-int CharacterWindow::chooseOptionPercent(const std::vector<int>& probabilities)
-{
-    int sum = 0;
-    for (int p : probabilities) sum += p;
-
-    if (sum > 100) {
-        throw std::runtime_error("Total probability cannot exceed 100%");
-    }
-
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(1, 100);
-
-    int r = dis(gen);
-    int cumulative = 0;
-
-    for (size_t i = 0; i < probabilities.size(); ++i) {
-        cumulative += probabilities[i];
-        if (r <= cumulative) return static_cast<int>(i);
-    }
-
-    return -1;
+    const libacsfile::PlayerStep &step = d->m_player->Current();
+    if(!step.Animation)
+        return;
+    ANI_LOG(step.Animation->Name(), QString("gracefully stopping animation"));
+    d->m_player->Stop();
+    // the shown frame now leaves through its exit frame
+    d->m_prefetcher->Schedule(step.Animation, step.FrameIndex, true);
 }
 
-void CharacterWindow::doAnimation(libacsfile::Animation *a)
+void CharacterWindow::advancePlayback(qint64 now)
 {
     Q_D(CharacterWindow);
-
-    // stop if we are on the last frame
-    if(d->m_frame > a->Frames().size()-1)
+    ACS_TRACE_SCOPE("playback", "advancePlayback");
+    // a coalesced tick may already have run the clock a little ahead
+    const qint64 wallElapsed = qMax<qint64>(now - d->m_lastTick, 0);
+    d->m_lastTick += wallElapsed;
+    uint64_t elapsed = static_cast<uint64_t>(wallElapsed);
+    // while a sound plays the player goes as far as the device has got
+    // through it, and waits when the sound is behind
+    if(d->m_audioClock && d->m_clockSink && d->m_clockSink->state() == QAudio::ActiveState)
     {
-        ANI_LOG(a->Name(), "last frame");
-        d->m_animating = false;
-        d->m_frame--;
-        d->m_stopRequested = false;
-        d->m_currentAnimation = nullptr;
-        if(!d->m_animationQueue.isEmpty())
-        {
-            auto nextAnimation = d->m_animationQueue.takeFirst();
-            Animate(QString::fromStdString(nextAnimation->Name()));
-        }
-        d->m_frame = 0;
-        emit animationCompleted();
-        return;
+        const uint64_t audioTime = d->m_clockStart + static_cast<uint64_t>(d->m_clockSink->processedUSecs() / 1000);
+        elapsed = audioTime > d->m_player->Now() ? audioTime - d->m_player->Now() : 0;
     }
+    // a copy, the signals below may start another animation
+    const libacsfile::PlayerStep step = d->m_player->Advance(elapsed);
 
-    d->m_animating = true;
-
-    auto frame = a->Frames().at(d->m_frame);
-    if(frame == nullptr)
+    if(step.Sound)
     {
-        if(d->m_frame > a->Frames().size())
-        {
-            ANI_LOG(a->Name(), QString("animation completed"));
-            emit animationCompleted();
-            d->m_stopRequested = false;
-            d->m_animating = false;
-            return;
-        }
+        ANI_LOG(step.Animation->Name(), QString("Playing RIFF #%1 of frame %2")
+                                            .arg(QString::number(step.SoundFrame->AudioIndex()))
+                                            .arg(QString::number(step.SoundFrameIndex)));
+        // the sound starts where its frame was due, which a skipping step
+        // may have left behind, and the frames wait until it catches up.
+        // One that fails to play leaves playback on the monotonic clock.
+        d->m_clockSink.clear();
+        d->m_clockStart = step.SoundStart;
+        playSoundEffect(step.Sound);
     }
 
-    if(frame->Images().size() == 0)
+    if(step.FrameEntered)
     {
-        ANI_LOG(a->Name(), QString("frame %1 has no images").arg(QString::number(d->m_frame)));
-        if(a->Frames().size() == d->m_frame)
-        {
-            d->m_animating = false;
-            d->m_frame--;
-            update();
-            return;
-        }
-        else
-        {
-            d->m_frame++;
-            doAnimation(a);
-            return;
-        }
+        ANI_LOG(step.Animation->Name(), QString("drawing frame %1 (duration %2ms)").arg(QString::number(step.FrameIndex))
+                                            .arg(QString::number(step.Frame->Duration()*10)));
+        // painted with the other windows of this tick
+        update();
+        // composite where playback may go next while this frame is shown
+        d->m_prefetcher->Schedule(step.Animation, step.FrameIndex, step.Stopping);
     }
 
-    if(frame->AudioIndex() != 65535)
+    // on the audio clock this is a guess, a sound running slow wakes the
+    // window early and it is scheduled again for what is left
+    auto scheduler = PlaybackScheduler::instance();
+    if(step.Deadline == libacsfile::AnimationPlayer::Never)
+        scheduler->cancel(d->m_schedulerClient);
+    else
+        scheduler->schedule(d->m_schedulerClient, d->m_lastTick + static_cast<qint64>(
+                                step.Deadline - qMin(step.Deadline, d->m_player->Now())));
+
+    if(step.Completed)
     {
-        ANI_LOG(a->Name(), QString("Playing RIFF #%1").arg(QString::number(frame->AudioIndex())));
-        playSoundEffect(frame->Sound());
+        auto metrics = d->m_player->Metrics();
+        CHAR_LOG(QString("Animation took %1 ms of %2 ms nominal, %3 frames shown, %4 skipped, %5 late by up to %6 ms")
+                     .arg(step.AchievedDuration)
+                     .arg(step.NominalDuration)
+                     .arg(metrics.FramesShown)
+                     .arg(metrics.FramesSkipped)
+                     .arg(metrics.LateFrames)
+                     .arg(metrics.MaxLateness));
+        auto cacheStats = d->m_frameCache->Stats();
+        CHAR_LOG(QString("Frame cache: %1 hits, %2 misses, %3 prefetched, %4 evictions, %5 frames in %6 bytes")
+                     .arg(cacheStats.Hits)
+                     .arg(cacheStats.Misses)
+                     .arg(cacheStats.Prefetches)
+                     .arg(cacheStats.Evictions)
+                     .arg(cacheStats.Frames)
+                     .arg(cacheStats.Bytes));
     }
-
-    ANI_LOG(a->Name(), QString("drawing frame %1 (duration %2ms)").arg(QString::number(d->m_frame))
-                           .arg(QString::number(frame->Duration()*10)));
-    repaint();
-
-    QTimer::singleShot(frame->Duration()*10, [this,a,frame]() {
-        Q_D(CharacterWindow);
-        bool hasExitFrame = false;
-        if(d->m_stopRequested)
-        {
-            if(frame->ExitFrame() >= 0)
-            {
-                hasExitFrame = true;
-                d->m_frame = frame->ExitFrame();
-            }
-        }
-        if(!hasExitFrame)
-        {
-            if(frame->Branches().size() == 0)
-            {
-                if(d->m_frame >= a->Frames().size()-1)
-                {
-                    ANI_LOG(a->Name(), QString("animation completed"));
-                    d->m_stopRequested = false;
-                    d->m_animating = false;
-                    if(!d->m_animationQueue.isEmpty())
-                    {
-                        // do we need to process the return?
-                        d->m_currentAnimation = d->m_animationQueue.takeFirst();
-                        ANI_LOG(a->Name(), QString("proceeding with next animation %1")
-                                .arg(QString::fromStdString(d->m_currentAnimation->Name())));
-                        d->m_frame = 0;
-                        doAnimation(d->m_currentAnimation);
-                    }
-                    emit animationCompleted();
-                    return;
-                }
-                d->m_frame++;
-            }
-            else
-            {
-                std::vector<int> probabilities;
-                for(auto b : frame->Branches())
-                    probabilities.push_back(b->Probability());
-
-                int branch = chooseOptionPercent(probabilities);
-
-                if(branch == -1) // do nothing
-                    d->m_frame++;
-                else
-                    d->m_frame = frame->Branches()[branch]->FrameID();
-                ANI_LOG(a->Name(), QString("probability solver chose option %1 to frame %2")
-                                       .arg(QString::number(branch)).arg(QString::number(d->m_frame)));
-
-            }
-        }
-        doAnimation(a);
-    });
+    for(uint16_t i = 0; i < step.Completed; ++i)
+        emit animationCompleted();
 }
 
-void CharacterWindow::drawFrame(libacsfile::Frame *frame)
+void CharacterWindow::drawFrame(const libacsfile::Frame *frame)
 {
     Q_D(CharacterWindow);
-    QPainter p(this);
-    p.setRenderHint(QPainter::Antialiasing, true);
-    //The Frame Images are composited in reverse order from last to first.
-    //for(uint i = frame->Images().size()-1; i <= 0; i--)
-    for(uint i = 0; i < frame->Images().size(); i++)
-    {
-        auto offsetX = frame->Images()[i]->OffsetX();
-        auto offsetY = frame->Images()[i]->OffsetY();
-
-        auto img = frame->Images()[i]->GetImage();
-        if(img == nullptr)
-            continue;
+    ACS_TRACE_SCOPE("playback", "drawFrame");
 
-        int stride = ((width() + 3) & ~3);
+    // Frames are composited once into the cache as premultiplied ARGB,
+    // repeats and repaints are a single blit. The QImage only wraps the
+    // cached pixels, which stay alive while held even if evicted.
+    auto pixels = d->m_frameCache->Get(frame);
+    QImage image(reinterpret_cast<const uchar*>(pixels->data()),
+                 d->m_compositor->Width(), d->m_compositor->Height(),
+                 d->m_compositor->Width() * sizeof(uint32_t),
+                 QImage::Format_ARGB32_Premultiplied);
 
-        QImage frameImage(img->Data().data(), img->Width(), img->Height(), stride, QImage::Format_Indexed8);
-
-        frameImage.setColorCount(d->m_char->ColorPalette().size());
-        QList<QRgb> colors;
-        for(uint i = 0; i < d->m_char->ColorPalette().size(); i++)
-        {
-            QRgb color = qRgb(d->m_char->ColorPalette()[i].rgbRed,
-                              d->m_char->ColorPalette()[i].rgbGreen,
-                              d->m_char->ColorPalette()[i].rgbBlue);
-            colors.append(color);
-        }
-
-        frameImage.setColorTable(colors);
-        frameImage = frameImage.convertToFormat(QImage::Format_ARGB32);
-        QRgb maskColor = qRgb(d->m_char->TransparentColor().rgbRed,
-                              d->m_char->TransparentColor().rgbGreen,
-                              d->m_char->TransparentColor().rgbBlue);
-
-        QImage mask = frameImage.createMaskFromColor(maskColor, Qt::MaskOutColor);
-        frameImage.setAlphaChannel(mask);
-        frameImage.flip();
-        // TODO: hacky, removing the last line from the frame
-        // because it contains a weird artifact (from padding???)
-        auto newimg = frameImage.copy(0,0,img->Width(), img->Height()-1);
-        p.drawImage(QPoint(offsetX,offsetY), newimg);
-    }
+    QPainter p(this);
+    p.drawImage(QPoint(0, 0), image);
 }
 
-void CharacterWindow::playSoundEffect(libacsfile::Sound *sound)
+void CharacterWindow::playSoundEffect(const libacsfile::Sound *sound)
 {
-    if (sound->Size() < 44) {
-        CHAR_LOG("Invalid RIFF data (too small)");
+    Q_D(CharacterWindow);
+    ACS_TRACE_SCOPE("playback", "playSoundEffect");
+    // the RIFF header was parsed when the character loaded
+    const libacsfile::WaveFormat &wave = sound->Format();
+    libacsfile::DataView pcm = sound->PCM();
+    if (pcm.Data == nullptr) {
+        CHAR_LOG("No fmt or data chunk in RIFF block");
         return;
     }
 
-    QByteArray wavData(reinterpret_cast<const char*>(sound->Data().data()),
-                       static_cast<int>(sound->Size()));
-
-    const char *data = wavData.constData();
-
-    // Parse WAV header (simple PCM)
-    quint16 audioFormat   = qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(data + 20));
-    quint16 numChannels   = qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(data + 22));
-    quint32 sampleRate    = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data + 24));
-    quint16 bitsPerSample = qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(data + 34));
-
-    if (audioFormat != 1)
+    if (wave.FormatTag != libacsfile::Sound::FormatPCM)
     {
-        CHAR_LOG(QString("Unsupported PCM Format format: %1").arg(QString::number(audioFormat)));
+        CHAR_LOG(QString("Unsupported PCM Format format: %1").arg(QString::number(wave.FormatTag)));
         return;
     }
 
-    int dataPos = wavData.indexOf("data");
-    if (dataPos == -1) {
-        CHAR_LOG("No data chunk in RIFF block");
-        return;
-    }
-
-    int pcmStart = dataPos + 8; // skip "data" and its size field
-    QByteArray pcm = wavData.mid(pcmStart);
-
     QAudioFormat format;
-    format.setSampleRate(sampleRate);
-    format.setChannelCount(numChannels);
-    format.setSampleFormat(bitsPerSample == 16 ? QAudioFormat::Int16
-                                               : QAudioFormat::UInt8);
+    format.setSampleRate(wave.SampleRate);
+    format.setChannelCount(wave.Channels);
+    format.setSampleFormat(wave.BitsPerSample == 16 ? QAudioFormat::Int16
+                                                    : QAudioFormat::UInt8);
 
+    // The samples are owned by the character, play them in place
     QBuffer *buffer = new QBuffer(this);
-    buffer->setData(pcm);
+    buffer->setData(QByteArray::fromRawData(reinterpret_cast<const char*>(pcm.Data),
+                                            static_cast<int>(pcm.Size)));
     buffer->open(QIODevice::ReadOnly);
 
     AudioSink *audioOutput = new AudioSink(format, this);
     audioOutput->start(buffer);
+    // the newest sound drives the clock, once it goes idle or is deleted
+    // playback is back on the monotonic clock
+    d->m_clockSink = audioOutput;
 
     QObject::connect(audioOutput, &AudioSink::stateChanged, this, [audioOutput, buffer](QAudio::State state) {
         if (state == QAudio::IdleState) {
@@ -6,8 +6,12 @@
 #include <QAudioOutput>
 
 #include <acsfile.h>
+#include <acsplayer.h>
+
+namespace libacsrender { class FrameCache; }
 
 class CharacterWindowPrivate;
+class PlaybackScheduler;
 class CharacterWindow : public QWidget
 {
     Q_OBJECT
@@ -16,6 +20,7 @@ class CharacterWindow : public QWidget
     Q_PROPERTY(QUuid guid READ guid CONSTANT FINAL)
     Q_PROPERTY(bool speechEnabled READ speechEnabled CONSTANT FINAL)
     Q_PROPERTY(bool idleEnabled READ idleEnabled WRITE setIdleEnabled FINAL)
+    Q_PROPERTY(bool audioClockEnabled READ audioClockEnabled WRITE setAudioClockEnabled FINAL)
 public:
     CharacterWindow(const QString &filename, QWidget *parent = nullptr);
     ~CharacterWindow();
@@ -29,7 +34,15 @@ public:
     bool speechEnabled() const;
     bool idleEnabled() const;
     void setIdleEnabled(const bool idle);
+    // Frame deadlines follow the audio device while a sound of the
+    // character plays, the monotonic clock otherwise
+    bool audioClockEnabled() const;
+    void setAudioClockEnabled(const bool enabled);
     libacsfile::Character* Character() const;
+    // Composited frames of this character, see FrameCache::Stats()
+    libacsrender::FrameCache* frameCache() const;
+    // Achieved against nominal playback time, see PlayerMetrics
+    libacsfile::PlayerMetrics playbackMetrics() const;
 protected:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
@@ -40,14 +53,14 @@ protected:
 signals:
     void animationCompleted();
 private:
-    void queueAnimation(libacsfile::Animation *a);
     void setState(const QString &state);
     void gracefulStop();
-    int chooseOptionPercent(const std::vector<int>& probabilities);
-    void doAnimation(libacsfile::Animation *a);
-    void drawFrame(libacsfile::Frame *frame);
-    void playSoundEffect(libacsfile::Sound *sound);
+    // Moves playback on to now on the scheduler clock
+    void advancePlayback(qint64 now);
+    void drawFrame(const libacsfile::Frame *frame);
+    void playSoundEffect(const libacsfile::Sound *sound);
 private:
+    friend class PlaybackScheduler;
     Q_DECLARE_PRIVATE(CharacterWindow)
     QScopedPointer<CharacterWindowPrivate> d_ptr;
 };
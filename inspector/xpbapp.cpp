@@ -44,9 +44,10 @@ XPBApplication::XPBApplication(int &argc, char **argv)
     auto windowMenu = m_menuBar->addMenu(tr("&Window"));
     auto open = fileMenu->addAction(tr("&Open..."));
     fileMenu->addSeparator();
-    auto exportGIF = fileMenu->addAction(tr("Export &GIF..."));
-    exportGIF->setDisabled(true);
+    m_exportGIF = fileMenu->addAction(tr("Export &GIF..."));
+    m_exportGIF->setDisabled(true);
     connect(open, &QAction::triggered, this, &XPBApplication::openFile);
+    connect(m_exportGIF, &QAction::triggered, this, &XPBApplication::exportGIF);
 
     auto log = windowMenu->addAction(tr("&Log"));
     log->setShortcut(QKeySequence("Ctrl+Shift+L"));
@@ -71,10 +72,12 @@ bool XPBApplication::openFile()
         {
             w->show();
             m_openAgents.append(w);
+            m_exportGIF->setEnabled(true);
             connect(w, &QDialog::finished, this, [this]() {
                 auto window = qobject_cast<PropertiesWindow*>(sender());
                 if(window)
                     m_openAgents.removeOne(window);
+                m_exportGIF->setEnabled(!m_openAgents.isEmpty());
             });
             return true;
         }
@@ -85,6 +88,16 @@ bool XPBApplication::openFile()
     return false;
 }
 
+// Exports from the focused character, or the last one opened
+void XPBApplication::exportGIF()
+{
+    auto window = qobject_cast<PropertiesWindow*>(activeWindow());
+    if(!window && !m_openAgents.isEmpty())
+        window = m_openAgents.last();
+    if(window)
+        window->exportGIF();
+}
+
 int main(int argc, char *argv[])
 {
     XPBApplication a(argc, argv);
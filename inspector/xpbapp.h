@@ -18,8 +18,10 @@ public:
     void quit();
 public slots:
     bool openFile();
+    void exportGIF();
 private:
     QMenuBar *m_menuBar = nullptr;
+    QAction *m_exportGIF = nullptr;
     QVector<PropertiesWindow*> m_openAgents{};
     LoggerWindow *m_logger = nullptr;
 };
@@ -0,0 +1,162 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Compositing kernels specialized at compile time. What they depend on
+// (transparent pixels, width alignment, image count, overlays) is known
+// once the character loads, so each image and frame picks its kernel
+// then and playback never re-checks it per pixel.
+
+#include "acs_private.h"
+#include "acsfile.h"
+#include "acstrace.h"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace libacsfile;
+using namespace std;
+
+// The palette has alpha 0xFF or 0, so the top bit selects between the
+// source pixel and what is already in the target without a branch
+template<bool ColorKeyed>
+static inline void PutPixel(uint32_t *dst, uint32_t argb)
+{
+    if(ColorKeyed)
+    {
+        uint32_t mask = static_cast<uint32_t>(static_cast<int32_t>(argb) >> 31);
+        *dst = (argb & mask) | (*dst & ~mask);
+    }
+    else
+        *dst = argb;
+}
+
+// Align is a width the image is a multiple of, the inner loop then has a
+// fixed trip count the compiler unrolls and vectorizes
+template<bool ColorKeyed, int Align>
+static void BlitRows(const uint8_t *src, ptrdiff_t srcStride, int width, int height,
+                     uint32_t *dst, ptrdiff_t dstStride, const uint32_t *palette)
+{
+    for(int row = 0; row < height; ++row, src += srcStride, dst += dstStride)
+        for(int col = 0; col < width; col += Align)
+            for(int i = 0; i < Align; ++i)
+                PutPixel<ColorKeyed>(dst + col + i, palette[src[col + i]]);
+}
+
+static const BlitKernel BlitKernels[2][3] = {
+    { BlitRows<false, 1>, BlitRows<false, 4>, BlitRows<false, 16> },
+    { BlitRows<true, 1>, BlitRows<true, 4>, BlitRows<true, 16> }
+};
+
+void ImagePrivate::SelectKernel(uint8_t transparentIndex)
+{
+    Kernel = nullptr;
+    const uint32_t stride = Stride();
+    if(Delta || Width == 0 || Height == 0 || ImageData->size() < static_cast<size_t>(stride) * Height)
+        return;
+
+    Opaque = true;
+    for(uint32_t row = 0; row < Height && Opaque; ++row)
+        Opaque = memchr(ImageData->data() + static_cast<size_t>(row) * stride, transparentIndex, Width) == nullptr;
+
+    // color-keyed images with a run table skip their transparent spans,
+    // which beats touching every pixel
+    if(!Opaque && Runs)
+        return;
+
+    int align = Width % 16 == 0 ? 2 : Width % 4 == 0 ? 1 : 0;
+    Kernel = BlitKernels[!Opaque][align];
+}
+
+void CharacterPrivate::SelectImageKernels()
+{
+    ACS_TRACE_SCOPE("load", "SelectImageKernels");
+    for(auto &[id, img] : images)
+        img->p->SelectKernel(TransparentColorIndex);
+}
+
+template<bool Single, bool Covers, bool Overlays>
+void FramePrivate::Composite(const FramePrivate *frame, uint32_t *target, int targetWidth,
+                             int targetHeight, int targetStride, const uint32_t *palette,
+                             const Overlay *mouth)
+{
+    // a mouth that replaces the top image uncovers what lies under it
+    const bool replaceTop = Overlays && mouth && mouth->ReplacesTopImage();
+
+    // an opaque image over the whole target overwrites every pixel
+    if(!Covers || replaceTop)
+        for(int row = 0; row < targetHeight; ++row)
+            fill_n(target + static_cast<ptrdiff_t>(row) * targetStride, targetWidth, 0u);
+
+    if(Single)
+    {
+        const FrameImage *fimg = frame->ImageIndexes[0];
+        if(!replaceTop)
+            fimg->GetImage()->Blit(target, targetWidth, targetHeight, targetStride,
+                                   fimg->OffsetX(), fimg->OffsetY(), palette);
+    }
+    else
+    {
+        // images are listed top first, so they are drawn from the last one
+        for(size_t i = frame->ImageIndexes.size(); i-- > (replaceTop ? 1 : 0);)
+        {
+            const FrameImage *fimg = frame->ImageIndexes[i];
+            if(Image *img = fimg->GetImage())
+                img->Blit(target, targetWidth, targetHeight, targetStride,
+                          fimg->OffsetX(), fimg->OffsetY(), palette);
+        }
+    }
+
+    if(Overlays && mouth && mouth->Image())
+        mouth->Image()->Blit(target, targetWidth, targetHeight, targetStride,
+                             mouth->OffsetX(), mouth->OffsetY(), palette);
+}
+
+void FramePrivate::SelectKernel()
+{
+    const bool overlays = !MouthOverlays.empty();
+    const Image *single = ImageIndexes.size() == 1 ? ImageIndexes[0]->GetImage() : nullptr;
+    if(!single)
+    {
+        Kernel = overlays ? Composite<false, false, true> : Composite<false, false, false>;
+        return;
+    }
+
+    // Covers holds for character-sized targets, Frame::Composite checks
+    // the size before using the kernel
+    const FrameImage *fimg = ImageIndexes[0];
+    const bool covers = single->p->Opaque && fimg->OffsetX() <= 0 && fimg->OffsetY() <= 0
+                     && fimg->OffsetX() + single->p->Width >= c->CharacterWidth
+                     && fimg->OffsetY() + single->p->Height >= c->CharacterHeight;
+    if(covers)
+        Kernel = overlays ? Composite<true, true, true> : Composite<true, true, false>;
+    else
+        Kernel = overlays ? Composite<true, false, true> : Composite<true, false, false>;
+}
+
+const Overlay *FramePrivate::FindMouth(Overlay::Type type) const
+{
+    for(const Overlay *overlay : MouthOverlays)
+        if(overlay->OverlayType() == type)
+            return overlay;
+    return nullptr;
+}
+
+bool FramePrivate::FollowsByDelta(const FramePrivate *previous) const
+{
+    if(ImageIndexes.size() != 1 || previous->ImageIndexes.size() != 1)
+        return false;
+    const FrameImage *fimg = ImageIndexes[0];
+    const FrameImage *before = previous->ImageIndexes[0];
+    const Image *img = fimg->GetImage();
+    return img && before->GetImage() && img->p->Delta && img->p->Delta->Base == before->GetImage()->p
+        && fimg->OffsetX() == before->OffsetX() && fimg->OffsetY() == before->OffsetY();
+}
+
+void FramePrivate::Draw(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                        const uint32_t *palette, const Overlay *mouth) const
+{
+    if(Kernel && targetWidth == c->CharacterWidth && targetHeight == c->CharacterHeight)
+        Kernel(this, target, targetWidth, targetHeight, targetStride, palette, mouth);
+    else
+        Composite<false, false, true>(this, target, targetWidth, targetHeight, targetStride, palette, mouth);
+}
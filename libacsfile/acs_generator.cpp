@@ -0,0 +1,495 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#include "acsgenerator.h"
+#include "acs_private.h"
+#include "acsfile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace libacsfile;
+using namespace std;
+
+namespace {
+
+    // splitmix64, the standard distributions are not the same across
+    // standard libraries
+    class Random
+    {
+    public:
+        explicit Random(uint64_t seed) : state(seed) {}
+        uint64_t Next()
+        {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+        uint32_t Below(uint32_t bound)
+        {
+            return bound == 0 ? 0 : static_cast<uint32_t>(Next() % bound);
+        }
+    private:
+        uint64_t state;
+    };
+
+    class Buffer
+    {
+    public:
+        vector<uint8_t> Data;
+        template<typename T> void Put(const T &value)
+        {
+            const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+            Data.insert(Data.end(), bytes, bytes + sizeof(T));
+        }
+        void PutBytes(const vector<uint8_t> &bytes)
+        {
+            Data.insert(Data.end(), bytes.begin(), bytes.end());
+        }
+        void PutString(const string &str)
+        {
+            Put<uint32_t>(static_cast<uint32_t>(str.size()));
+            if(str.empty())
+                return;
+            for(char ch : str)
+                Put<uint16_t>(static_cast<uint8_t>(ch));
+            Put<uint16_t>(0);
+        }
+        uint32_t Offset() const { return static_cast<uint32_t>(Data.size()); }
+        void PutLocator(size_t at, uint32_t offset)
+        {
+            ACSLOCATOR locator{ offset, Offset() - offset };
+            memcpy(Data.data() + at, &locator, sizeof(ACSLOCATOR));
+        }
+    };
+
+    const uint16_t LanguageIDs[] = {
+        0x0409, 0x0407, 0x040C, 0x0410, 0x0C0A, 0x0411, 0x0416, 0x0419, 0x0412, 0x0804
+    };
+
+    const char *StateNames[] = {
+        "SHOWING", "HIDING", "SPEAKING", "LISTENING", "HEARING", "GESTURINGUP",
+        "GESTURINGDOWN", "GESTURINGLEFT", "GESTURINGRIGHT", "IDLINGLEVEL1",
+        "IDLINGLEVEL2", "IDLINGLEVEL3", "MOVINGUP", "MOVINGDOWN", "MOVINGLEFT", "MOVINGRIGHT"
+    };
+
+    string AnimationName(uint32_t index)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "Anim%03u", index);
+        return name;
+    }
+
+    // An ellipse of horizontal color bands on a transparent background. A
+    // block of noise on every row sets how well the image compresses.
+    vector<uint8_t> GeneratePixels(Random &rng, const GeneratorOptions &options,
+                                   uint8_t transparentIndex, double noise)
+    {
+        const uint32_t width = options.ImageWidth;
+        const uint32_t height = options.ImageHeight;
+        const uint32_t stride = (width + 3) & ~3u;
+        vector<uint8_t> pixels(static_cast<size_t>(stride) * height, transparentIndex);
+
+        const uint32_t band = 2 + rng.Below(8);
+        const uint32_t hue = rng.Below(256);
+        const double rx = width / 2.0, ry = height / 2.0;
+        const uint32_t noisy = min<uint32_t>(width, static_cast<uint32_t>(noise * width + 0.5));
+        for(uint32_t y = 0; y < height; ++y)
+        {
+            uint8_t *row = pixels.data() + static_cast<size_t>(y) * stride;
+            uint8_t color = static_cast<uint8_t>((hue + y / band) % 256);
+            if(color == transparentIndex)
+                ++color;
+            double dy = (y + 0.5 - ry) / ry;
+            for(uint32_t x = 0; x < width; ++x)
+            {
+                double dx = (x + 0.5 - rx) / rx;
+                if(dx * dx + dy * dy <= 1.0)
+                    row[x] = color;
+            }
+
+            uint32_t start = rng.Below(width - noisy + 1);
+            for(uint32_t x = start; x < start + noisy; ++x)
+                row[x] = static_cast<uint8_t>(rng.Next());
+        }
+        return pixels;
+    }
+
+    // The previous image with one rectangle redrawn in a new color, noisy
+    // like the rows of the rest
+    vector<uint8_t> DerivePixels(Random &rng, const GeneratorOptions &options, vector<uint8_t> pixels,
+                                 uint8_t transparentIndex, double noise)
+    {
+        const uint32_t width = options.ImageWidth;
+        const uint32_t height = options.ImageHeight;
+        const uint32_t stride = (width + 3) & ~3u;
+        const uint32_t rectWidth = max<uint32_t>(1, width * options.DirtyRectSize / 100);
+        const uint32_t rectHeight = max<uint32_t>(1, height * options.DirtyRectSize / 100);
+        const uint32_t left = rng.Below(width - min(width, rectWidth) + 1);
+        const uint32_t top = rng.Below(height - min(height, rectHeight) + 1);
+        uint8_t color = static_cast<uint8_t>(rng.Below(256));
+        if(color == transparentIndex)
+            ++color;
+
+        const uint32_t right = min(width, left + rectWidth);
+        const uint32_t noisy = min<uint32_t>(right - left, static_cast<uint32_t>(noise * (right - left) + 0.5));
+        for(uint32_t y = top; y < min(height, top + rectHeight); ++y)
+        {
+            uint8_t *row = pixels.data() + static_cast<size_t>(y) * stride;
+            fill(row + left, row + right, color);
+            uint32_t start = left + rng.Below(right - left - noisy + 1);
+            for(uint32_t x = start; x < start + noisy; ++x)
+                row[x] = static_cast<uint8_t>(rng.Next());
+        }
+        return pixels;
+    }
+
+    vector<uint8_t> GenerateWave(Random &rng, uint32_t size)
+    {
+        // 8 bit mono PCM, a random walk sounds less like static
+        Buffer wave;
+        wave.PutBytes({ 'R', 'I', 'F', 'F' });
+        wave.Put<uint32_t>(36 + size + (size & 1));
+        wave.PutBytes({ 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+        wave.Put<uint32_t>(16);
+        wave.Put<uint16_t>(Sound::FormatPCM);
+        wave.Put<uint16_t>(1);
+        wave.Put<uint32_t>(11025);
+        wave.Put<uint32_t>(11025);
+        wave.Put<uint16_t>(1);
+        wave.Put<uint16_t>(8);
+        wave.PutBytes({ 'd', 'a', 't', 'a' });
+        wave.Put<uint32_t>(size);
+        int sample = 128;
+        for(uint32_t i = 0; i < size; ++i)
+        {
+            sample = min(255, max(0, sample + static_cast<int>(rng.Below(17)) - 8));
+            wave.Put<uint8_t>(static_cast<uint8_t>(sample));
+        }
+        if(size & 1)
+            wave.Put<uint8_t>(0);
+        return wave.Data;
+    }
+}
+
+GeneratorOptions libacsfile::GeneratorPreset(const string &name)
+{
+    GeneratorOptions options;
+    if(name == "small")
+    {
+        options.Images = 8;
+        options.ImageWidth = options.ImageHeight = 64;
+        options.Width = options.Height = 64;
+        options.Animations = 4;
+        options.FramesPerAnimation = 4;
+        options.DerivedImages = 50;
+        options.SequentialAnimations = 50;
+        options.Sounds = 1;
+        options.SoundBytes = 2000;
+    }
+    else if(name == "large")
+    {
+        options.Images = 2000;
+        options.ImageWidth = 200;
+        options.ImageHeight = 160;
+        options.Width = 200;
+        options.Height = 160;
+        options.Languages = 4;
+        options.Voice = true;
+        options.Animations = 120;
+        options.FramesPerAnimation = 24;
+        options.ImagesPerFrame = 2;
+        options.DerivedImages = 75;
+        options.SequentialAnimations = 25;
+        options.BranchesPerFrame = 2;
+        options.OverlaysPerFrame = 2;
+        options.Sounds = 60;
+        options.SoundBytes = 22050;
+        options.States = 16;
+        options.AnimationsPerState = 6;
+    }
+    else if(name == "pathological")
+    {
+        // worst cases rather than a plausible character: incompressible
+        // images, every frame branching and carrying overlays
+        options.Images = 4000;
+        options.ImageWidth = 511;
+        options.ImageHeight = 3;
+        options.Width = 640;
+        options.Height = 480;
+        options.CompressionRatio = 0.95;
+        options.Languages = 40;
+        options.Animations = 300;
+        options.FramesPerAnimation = 64;
+        options.ImagesPerFrame = 8;
+        options.BranchesPerFrame = 255;
+        options.OverlaysPerFrame = 16;
+        options.SoundFrames = 100;
+        options.Sounds = 4000;
+        options.SoundBytes = 1;
+        options.States = 200;
+        options.AnimationsPerState = 40;
+    }
+    else if(name != "default")
+        throw runtime_error("Unknown preset: " + name);
+    return options;
+}
+
+vector<uint8_t> libacsfile::GenerateCharacter(const GeneratorOptions &options)
+{
+    if(options.Images > 65536)
+        throw runtime_error("At most 65536 images fit in an ACS file");
+    if(options.Sounds > 65535)
+        throw runtime_error("At most 65535 sounds fit in an ACS file");
+
+    Random rng(options.Seed);
+    Buffer out;
+    out.Put<uint32_t>(AGENT_CHAR_20_MAGIC);
+    const size_t header = out.Data.size();
+    out.Data.resize(header + 4 * sizeof(ACSLOCATOR));
+
+    // ACSCHARACTERINFO
+    const uint8_t transparentIndex = static_cast<uint8_t>(rng.Below(256));
+    const uint32_t characterInfo = out.Offset();
+    out.Put<uint16_t>(0);
+    out.Put<uint16_t>(2);
+    const size_t localizedAt = out.Data.size();
+    out.Put(ACSLOCATOR{});
+    GUID guid{};
+    guid.Data1 = static_cast<uint32_t>(rng.Next());
+    guid.Data2 = static_cast<uint16_t>(rng.Next());
+    guid.Data3 = static_cast<uint16_t>(rng.Next());
+    for(auto &b : guid.Data4)
+        b = static_cast<uint8_t>(rng.Next());
+    out.Put(guid);
+    out.Put(options.Width);
+    out.Put(options.Height);
+    out.Put(transparentIndex);
+    out.Put<uint32_t>(CHAR_STYLE_BALLOON | CHAR_STYLE_STANDARD | (options.Voice ? CHAR_STYLE_TTS : 0));
+    out.Put<uint16_t>(2);
+    out.Put<uint16_t>(0);
+
+    if(options.Voice)
+    {
+        out.Put(GUID{});
+        out.Put(GUID{});
+        out.Put<uint32_t>(150);
+        out.Put<uint16_t>(100);
+        out.Put<uint8_t>(1);
+        out.Put<uint16_t>(LanguageIDs[0]);
+        out.PutString("Synthetic");
+        out.Put<uint16_t>(1);
+        out.Put<uint16_t>(30);
+        out.PutString("Neutral");
+    }
+
+    out.Put<uint8_t>(2);
+    out.Put<uint8_t>(32);
+    out.Put(RGBQUAD{ 0, 0, 0, 0 });
+    out.Put(RGBQUAD{ 0xE1, 0xFF, 0xFF, 0 });
+    out.Put(RGBQUAD{ 0, 0, 0, 0 });
+    out.PutString("Tahoma");
+    out.Put<int32_t>(-13);
+    out.Put<int32_t>(400);
+    out.Put<uint8_t>(0);
+    out.Put<uint8_t>(0);
+
+    out.Put<uint32_t>(256);
+    for(uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t color = static_cast<uint32_t>(rng.Next());
+        out.Put(RGBQUAD{ static_cast<uint8_t>(color), static_cast<uint8_t>(color >> 8),
+                         static_cast<uint8_t>(color >> 16), 0 });
+    }
+    out.Put<uint8_t>(0);
+
+    out.Put<uint16_t>(options.States);
+    for(uint16_t i = 0; i < options.States; ++i)
+    {
+        const size_t names = sizeof(StateNames) / sizeof(StateNames[0]);
+        string state = StateNames[i % names];
+        if(i >= names)
+            state += to_string(i / names);
+        out.PutString(state);
+        uint16_t count = options.Animations ? options.AnimationsPerState : 0;
+        out.Put<uint16_t>(count);
+        for(uint16_t j = 0; j < count; ++j)
+            out.PutString(AnimationName(rng.Below(options.Animations)));
+    }
+    const uint32_t characterInfoSize = out.Offset() - characterInfo;
+
+    // ACSLOCALIZEDINFO
+    const uint32_t localized = out.Offset();
+    out.Put<uint16_t>(options.Languages);
+    for(uint16_t i = 0; i < options.Languages; ++i)
+    {
+        const size_t languages = sizeof(LanguageIDs) / sizeof(LanguageIDs[0]);
+        uint16_t langId = LanguageIDs[i % languages] + static_cast<uint16_t>((i / languages) << 10);
+        char description[48];
+        snprintf(description, sizeof(description), "Generated character, language %04x", langId);
+        out.Put(langId);
+        out.PutString("Synthetic" + to_string(options.Seed));
+        out.PutString(description);
+        out.PutString(string());
+    }
+    out.PutLocator(localizedAt, localized);
+
+    // Images
+    // Measured with the Fast preset: the noise free image compresses to
+    // about 5%, every noisy byte adds a bit more than one byte (the
+    // literal plus the match it breaks)
+    const double noise = options.CompressionRatio >= 1.0
+                             ? 0.0 : min(1.0, max(0.0, (options.CompressionRatio - 0.05) / 1.15));
+    vector<pair<ACSLOCATOR, uint32_t>> imageList;
+    vector<uint8_t> previous;
+    for(uint32_t i = 0; i < options.Images; ++i)
+    {
+        const bool derived = options.DerivedImages && i > 0 && rng.Below(100) < options.DerivedImages;
+        vector<uint8_t> pixels = derived ? DerivePixels(rng, options, previous, transparentIndex, noise)
+                                         : GeneratePixels(rng, options, transparentIndex, noise);
+        vector<uint8_t> encoded;
+        bool compressed = false;
+        if(options.CompressionRatio < 1.0)
+        {
+            encoded = CompressData(pixels);
+            compressed = encoded.size() < pixels.size();
+        }
+
+        ACSLOCATOR locator{ out.Offset(), 0 };
+        out.Put<uint8_t>(0);
+        out.Put(options.ImageWidth);
+        out.Put(options.ImageHeight);
+        out.Put<uint8_t>(compressed);
+        out.Put<uint32_t>(static_cast<uint32_t>(compressed ? encoded.size() : pixels.size()));
+        out.PutBytes(compressed ? encoded : pixels);
+        out.Put<uint32_t>(0);
+        out.Put<uint32_t>(0);
+        locator.Size = out.Offset() - locator.Offset;
+        imageList.push_back({ locator, static_cast<uint32_t>(HashImageData(pixels)) });
+        if(options.DerivedImages)
+            previous = move(pixels);
+    }
+
+    // Sounds
+    vector<pair<ACSLOCATOR, uint32_t>> soundList;
+    for(uint32_t i = 0; i < options.Sounds; ++i)
+    {
+        vector<uint8_t> wave = GenerateWave(rng, options.SoundBytes);
+        ACSLOCATOR locator{ out.Offset(), static_cast<uint32_t>(wave.size()) };
+        out.PutBytes(wave);
+        soundList.push_back({ locator, static_cast<uint32_t>(HashImageData(wave)) });
+    }
+
+    // Animations
+    vector<pair<string, ACSLOCATOR>> animationList;
+    const uint16_t frames = options.FramesPerAnimation;
+    for(uint32_t i = 0; i < options.Animations; ++i)
+    {
+        ACSLOCATOR locator{ out.Offset(), 0 };
+        string name = AnimationName(i);
+        uint8_t transition = static_cast<uint8_t>(rng.Below(3));
+        out.PutString(name);
+        out.Put(transition);
+        out.PutString(transition == Animation::TransitionReturnAnimation && options.Animations > 1
+                          ? AnimationName(rng.Below(options.Animations)) : string());
+        out.Put(frames);
+        const bool sequential = options.SequentialAnimations && options.Images
+                                && rng.Below(100) < options.SequentialAnimations;
+        const uint32_t first = sequential ? rng.Below(options.Images) : 0;
+        const int16_t sequenceX = sequential
+                                      ? static_cast<int16_t>(rng.Below(max(1, options.Width - options.ImageWidth + 1))) : 0;
+        const int16_t sequenceY = sequential
+                                      ? static_cast<int16_t>(rng.Below(max(1, options.Height - options.ImageHeight + 1))) : 0;
+        for(uint16_t f = 0; f < frames; ++f)
+        {
+            uint16_t images = options.Images ? (sequential ? 1 : options.ImagesPerFrame) : 0;
+            out.Put(images);
+            if(sequential)
+            {
+                out.Put<uint32_t>((first + f) % options.Images);
+                out.Put(sequenceX);
+                out.Put(sequenceY);
+            }
+            else
+            {
+                for(uint16_t j = 0; j < images; ++j)
+                {
+                    out.Put<uint32_t>(rng.Below(options.Images));
+                    out.Put<int16_t>(static_cast<int16_t>(rng.Below(max(1, options.Width - options.ImageWidth + 1))));
+                    out.Put<int16_t>(static_cast<int16_t>(rng.Below(max(1, options.Height - options.ImageHeight + 1))));
+                }
+            }
+
+            bool sound = options.Sounds && rng.Below(100) < options.SoundFrames;
+            out.Put<uint16_t>(sound ? static_cast<uint16_t>(rng.Below(options.Sounds)) : 65535);
+            out.Put<uint16_t>(static_cast<uint16_t>(5 + rng.Below(20)));
+            out.Put<int16_t>(rng.Below(2) ? static_cast<int16_t>(rng.Below(frames)) : -1);
+
+            uint8_t branches = static_cast<uint8_t>(rng.Below(options.BranchesPerFrame + 1u));
+            out.Put(branches);
+            for(uint8_t b = 0; b < branches; ++b)
+            {
+                out.Put<uint16_t>(static_cast<uint16_t>(rng.Below(frames)));
+                out.Put<uint16_t>(static_cast<uint16_t>(rng.Below(100 / branches + 1)));
+            }
+
+            uint8_t overlays = options.Images
+                                   ? static_cast<uint8_t>(rng.Below(options.OverlaysPerFrame + 1u)) : 0;
+            out.Put(overlays);
+            for(uint8_t o = 0; o < overlays; ++o)
+            {
+                out.Put<uint8_t>(static_cast<uint8_t>(rng.Below(7)));
+                out.Put<uint8_t>(static_cast<uint8_t>(rng.Below(2)));
+                out.Put<uint16_t>(static_cast<uint16_t>(rng.Below(options.Images)));
+                out.Put<uint8_t>(0);
+                out.Put<uint8_t>(0);
+                out.Put<int16_t>(0);
+                out.Put<int16_t>(0);
+                out.Put(options.ImageWidth);
+                out.Put(options.ImageHeight);
+            }
+        }
+        locator.Size = out.Offset() - locator.Offset;
+        animationList.push_back({ name, locator });
+    }
+
+    // Lists
+    const uint32_t animationInfo = out.Offset();
+    out.Put<uint32_t>(static_cast<uint32_t>(animationList.size()));
+    for(auto &[name, locator] : animationList)
+    {
+        out.PutString(name);
+        out.Put(locator);
+    }
+    out.PutLocator(header + sizeof(ACSLOCATOR), animationInfo);
+
+    const uint32_t imageInfo = out.Offset();
+    out.Put<uint32_t>(static_cast<uint32_t>(imageList.size()));
+    for(auto &[locator, checksum] : imageList)
+    {
+        out.Put(locator);
+        out.Put(checksum);
+    }
+    out.PutLocator(header + 2 * sizeof(ACSLOCATOR), imageInfo);
+
+    const uint32_t audioInfo = out.Offset();
+    out.Put<uint32_t>(static_cast<uint32_t>(soundList.size()));
+    for(auto &[locator, checksum] : soundList)
+    {
+        out.Put(locator);
+        out.Put(checksum);
+    }
+    out.PutLocator(header + 3 * sizeof(ACSLOCATOR), audioInfo);
+
+    if(out.Data.size() > UINT32_MAX)
+        throw runtime_error("Character is too large for an ACS file");
+
+    ACSLOCATOR info{ characterInfo, characterInfoSize };
+    memcpy(out.Data.data() + header, &info, sizeof(ACSLOCATOR));
+    return move(out.Data);
+}
@@ -0,0 +1,395 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#include "acsplayer.h"
+#include "acs_private.h"
+#include "acstrace.h"
+
+#include <vector>
+#include <algorithm>
+
+// Frames entered in one step at most, animations finishing without a
+// frame to show or zero length frames branching among themselves would
+// otherwise never give control back
+#define PLAYER_MAX_TRANSITIONS 1024
+
+using namespace libacsfile;
+using namespace std;
+
+namespace libacsfile {
+    class AnimationPlayerPrivate {
+    private:
+        friend class AnimationPlayer;
+        enum Mode {
+            Idle,
+            Starting,       // the next animation begins at Deadline
+            Showing
+        };
+        const Frame* FrameAt(const Animation *animation, uint32_t index) const;
+        uint32_t Roll();
+        uint32_t NextIndex();
+        bool Begin(uint32_t &index);
+        bool Enter(uint32_t index);
+        void Transition();
+        void StartStep();
+        void FinishStep();
+
+        Mode State = Idle;
+        uint64_t Random = 0;
+        uint64_t Now = 0;
+        uint64_t Deadline = 0;
+        const Animation *Current = nullptr;
+        uint32_t Index = 0;
+        bool Stopping = false;
+        // frames left while stopping, see NextIndex
+        size_t ExitSteps = 0;
+        // the animation that finished last, it returns to rest before the
+        // next one starts unless it was a return itself
+        const Animation *Held = nullptr;
+        bool Returning = false;
+        // popped by moving Head, cleared once empty so the capacity stays
+        vector<const Animation*> Queue;
+        size_t Head = 0;
+        PlayerStep Step;
+
+        PlayerOptions Options;
+        PlayerMetrics Metrics;
+        // when the playing animation's first frame was due and the time
+        // its frames add up to
+        uint64_t AnimationStart = 0;
+        uint64_t AnimationNominal = 0;
+        bool AnimationStarted = false;
+        uint32_t Entered = 0;
+    };
+}
+
+const Frame* AnimationPlayerPrivate::FrameAt(const Animation *animation, uint32_t index) const
+{
+    if(index > UINT16_MAX)
+        return nullptr;
+    auto &frames = animation->p->Frames;
+    auto it = frames.find(static_cast<uint16_t>(index));
+    return it != frames.end() ? it->second : nullptr;
+}
+
+// splitmix64 in [1, 100], like the percentages branches are given in
+uint32_t AnimationPlayerPrivate::Roll()
+{
+    uint64_t z = (Random += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return static_cast<uint32_t>((z ^ (z >> 31)) % 100) + 1;
+}
+
+// Where the shown frame leads: its exit frame when stopping, else a
+// branch if the roll lands in one, else the frame after it
+uint32_t AnimationPlayerPrivate::NextIndex()
+{
+    // an exit path longer than the animation loops, run out the frames
+    // that follow so the stop still finishes
+    if(Stopping && ++ExitSteps > Current->p->Frames.size())
+        return Index + 1;
+
+    // a frame that is gone ends the animation, no index above 16 bits
+    // has one
+    const Frame *shown = FrameAt(Current, Index);
+    if(!shown)
+        return UINT16_MAX + 1;
+    const FramePrivate *frame = shown->p;
+    if(Stopping && frame->ExitFrameID >= 0)
+        return static_cast<uint32_t>(frame->ExitFrameID);
+
+    if(!frame->Branches.empty())
+    {
+        const uint32_t roll = Roll();
+        uint32_t cumulative = 0;
+        for(const Branch *branch : frame->Branches)
+        {
+            cumulative += branch->Probability();
+            if(roll <= cumulative)
+                return branch->FrameID();
+        }
+    }
+    return Index + 1;
+}
+
+// Picks what plays next and the frame it starts on, false when nothing
+// is queued. Whatever has animations waiting behind it plays as stopped,
+// so one that loops cannot hold up the queue.
+bool AnimationPlayerPrivate::Begin(uint32_t &index)
+{
+    if(Head == Queue.size())
+    {
+        Queue.clear();
+        Head = 0;
+        return false;
+    }
+
+    const Animation *next = Queue[Head];
+    const Animation *held = Held;
+    Held = nullptr;
+    Stopping = false;
+    ExitSteps = 0;
+    Returning = false;
+    if(held && held->p->Transition == Animation::TransitionExitBranches)
+    {
+        const Frame *frame = FrameAt(held, Index);
+        if(frame && frame->p->ExitFrameID >= 0)
+        {
+            Current = held;
+            Stopping = true;
+            Returning = true;
+            index = static_cast<uint32_t>(frame->p->ExitFrameID);
+            return true;
+        }
+    }
+    else if(held && held->p->Transition == Animation::TransitionReturnAnimation && !held->p->ReturnAnimation.empty())
+    {
+        auto &animations = held->p->c->animations;
+        auto it = animations.find(held->p->ReturnAnimation);
+        if(it != animations.end() && it->second != next && it->second != held)
+        {
+            Current = it->second;
+            Stopping = true;
+            Returning = true;
+            index = 0;
+            return true;
+        }
+    }
+
+    ++Head;
+    Current = next;
+    Stopping = Head < Queue.size();
+    index = 0;
+    return true;
+}
+
+// Shows the frame at index or the first one with images after it, false
+// when the animation ran out of frames
+bool AnimationPlayerPrivate::Enter(uint32_t index)
+{
+    for(const Frame *frame = FrameAt(Current, index); frame; frame = FrameAt(Current, ++index))
+    {
+        if(frame->p->ImageIndexes.empty())
+            continue;
+
+        const uint64_t duration = static_cast<uint64_t>(frame->p->Duration) * 10;
+        const uint64_t lateness = Now > Deadline ? Now - Deadline : 0;
+        if(!AnimationStarted)
+        {
+            AnimationStart = Deadline;
+            AnimationNominal = 0;
+            AnimationStarted = true;
+        }
+        AnimationNominal += duration;
+        if(lateness > 0)
+        {
+            ++Metrics.LateFrames;
+            Metrics.TotalLateness += lateness;
+            Metrics.MaxLateness = max(Metrics.MaxLateness, lateness);
+            if(Options.Late == PlayerOptions::Delay)
+                Deadline = Now;
+        }
+
+        State = Showing;
+        Index = index;
+        if(frame->p->SoundEffect)
+        {
+            Step.Sound = frame->p->SoundEffect;
+            Step.SoundFrame = frame;
+            Step.SoundFrameIndex = static_cast<uint16_t>(index);
+            Step.SoundStart = Deadline;
+        }
+        Deadline += duration;
+        ++Entered;
+        Step.Lateness = lateness;
+        Step.Animation = Current;
+        Step.Frame = frame;
+        Step.FrameIndex = static_cast<uint16_t>(index);
+        Step.FrameEntered = true;
+        return true;
+    }
+    return false;
+}
+
+// Leaves the shown frame, or starts the queue, and enters the next frame
+// to show, finishing animations on the way
+void AnimationPlayerPrivate::Transition()
+{
+    uint32_t index = 0;
+    if(State == Showing)
+        index = NextIndex();
+    else if(!Begin(index))
+    {
+        State = Idle;
+        return;
+    }
+
+    for(int i = 0; i < PLAYER_MAX_TRANSITIONS; ++i)
+    {
+        if(Enter(index))
+            return;
+
+        ++Step.Completed;
+        Step.NominalDuration = AnimationNominal;
+        Step.AchievedDuration = max(Now, Deadline) - AnimationStart;
+        ++Metrics.Animations;
+        Metrics.NominalTime += Step.NominalDuration;
+        Metrics.AchievedTime += Step.AchievedDuration;
+        AnimationStarted = false;
+        Held = Returning ? nullptr : Current;
+        if(!Begin(index))
+        {
+            State = Idle;
+            Stopping = false;
+            return;
+        }
+    }
+    // the rest is picked up by the next step
+    State = Starting;
+}
+
+void AnimationPlayerPrivate::StartStep()
+{
+    Step.FrameEntered = false;
+    Step.Sound = nullptr;
+    Step.SoundFrame = nullptr;
+    Step.SoundFrameIndex = 0;
+    Step.SoundStart = 0;
+    Step.Lateness = 0;
+    Step.Completed = 0;
+    Step.NominalDuration = 0;
+    Step.AchievedDuration = 0;
+    Entered = 0;
+}
+
+void AnimationPlayerPrivate::FinishStep()
+{
+    // only the last frame entered in a step gets on screen
+    if(Entered > 0)
+    {
+        ++Metrics.FramesShown;
+        Metrics.FramesSkipped += Entered - 1;
+        Entered = 0;
+    }
+    Step.Deadline = State == Idle ? AnimationPlayer::Never : Deadline;
+    Step.Stopping = Stopping;
+}
+
+AnimationPlayer::AnimationPlayer(uint64_t seed, const PlayerOptions &options)
+    :p(new AnimationPlayerPrivate)
+{
+    p->Random = seed;
+    p->Options = options;
+    p->Step.Deadline = Never;
+}
+
+AnimationPlayer::~AnimationPlayer()
+{
+    delete p;
+}
+
+void AnimationPlayer::Play(const Animation *animation)
+{
+    if(!animation)
+        return;
+
+    p->Queue.push_back(animation);
+    if(p->State == AnimationPlayerPrivate::Idle)
+    {
+        p->State = AnimationPlayerPrivate::Starting;
+        p->Deadline = p->Now;
+    }
+    else if(p->State == AnimationPlayerPrivate::Showing)
+        p->Stopping = true;
+    p->FinishStep();
+}
+
+void AnimationPlayer::Stop()
+{
+    if(p->State == AnimationPlayerPrivate::Showing)
+        p->Stopping = true;
+    p->FinishStep();
+}
+
+void AnimationPlayer::Reset()
+{
+    p->Queue.clear();
+    p->Head = 0;
+    p->State = AnimationPlayerPrivate::Idle;
+    p->Current = nullptr;
+    p->Held = nullptr;
+    p->Stopping = false;
+    p->Returning = false;
+    p->AnimationStarted = false;
+    p->Step = PlayerStep();
+    p->FinishStep();
+}
+
+const PlayerStep& AnimationPlayer::Advance(uint64_t elapsed)
+{
+    ACS_TRACE_SCOPE("playback", "AnimationPlayer::Advance");
+    p->StartStep();
+    p->Now += elapsed;
+    // skipping follows every frame due by now, the other policies show
+    // the first one and leave the rest to the steps after
+    for(int i = 0; i < PLAYER_MAX_TRANSITIONS && p->State != AnimationPlayerPrivate::Idle
+                   && p->Deadline <= p->Now
+                   && (p->Options.Late == PlayerOptions::Skip || !p->Step.FrameEntered); ++i)
+        p->Transition();
+    p->FinishStep();
+    return p->Step;
+}
+
+const PlayerStep& AnimationPlayer::Next()
+{
+    p->StartStep();
+    if(p->State != AnimationPlayerPrivate::Idle)
+    {
+        if(p->Deadline > p->Now)
+            p->Now = p->Deadline;
+        p->Transition();
+    }
+    p->FinishStep();
+    return p->Step;
+}
+
+const PlayerStep& AnimationPlayer::Current() const
+{
+    return p->Step;
+}
+
+uint64_t AnimationPlayer::Now() const
+{
+    return p->Now;
+}
+
+bool AnimationPlayer::Playing() const
+{
+    return p->State != AnimationPlayerPrivate::Idle;
+}
+
+size_t AnimationPlayer::Queued() const
+{
+    return p->Queue.size() - p->Head;
+}
+
+PlayerOptions AnimationPlayer::Options() const
+{
+    return p->Options;
+}
+
+void AnimationPlayer::SetOptions(const PlayerOptions &options)
+{
+    p->Options = options;
+}
+
+PlayerMetrics AnimationPlayer::Metrics() const
+{
+    return p->Metrics;
+}
+
+void AnimationPlayer::ResetMetrics()
+{
+    p->Metrics = PlayerMetrics();
+}
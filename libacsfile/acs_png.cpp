@@ -0,0 +1,280 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Indexed PNG writer. The image data is deflated with LZ77 over hash
+// chains and the fixed Huffman codes, which is plenty for sprites where
+// most of a row is the transparent index.
+
+#include "acsfile.h"
+#include "acstrace.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#define DEFLATE_WINDOW      32768
+#define DEFLATE_HASH_BITS   15
+#define DEFLATE_MAX_CHAIN   64
+#define DEFLATE_MIN_MATCH   3
+#define DEFLATE_MAX_MATCH   258
+
+using namespace libacsfile;
+using namespace std;
+
+// Deflate writes its fields starting at the least significant bit
+class DeflateBits
+{
+public:
+    explicit DeflateBits(vector<uint8_t> &out) : out(out) {}
+
+    void Put(uint32_t value, int count)
+    {
+        bits |= static_cast<uint64_t>(value) << used;
+        used += count;
+        while(used >= 8)
+        {
+            out.push_back(static_cast<uint8_t>(bits));
+            bits >>= 8;
+            used -= 8;
+        }
+    }
+
+    // Huffman codes are stored most significant bit first
+    void PutCode(uint32_t code, int count)
+    {
+        uint32_t reversed = 0;
+        for(int i = 0; i < count; ++i)
+            reversed |= ((code >> i) & 1) << (count - 1 - i);
+        Put(reversed, count);
+    }
+
+    void Flush()
+    {
+        if(used > 0)
+            out.push_back(static_cast<uint8_t>(bits));
+        bits = 0;
+        used = 0;
+    }
+
+private:
+    vector<uint8_t> &out;
+    uint64_t bits = 0;
+    int used = 0;
+};
+
+static const uint16_t LengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DistanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DistanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static void PutLiteral(DeflateBits &bits, uint32_t symbol)
+{
+    if(symbol < 144)
+        bits.PutCode(0x30 + symbol, 8);
+    else if(symbol < 256)
+        bits.PutCode(0x190 + symbol - 144, 9);
+    else if(symbol < 280)
+        bits.PutCode(symbol - 256, 7);
+    else
+        bits.PutCode(0xC0 + symbol - 280, 8);
+}
+
+static void PutMatch(DeflateBits &bits, uint32_t length, uint32_t distance)
+{
+    int code = 28;
+    while(LengthBase[code] > length)
+        --code;
+    PutLiteral(bits, 257 + code);
+    bits.Put(length - LengthBase[code], LengthExtra[code]);
+
+    code = 29;
+    while(DistanceBase[code] > distance)
+        --code;
+    bits.PutCode(code, 5);
+    bits.Put(distance - DistanceBase[code], DistanceExtra[code]);
+}
+
+static inline uint32_t HashDeflate(const uint8_t *p)
+{
+    uint32_t v = (p[0] << 16) | (p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+// zlib stream of one fixed Huffman block
+static vector<uint8_t> Deflate(const vector<uint8_t> &data)
+{
+    vector<uint8_t> out;
+    out.reserve(data.size() / 4 + 64);
+    out.push_back(0x78);
+    out.push_back(0x01);
+
+    DeflateBits bits(out);
+    bits.Put(1, 1);     // final block
+    bits.Put(1, 2);     // fixed codes
+
+    vector<int32_t> head(1 << DEFLATE_HASH_BITS, -1);
+    vector<int32_t> prev(DEFLATE_WINDOW, -1);
+    const size_t size = data.size();
+    auto insert = [&](size_t pos) {
+        if(pos + DEFLATE_MIN_MATCH > size)
+            return;
+        uint32_t h = HashDeflate(&data[pos]);
+        prev[pos % DEFLATE_WINDOW] = head[h];
+        head[h] = static_cast<int32_t>(pos);
+    };
+
+    size_t pos = 0;
+    while(pos < size)
+    {
+        uint32_t bestLength = 0, bestDistance = 0;
+        if(pos + DEFLATE_MIN_MATCH <= size)
+        {
+            const size_t maxLength = min<size_t>(DEFLATE_MAX_MATCH, size - pos);
+            int32_t candidate = head[HashDeflate(&data[pos])];
+            for(int chain = 0; candidate >= 0 && chain < DEFLATE_MAX_CHAIN; ++chain)
+            {
+                const size_t distance = pos - candidate;
+                if(distance > DEFLATE_WINDOW - 1)
+                    break;
+                uint32_t length = 0;
+                while(length < maxLength && data[candidate + length] == data[pos + length])
+                    ++length;
+                if(length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = static_cast<uint32_t>(distance);
+                    if(length == maxLength)
+                        break;
+                }
+                const int32_t next = prev[candidate % DEFLATE_WINDOW];
+                if(next >= candidate)
+                    break;
+                candidate = next;
+            }
+        }
+
+        if(bestLength >= DEFLATE_MIN_MATCH)
+        {
+            PutMatch(bits, bestLength, bestDistance);
+            for(uint32_t i = 0; i < bestLength; ++i)
+                insert(pos + i);
+            pos += bestLength;
+        }
+        else
+        {
+            PutLiteral(bits, data[pos]);
+            insert(pos);
+            ++pos;
+        }
+    }
+    PutLiteral(bits, 256);
+    bits.Flush();
+
+    uint32_t a = 1, b = 0;
+    for(size_t i = 0; i < size; ++i)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    uint32_t adler = (b << 16) | a;
+    for(int shift = 24; shift >= 0; shift -= 8)
+        out.push_back(static_cast<uint8_t>(adler >> shift));
+    return out;
+}
+
+static uint32_t CRC32(const uint8_t *data, size_t size, uint32_t crc = 0)
+{
+    static uint32_t table[256];
+    static bool ready = [] {
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for(int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)ready;
+
+    crc = ~crc;
+    for(size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void PutChunk(vector<uint8_t> &out, const char type[4], const uint8_t *data, size_t size)
+{
+    auto put32 = [&out](uint32_t v) {
+        for(int shift = 24; shift >= 0; shift -= 8)
+            out.push_back(static_cast<uint8_t>(v >> shift));
+    };
+    put32(static_cast<uint32_t>(size));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put32(CRC32(out.data() + start, out.size() - start));
+}
+
+vector<uint8_t> libacsfile::EncodePNG(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride,
+                                      const vector<RGBQUAD> &palette, int transparentIndex)
+{
+    ACS_TRACE_SCOPE("export", "EncodePNG");
+    const size_t colors = min<size_t>(max<size_t>(palette.size(), 1), 256);
+
+    // every row starts with filter type 0, palette images do best unfiltered
+    vector<uint8_t> raw;
+    raw.reserve((static_cast<size_t>(width) + 1) * height);
+    for(uint32_t row = 0; row < height; ++row)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), pixels + row * stride, pixels + row * stride + width);
+    }
+
+    vector<uint8_t> out = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    uint8_t header[13] = {};
+    for(int i = 0; i < 4; ++i)
+    {
+        header[i] = static_cast<uint8_t>(width >> (24 - 8 * i));
+        header[4 + i] = static_cast<uint8_t>(height >> (24 - 8 * i));
+    }
+    header[8] = 8;      // bits per index
+    header[9] = 3;      // palette
+    PutChunk(out, "IHDR", header, sizeof(header));
+
+    vector<uint8_t> plte(colors * 3, 0);
+    for(size_t i = 0; i < colors && i < palette.size(); ++i)
+    {
+        plte[i * 3] = palette[i].rgbRed;
+        plte[i * 3 + 1] = palette[i].rgbGreen;
+        plte[i * 3 + 2] = palette[i].rgbBlue;
+    }
+    PutChunk(out, "PLTE", plte.data(), plte.size());
+
+    // alpha of the entries up to the transparent one, the rest are opaque
+    if(transparentIndex >= 0 && static_cast<size_t>(transparentIndex) < colors)
+    {
+        vector<uint8_t> trns(transparentIndex + 1, 255);
+        trns[transparentIndex] = 0;
+        PutChunk(out, "tRNS", trns.data(), trns.size());
+    }
+
+    const vector<uint8_t> compressed = Deflate(raw);
+    PutChunk(out, "IDAT", compressed.data(), compressed.size());
+    PutChunk(out, "IEND", nullptr, 0);
+    return out;
+}
@@ -4,6 +4,7 @@
 
 #include "acs_private.h"
 #include "acsfile.h"
+#include "acstrace.h"
 
 #include <iostream>
 #include <fstream>
@@ -11,10 +12,15 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <cstring>
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <chrono>
 #include <stdlib.h>
 
 #define FLAG_VOICE_OUTPUT        (1u << 4)
@@ -33,54 +39,60 @@
 using namespace libacsfile;
 using namespace std;
 
-CharacterPrivate::CharacterPrivate(const string& filename)
+CharacterPrivate::CharacterPrivate(const string& filename, const LoadOptions &options)
+    :Options(options)
 {
-    bool error = false;
-    ifstream ifs(filename, ios::binary);
-    if (!ifs.is_open())
-        throw runtime_error("Cannot open file: " + filename);
+    const LoadClock::time_point loadStart = LoadClock::now();
 
-    // Load ACS header
-    uint16_t tempSig16;
-    ifs.read(reinterpret_cast<char*>(&tempSig16), sizeof(uint16_t));
-    if(ifs.fail())
+    // Read the whole file with a single read, everything below parses
+    // from memory
+    vector<uint8_t> fileData;
     {
-        ifs.close();
-        throw runtime_error("Failed to read ACS signature");
+        ifstream ifs(filename, ios::binary | ios::ate);
+        if (!ifs.is_open())
+            throw runtime_error("Cannot open file: " + filename);
+
+        streamoff fileSize = ifs.tellg();
+        if(fileSize < 0)
+            throw runtime_error("Cannot read file: " + filename);
+        fileData.resize(static_cast<size_t>(fileSize));
+        ifs.seekg(0, ios::beg);
+        if(!ifs.read(reinterpret_cast<char*>(fileData.data()), fileSize))
+            throw runtime_error("Cannot read file: " + filename);
     }
-    ifs.seekg(0, ios::beg);
+    Stats.FileBytes = fileData.size();
+    CountAllocation(fileData.size());
 
-    uint32_t tempSig;
-    ifs.read(reinterpret_cast<char*>(&tempSig), sizeof(uint32_t));
-    if(ifs.fail())
-    {
-        ifs.close();
+    // Load ACS header
+    ACSReader reader(fileData.data(), fileData.size());
+    if(reader.Size() < sizeof(uint32_t))
         throw runtime_error("Failed to read ACS signature");
-    }
+
+    uint16_t tempSig16{};
+    memcpy(&tempSig16, reader.Data(), sizeof(uint16_t));
+    uint32_t tempSig = reader.Read<uint32_t>();
+    Stats.HeaderTime = NanosecondsSince(loadStart);
 
     if(tempSig16 == UTOPIA_LE_MAGIC)
     {
         Type = Character::UtopiaLE;
-        LoadUtopiaLECharacter(ifs);
+        LoadUtopiaLECharacter(reader);
     }
     if(tempSig == AGENT_CHAR_150_MAGIC)
     {
         Type = Character::Agent15;
-        LoadACS15Character(ifs);
+        LoadACS15Character(reader);
     }
     if(tempSig == AGENT_CHAR_20_MAGIC)
     {
         Type = Character::Agent20;
-        LoadACS2Character(ifs);
+        LoadACS2Character(reader);
     }
 
     if(Type == Character::Invalid)
-    {
-        ifs.close();
         throw runtime_error("Invalid ACS file signature");
-    }
 
-    ifs.close();
+    Stats.TotalTime = NanosecondsSince(loadStart);
 }
 
 CharacterPrivate::~CharacterPrivate()
@@ -91,23 +103,22 @@ CharacterPrivate::~CharacterPrivate()
     for(auto&[k, ptr] : images) {
         delete ptr;
     }
+    for(auto&[k, ptr] : sounds) {
+        delete ptr;
+    }
 }
 
-void CharacterPrivate::LoadUtopiaLECharacter(std::ifstream &ifs)
+void CharacterPrivate::LoadUtopiaLECharacter(ACSReader &)
 {
     throw runtime_error("Utopia (BOB, Little Endian) character support unimplemented.");
 }
 
-void CharacterPrivate::LoadACS15Character(std::ifstream &ifs)
+void CharacterPrivate::LoadACS15Character(ACSReader &reader)
 {
-    uint32_t tempSig;
-    ifs.read(reinterpret_cast<char*>(&tempSig), sizeof(uint32_t));
-    if(ifs.fail())
-    {
-        ifs.close();
+    if(reader.Size() < reader.Tell() + sizeof(uint32_t))
         throw runtime_error("Failed to read COM structured storage signature");
-    }
 
+    uint32_t tempSig = reader.Read<uint32_t>();
     if(tempSig == AGENT_CHAR_151_MAGIC)
     {
         // Handle COM Structured Storage document
@@ -116,73 +127,82 @@ void CharacterPrivate::LoadACS15Character(std::ifstream &ifs)
     throw runtime_error("Agent 1.5 character support unimplemented.");
 }
 
-void CharacterPrivate::LoadACS2Character(std::ifstream &ifs)
+void CharacterPrivate::LoadACS2Character(ACSReader &reader)
 {
-    ifs.read(reinterpret_cast<char*>(&ACS2CharacterInfo), sizeof(ACSLOCATOR));
-    if(ifs.fail())
-    {
-        ifs.close();
-        throw runtime_error("Failed to read ACS CharacterInfo Offset");
-    }
-    ifs.read(reinterpret_cast<char*>(&ACS2AnimationInfo), sizeof(ACSLOCATOR));
-    if(ifs.fail())
-    {
-        ifs.close();
-        throw runtime_error("Failed to read ACS AnimationList Offset");
-    }
-    ifs.read(reinterpret_cast<char*>(&ACS2ImageInfo), sizeof(ACSLOCATOR));
-    if(ifs.fail())
-    {
-        ifs.close();
-        throw runtime_error("Failed to read ACS ImageList Offset");
-    }
-    ifs.read(reinterpret_cast<char*>(&ACS2AudioInfo), sizeof(ACSLOCATOR));
-    if(ifs.fail())
-    {
-        ifs.close();
-        throw runtime_error("Failed to read ACS AudioList Offset");
-    }
-
-    if(!LoadCharacterData(ifs))
-    {
-        ifs.close();
-        throw runtime_error("Failed to read ACS character metadata");
-    }
+    // Check every locator, count and cross reference against the file once,
+    // the loaders below read without any further checks
+    LoadClock::time_point phase = LoadClock::now();
+    ValidateACS2(reader);
+    Stats.ValidateTime = NanosecondsSince(phase);
+
+    phase = LoadClock::now();
+    reader.Seek(sizeof(uint32_t));
+    reader.Read(ACS2CharacterInfo);
+    reader.Read(ACS2AnimationInfo);
+    reader.Read(ACS2ImageInfo);
+    reader.Read(ACS2AudioInfo);
+    Stats.HeaderTime += NanosecondsSince(phase);
+
+    phase = LoadClock::now();
+    LoadCharacterData(reader);
+    Stats.CharacterInfoTime = NanosecondsSince(phase);
 
     // We process image & audio data first before animations
     // so that we may link pointers to the animation data
-    if(!LoadImageData(ifs))
-    {
-        ifs.close();
-        throw runtime_error("Failed to read ACS images");
-    }
-
-    if(!LoadSoundData(ifs))
-    {
-        ifs.close();
-        throw runtime_error("Failed to read ACS sounds");
-    }
-
-    if(!LoadAnimationData(ifs))
-    {
-        ifs.close();
-        throw runtime_error("Failed to read ACS animations");
-    }
+    // ImagePrivate accumulates the decode time, the rest is reading
+    phase = LoadClock::now();
+    LoadImageData(reader);
+    Stats.ImageReadTime = NanosecondsSince(phase) - Stats.ImageDecodeTime;
+
+    phase = LoadClock::now();
+    if(Options.DeduplicateImages)
+        DeduplicateImages();
+
+    if(Options.BuildTransparentRuns)
+        BuildTransparentRuns();
+    // frames pick their kernels as they load and need these
+    SelectImageKernels();
+    Stats.PostProcessTime = NanosecondsSince(phase);
+
+    phase = LoadClock::now();
+    LoadSoundData(reader);
+    Stats.SoundTime = NanosecondsSince(phase);
+
+    phase = LoadClock::now();
+    LoadAnimationData(reader);
+    Stats.AnimationTime = NanosecondsSince(phase);
+
+    phase = LoadClock::now();
+    if(Options.DeltaEncodeImages)
+        DeltaEncodeImages();
+    // images keep where their rows are from here on
+    BindImageRows();
+    if(Options.PackAtlas)
+        PackAtlas();
+    Stats.PostProcessTime += NanosecondsSince(phase);
 
     // TODO: add pointers to states
     acsValid = true;
 }
 
-uint32_t CharacterPrivate::DecodeData(const vector<uint8_t>& src, vector<uint8_t>& trg, uint32_t offset = 0)
+uint32_t CharacterPrivate::DecodeData(const vector<uint8_t>& src, vector<uint8_t>& trg, uint32_t offset)
 {
+    if(offset > trg.size())
+        return 0;
+    return DecodeData(src.data(), src.size(), trg.data() + offset, trg.size() - offset) + offset;
+}
+
+uint32_t CharacterPrivate::DecodeData(const uint8_t *src, size_t srcSize, uint8_t *trg, size_t trgSize)
+{
+    ACS_TRACE_SCOPE("load", "DecodeData");
     // Implementation from Double Agent
-    if (src.size() <= 7 || src[0] != 0)
+    if (srcSize <= 7 || src[0] != 0)
         return 0;
 
-    const uint8_t* lSrcPtr = src.data();
-    const uint8_t* lSrcEnd = src.data() + src.size();
-    uint8_t* lTrgPtr = trg.data()+offset;
-    uint8_t* lTrgEnd = trg.data() + trg.size();
+    const uint8_t* lSrcPtr = src;
+    const uint8_t* lSrcEnd = src + srcSize;
+    uint8_t* lTrgPtr = trg;
+    uint8_t* lTrgEnd = trg + trgSize;
 
     uint32_t lSrcQuad = 0;
     uint8_t  lTrgByte = 0;
@@ -248,6 +268,7 @@ uint32_t CharacterPrivate::DecodeData(const vector<uint8_t>& src, vector<uint8_t
             lSrcPtr += (lBitCount / 8);
             lBitCount &= 7;
 
+            if (lSrcPtr > lSrcEnd) break;
             memcpy(&lRunLgth, lSrcPtr - sizeof(uint32_t), sizeof(uint32_t));
             lRunCount = 0;
             while (lRunLgth & (1u << ((lBitCount + lRunCount) & 0xFFFF)))
@@ -263,7 +284,7 @@ uint32_t CharacterPrivate::DecodeData(const vector<uint8_t>& src, vector<uint8_t
             lBitCount += lRunCount * 2 + 1;
 
             if (lTrgPtr + lRunLgth > lTrgEnd) break;
-            if (lTrgPtr < trg.data() + lSrcQuad) break;
+            if (lTrgPtr < trg + lSrcQuad) break;
 
             while (static_cast<long>(lRunLgth) > 0)
             {
@@ -285,43 +306,42 @@ uint32_t CharacterPrivate::DecodeData(const vector<uint8_t>& src, vector<uint8_t
         lBitCount &= 7;
     }
 
-    return static_cast<uint32_t>(lTrgPtr - trg.data());
+    return static_cast<uint32_t>(lTrgPtr - trg);
 }
 
-bool CharacterPrivate::LoadCharacterData(ifstream &ifs)
+void CharacterPrivate::LoadCharacterData(ACSReader &reader)
 {
+    ACS_TRACE_SCOPE("load", "LoadCharacterData");
     // Load ACSCHARACTERINFO
     ACSLOCATOR localizedInfoLocator{};
-    ifs.seekg(ACS2CharacterInfo.Offset, ios::beg);
-    if (ifs.fail()) return false;
+    reader.Seek(ACS2CharacterInfo.Offset);
     // Reading ACSCHARACTERINFO fields
-    if (!ifs.read(reinterpret_cast<char*>(&MinorVersion), sizeof(uint16_t))) return false;
-    if (!ifs.read(reinterpret_cast<char*>(&MajorVersion), sizeof(uint16_t))) return false;
-    if (!ifs.read(reinterpret_cast<char*>(&localizedInfoLocator), sizeof(ACSLOCATOR))) return false;
-    if (!ifs.read(reinterpret_cast<char*>(&CharacterID), sizeof(GUID))) return false;
-    if (!ifs.read(reinterpret_cast<char*>(&CharacterWidth), sizeof(uint16_t))) return false;
-    if (!ifs.read(reinterpret_cast<char*>(&CharacterHeight), sizeof(uint16_t))) return false;
-    if (!ifs.read(reinterpret_cast<char*>(&TransparentColorIndex), sizeof(uint8_t))) return false;
-    if (!ifs.read(reinterpret_cast<char*>(&Flags), sizeof(uint32_t))) return false;
-    if (!ifs.read(reinterpret_cast<char*>(&AnimationSetMajorVersion), sizeof(uint16_t))) return false;
-    if (!ifs.read(reinterpret_cast<char*>(&AnimationSetMinorVersion), sizeof(uint16_t))) return false;
+    reader.Read(MinorVersion);
+    reader.Read(MajorVersion);
+    reader.Read(localizedInfoLocator);
+    reader.Read(CharacterID);
+    reader.Read(CharacterWidth);
+    reader.Read(CharacterHeight);
+    reader.Read(TransparentColorIndex);
+    reader.Read(Flags);
+    reader.Read(AnimationSetMajorVersion);
+    reader.Read(AnimationSetMinorVersion);
 
     // Reading VOICEINFO fields
     // some characters (like the o2k assistants) do not have these fields
     if(Flags & CHAR_STYLE_TTS)
     {
-        if (!ifs.read(reinterpret_cast<char*>(&EngineID), sizeof(GUID))) return false;
-        if (!ifs.read(reinterpret_cast<char*>(&ModeID), sizeof(GUID))) return false;
-        if (!ifs.read(reinterpret_cast<char*>(&Speed), sizeof(uint32_t))) return false;
-        if (!ifs.read(reinterpret_cast<char*>(&Pitch), sizeof(uint16_t))) return false;
-        bool hasExtraData = false;
-        if (!ifs.read(reinterpret_cast<char*>(&hasExtraData), sizeof(bool))) return false;
-        if (hasExtraData) {
-            if (!ifs.read(reinterpret_cast<char*>(&LangID), sizeof(uint16_t))) return false;
-            Dialect = ReadString(ifs);
-            if (!ifs.read(reinterpret_cast<char*>(&Gender), sizeof(uint16_t))) return false;
-            if (!ifs.read(reinterpret_cast<char*>(&Age), sizeof(uint16_t))) return false;
-            Style = ReadString(ifs);
+        reader.Read(EngineID);
+        reader.Read(ModeID);
+        reader.Read(Speed);
+        reader.Read(Pitch);
+        VoiceExtraData = reader.Read<uint8_t>() != 0;
+        if (VoiceExtraData) {
+            reader.Read(LangID);
+            Dialect = ReadString(reader);
+            reader.Read(Gender);
+            reader.Read(Age);
+            Style = ReadString(reader);
         }
     }
 
@@ -329,210 +349,559 @@ bool CharacterPrivate::LoadCharacterData(ifstream &ifs)
     bool hasBaloonInfo = true;
     if(hasBaloonInfo)
     {
-        if (!ifs.read(reinterpret_cast<char*>(&TextLines), sizeof(uint8_t))) return false;
-        if (!ifs.read(reinterpret_cast<char*>(&CharsPerLine), sizeof(uint8_t))) return false;
-        if (!ifs.read(reinterpret_cast<char*>(&ForegroundColor), sizeof(RGBQUAD))) return false;
-        if (!ifs.read(reinterpret_cast<char*>(&BackgroundColor), sizeof(RGBQUAD))) return false;
-        if (!ifs.read(reinterpret_cast<char*>(&BorderColor), sizeof(RGBQUAD))) return false;
-        FontName = ReadString(ifs);
-        if (!ifs.read(reinterpret_cast<char*>(&FontHeight), sizeof(int32_t))) return false;
-        if (!ifs.read(reinterpret_cast<char*>(&FontWeight), sizeof(int32_t))) return false;
-        if (!ifs.read(reinterpret_cast<char*>(&Italicized), sizeof(bool))) return false;
-        if (!ifs.read(reinterpret_cast<char*>(&UnknownBalloonFlag), sizeof(uint8_t))) return false;
+        reader.Read(TextLines);
+        reader.Read(CharsPerLine);
+        reader.Read(ForegroundColor);
+        reader.Read(BackgroundColor);
+        reader.Read(BorderColor);
+        FontName = ReadString(reader);
+        reader.Read(FontHeight);
+        reader.Read(FontWeight);
+        Italicized = reader.Read<uint8_t>() != 0;
+        reader.Read(UnknownBalloonFlag);
     }
 
     // Resuming ACSCHARACTERINFO fields
-    uint32_t paletteCount{};
-    if (!ifs.read(reinterpret_cast<char*>(&paletteCount), sizeof(paletteCount))) return false;
+    uint32_t paletteCount = reader.Read<uint32_t>();
     Palette.resize(paletteCount);
     if (paletteCount > 0)
-        if (!ifs.read(reinterpret_cast<char*>(Palette.data()), paletteCount * sizeof(RGBQUAD))) return false;
+    {
+        memcpy(Palette.data(), reader.Current(), paletteCount * sizeof(RGBQUAD));
+        reader.Skip(paletteCount * sizeof(RGBQUAD));
+        CountAllocation(paletteCount * sizeof(RGBQUAD));
+    }
 
-    if (!ifs.read(reinterpret_cast<char*>(&TrayIconEnabled), sizeof(bool))) return false;
+    TrayIconEnabled = reader.Read<uint8_t>() != 0;
     if(TrayIconEnabled)
     {
         // Reading TRAYICON fields
-        if (!ifs.read(reinterpret_cast<char*>(&MonoSize), sizeof(uint32_t))) return false;
-        if(MonoSize > 0)
-        {
-            // TODO: handle this rn we just seek over
-            ifs.seekg(MonoSize, ios::cur);
-        }
-        if (!ifs.read(reinterpret_cast<char*>(&ColorSize), sizeof(uint32_t))) return false;
-        if(ColorSize > 0)
-        {
-            // TODO: handle this rn we just seek over
-            ifs.seekg(ColorSize, ios::cur);
-        }
+        // TODO: decode, for now we only keep the raw bytes around
+        reader.Read(MonoSize);
+        MonoIconData.assign(reader.Current(), reader.Current() + MonoSize);
+        reader.Skip(MonoSize);
+        reader.Read(ColorSize);
+        ColorIconData.assign(reader.Current(), reader.Current() + ColorSize);
+        reader.Skip(ColorSize);
+        CountAllocation(MonoSize, MonoSize > 0);
+        CountAllocation(ColorSize, ColorSize > 0);
     }
 
     // Resuming ACSCHARACTERINFO fields
-    uint16_t stateCount{};
-    if (!ifs.read(reinterpret_cast<char*>(&stateCount), sizeof(stateCount))) return false;
+    uint16_t stateCount = reader.Read<uint16_t>();
     for (uint16_t i = 0; i < stateCount; i++) {
-        string stateName = ReadString(ifs);
+        string stateName = ReadString(reader);
         vector<string> stateAnimations;
-        uint16_t animationCount{};
-        if (!ifs.read(reinterpret_cast<char*>(&animationCount),
-                      sizeof(animationCount))) return false;
-        stateAnimations.resize(animationCount);
+        uint16_t animationCount = reader.Read<uint16_t>();
+        stateAnimations.reserve(animationCount);
         for (uint16_t i = 0; i < animationCount; i++) {
-            string animationName = ReadString(ifs);
+            string animationName = ReadString(reader);
             stateAnimations.push_back(animationName);
         }
         States[stateName] = stateAnimations;
     }
 
-    // load the ACSLOCALIZEDINFO data
-    uint16_t localizationCount{};
-    ifs.seekg(localizedInfoLocator.Offset, ios::beg);
-    if (ifs.fail()) return false;
-    if (!ifs.read(reinterpret_cast<char*>(&localizationCount), sizeof(uint16_t))) return false;
-
-    if(localizationCount > 0)
+    // index the ACSLOCALIZEDINFO data, strings are decoded on first use
+    reader.Seek(localizedInfoLocator.Offset);
+    uint16_t localizationCount = reader.Read<uint16_t>();
+    for(int i = 0; i < localizationCount; ++i)
     {
-        for(int i = 0; i < localizationCount; ++i)
+        uint16_t localeID = reader.Read<uint16_t>();
+        array<uint32_t, 3> strings{};
+        for(int j = 0; j < 3; ++j)
         {
-            uint16_t localeID;
-            if (!ifs.read(reinterpret_cast<char*>(&localeID), sizeof(uint16_t))) return false;
-            if(localeID == 9)
-            {
-                // TODO: handle all other localizations
-                CharacterName.assign(ReadString(ifs));
-                CharacterDescription.assign(ReadString(ifs));
-                CharacterExtraData.assign(ReadString(ifs));
-            }
-            else
-            {
-                for(int j = 0; j < 3; ++j)
-                    SkipString(ifs);
-            }
+            strings[j] = static_cast<uint32_t>(reader.Tell() - localizedInfoLocator.Offset);
+            SkipString(reader);
         }
+        LocalizedIndex.emplace(localeID, strings);
     }
 
-    return true;
+    const uint8_t *localized = reader.Data() + localizedInfoLocator.Offset;
+    LocalizedData.assign(localized, reader.Current());
+    CountAllocation(LocalizedData.size(), !LocalizedData.empty());
 }
 
-bool CharacterPrivate::LoadAnimationData(ifstream &ifs)
+void CharacterPrivate::LoadAnimationData(ACSReader &reader)
 {
-    uint32_t listcount = 0;
-    ifs.seekg(ACS2AnimationInfo.Offset, ios::beg);
-    if (ifs.fail()) return false;
-
-    if (!ifs.read(reinterpret_cast<char*>(&listcount), sizeof(uint32_t))) return false;
-    if (ifs.fail()) return false;
+    ACS_TRACE_SCOPE("load", "LoadAnimationData");
+    reader.Seek(ACS2AnimationInfo.Offset);
+    uint32_t listcount = reader.Read<uint32_t>();
 
     if(listcount > 0)
     {
         map<string, ACSLOCATOR> animationMap;
         for(int i = 0; i < listcount; i++)
         {
-            string animationName = ReadString(ifs);
-            ACSLOCATOR locator{};
-            if (!ifs.read(reinterpret_cast<char*>(&locator), sizeof(ACSLOCATOR))) return false;
-            animationMap[animationName] = locator;
+            string animationName = ReadString(reader);
+            animationMap[animationName] = reader.Read<ACSLOCATOR>();
         }
 
         for(map<string, ACSLOCATOR>::iterator it = animationMap.begin();
              it != animationMap.end();
              ++it)
         {
-            AnimationPrivate *animationInfo = new AnimationPrivate(ifs, it->second.Offset, this);
+            ACS_TRACE_SCOPE_DETAIL("load", "Animation", it->first);
+            AnimationPrivate *animationInfo = new AnimationPrivate(reader, it->second.Offset, this);
             animationInfo->DisplayName = it->first;
             Animation *publicAnimation = new Animation(animationInfo);
             animations[animationInfo->Name] = publicAnimation;
+            CountAllocation(sizeof(AnimationPrivate) + sizeof(Animation), 2);
+            Stats.Animations++;
         }
     }
-
-    return true;
 }
 
-bool CharacterPrivate::LoadImageData(ifstream &ifs)
+void CharacterPrivate::LoadImageData(ACSReader &reader)
 {
-    uint32_t listcount = 0;
-    ifs.seekg(ACS2ImageInfo.Offset, ios::beg);
-    if (ifs.fail()) return false;
-
-    if (!ifs.read(reinterpret_cast<char*>(&listcount), sizeof(uint32_t))) return false;
-    if (ifs.fail()) return false;
+    ACS_TRACE_SCOPE("load", "LoadImageData");
+    reader.Seek(ACS2ImageInfo.Offset);
+    uint32_t listcount = reader.Read<uint32_t>();
 
     if(listcount > 0)
     {
-        map<uint16_t, ACSLOCATOR> imageMap;
-        for(int i = 0; i < listcount; ++i)
+        vector<ACSLOCATOR> locators(listcount);
+        vector<uint32_t> checksums(listcount);
+        for(uint32_t i = 0; i < listcount; ++i)
         {
-            ACSLOCATOR locator{};
-            uint32_t checksum{};
-            if (!ifs.read(reinterpret_cast<char*>(&locator), sizeof(ACSLOCATOR))) return false;
-            if (!ifs.read(reinterpret_cast<char*>(&checksum), sizeof(uint32_t))) return false;
-            imageMap[i] = locator;
+            reader.Read(locators[i]);
+            reader.Read(checksums[i]);
         }
 
-        for(map<uint16_t, ACSLOCATOR>::iterator it = imageMap.begin();
-             it != imageMap.end();
-             ++it)
+        for(uint32_t i = 0; i < listcount; ++i)
         {
-            ImagePrivate *imageInfo = new ImagePrivate(ifs, it->second.Offset, this);
-            imageInfo->ImageID = it->first;
+            ImagePrivate *imageInfo = new ImagePrivate(reader, locators[i].Offset, this);
+            imageInfo->ImageID = i;
+            imageInfo->Checksum = checksums[i];
             Image *publicImage = new Image(imageInfo);
             imageInfo->PublicImage = publicImage;
-            images[it->first] = publicImage;
+            images[i] = publicImage;
+            CountAllocation(sizeof(ImagePrivate) + sizeof(Image), 2);
+            Stats.Images++;
         }
     }
-    return true;
 }
 
-bool CharacterPrivate::LoadSoundData(std::ifstream &ifs)
+// FNV-1a, 64 bit
+uint64_t libacsfile::HashImageData(const vector<uint8_t> &data)
 {
-    uint32_t listcount = 0;
-    ifs.seekg(ACS2AudioInfo.Offset, ios::beg);
-    if (ifs.fail()) return false;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(uint8_t b : data)
+    {
+        hash ^= b;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
 
-    if (!ifs.read(reinterpret_cast<char*>(&listcount), sizeof(uint32_t))) return false;
-    if (ifs.fail()) return false;
+void CharacterPrivate::DeduplicateImages()
+{
+    ACS_TRACE_SCOPE("load", "DeduplicateImages");
+    // Many characters store the same bitmap under several image IDs
+    // (blink frames, repeated poses). Point all copies at one buffer.
+    unordered_multimap<uint64_t, shared_ptr<vector<uint8_t>>> seen;
+    for(auto &[id, img] : images)
+    {
+        ImagePrivate *ip = img->p;
+        if(ip->ImageData->empty())
+            continue;
+
+        uint64_t hash = HashImageData(*ip->ImageData);
+        auto range = seen.equal_range(hash);
+        bool shared = false;
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            if(*it->second == *ip->ImageData)
+            {
+                DeduplicatedBytes += ip->ImageData->size();
+                ip->ImageData = it->second;
+                shared = true;
+                break;
+            }
+        }
+        if(!shared)
+            seen.emplace(hash, ip->ImageData);
+    }
+}
 
-    if(listcount > 0)
+void CharacterPrivate::BuildTransparentRuns()
+{
+    ACS_TRACE_SCOPE("load", "BuildTransparentRuns");
+    // deduplicated images share their pixel buffer, so they can share runs too
+    map<const vector<uint8_t>*, shared_ptr<TransparentRuns>> built;
+    for(auto &[id, img] : images)
     {
-        map<uint16_t, ACSLOCATOR> soundMap;
-        for(int i = 0; i < listcount; ++i)
+        ImagePrivate *ip = img->p;
+        auto it = built.find(ip->ImageData.get());
+        if(it != built.end())
         {
-            ACSLOCATOR locator{};
-            uint32_t checksum{};
-            if (!ifs.read(reinterpret_cast<char*>(&locator), sizeof(ACSLOCATOR))) return false;
-            if (!ifs.read(reinterpret_cast<char*>(&checksum), sizeof(uint32_t))) return false;
-            soundMap[i] = locator;
+            ip->Runs = it->second;
+            continue;
         }
+        ip->BuildTransparentRuns(TransparentColorIndex);
+        built[ip->ImageData.get()] = ip->Runs;
+        if(ip->Runs)
+            CountAllocation(sizeof(TransparentRuns)
+                            + ip->Runs->Rows.capacity() * sizeof(TransparentRuns::Row)
+                            + ip->Runs->Runs.capacity() * sizeof(TransparentRuns::Run)
+                            + ip->Runs->Pixels.capacity(),
+                            1 + !ip->Runs->Rows.empty() + !ip->Runs->Runs.empty()
+                            + !ip->Runs->Pixels.empty());
+    }
+}
 
-        for(map<uint16_t, ACSLOCATOR>::iterator it = soundMap.begin();
-             it != soundMap.end();
-             ++it)
+// Frames of talking/idle animations mostly differ in a small region.
+// Images shown by consecutive single-image frames are stored as the
+// dirty rectangle against their predecessor, chains are capped so that
+// rebuilding a bitmap never walks more than MAX_DELTA_CHAIN images. For
+// drawing, each also keeps the rows where it differs from its keyframe.
+
+void CharacterPrivate::DeltaEncodeImages()
+{
+    ACS_TRACE_SCOPE("load", "DeltaEncodeImages");
+    map<ImagePrivate*, ImagePrivate*> bases;
+    auto chainReaches = [&bases](ImagePrivate *from, ImagePrivate *to) {
+        for(auto it = bases.find(from); it != bases.end(); it = bases.find(it->second))
+            if(it->second == to)
+                return true;
+        return false;
+    };
+
+    for(auto &[name, animation] : animations)
+    {
+        const FrameImage *previous = nullptr;
+        for(auto &[index, frame] : animation->Frames())
         {
-            SoundPrivate *soundInfo = new SoundPrivate(ifs, it->second.Offset, it->second.Size, it->first);
-            if(soundInfo != nullptr)
+            auto frameImages = frame->Images();
+            const FrameImage *current = frameImages.size() == 1 ? frameImages[0] : nullptr;
+            if(previous && current && previous->GetImage() && current->GetImage()
+                && previous->OffsetX() == current->OffsetX()
+                && previous->OffsetY() == current->OffsetY())
             {
-                Sound *sound = new Sound(soundInfo);
-                sounds[it->first] = sound;
+                ImagePrivate *base = previous->GetImage()->p;
+                ImagePrivate *img = current->GetImage()->p;
+                if(base != img && base->Width == img->Width && base->Height == img->Height
+                    && base->ImageData != img->ImageData
+                    && bases.find(img) == bases.end()
+                    && !chainReaches(base, img))
+                    bases[img] = base;
             }
+            previous = current;
+        }
+    }
+
+    // break chains that got too long by promoting images to keyframes
+    // promoting erases from bases, so walk a copy of its keys
+    vector<ImagePrivate*> deltaImages;
+    deltaImages.reserve(bases.size());
+    for(auto &[img, base] : bases)
+        deltaImages.push_back(img);
+
+    map<ImagePrivate*, int> depth;
+    for(ImagePrivate *img : deltaImages)
+    {
+        vector<ImagePrivate*> chain;
+        for(ImagePrivate *it = img; it && depth.find(it) == depth.end();)
+        {
+            chain.push_back(it);
+            auto b = bases.find(it);
+            it = b == bases.end() ? nullptr : b->second;
+        }
+        for(auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            auto b = bases.find(*it);
+            int d = b == bases.end() ? 0 : depth[b->second] + 1;
+            if(d > MAX_DELTA_CHAIN)
+            {
+                bases.erase(b);
+                d = 0;
+            }
+            depth[*it] = d;
+        }
+    }
+
+    // compute every delta while all the bitmaps are still around
+    map<ImagePrivate*, unique_ptr<ImageDelta>> deltas;
+    for(auto &[img, base] : bases)
+    {
+        const uint32_t stride = img->Stride();
+        const size_t size = static_cast<size_t>(stride) * img->Height;
+        if(img->ImageData->size() < size || base->ImageData->size() < size)
+            continue;
+
+        uint32_t left = img->Width, right = 0, top = img->Height, bottom = 0;
+        for(uint32_t row = 0; row < img->Height; ++row)
+        {
+            size_t offset = static_cast<size_t>(img->Height - 1 - row) * stride;
+            const uint8_t *a = base->ImageData->data() + offset;
+            const uint8_t *b = img->ImageData->data() + offset;
+            if(memcmp(a, b, img->Width) == 0)
+                continue;
+
+            uint32_t l = 0, r = img->Width;
+            while(a[l] == b[l]) ++l;
+            while(a[r - 1] == b[r - 1]) --r;
+            left = min(left, l);
+            right = max(right, r);
+            top = min(top, row);
+            bottom = row + 1;
+        }
+
+        auto delta = make_unique<ImageDelta>();
+        delta->Base = base;
+        if(bottom > top)
+        {
+            delta->Left = left;
+            delta->Top = top;
+            delta->Width = right - left;
+            delta->Height = bottom - top;
+        }
+        // not worth it when most of the image changed
+        if(static_cast<size_t>(delta->Width) * delta->Height * 2 > size)
+            continue;
+
+        delta->Pixels.reserve(static_cast<size_t>(delta->Width) * delta->Height);
+        for(uint32_t row = top; row < bottom; ++row)
+        {
+            const uint8_t *src = img->ImageData->data()
+                                 + static_cast<size_t>(img->Height - 1 - row) * stride + left;
+            delta->Pixels.insert(delta->Pixels.end(), src, src + delta->Width);
+        }
+        deltas[img] = move(delta);
+    }
+
+    // and every delta image against its keyframe, so drawing one reads
+    // two images whatever the length of its chain. Images nearer the
+    // keyframe go first, one that would keep as many bytes as its bitmap
+    // stays a full image and the images after it use it as their keyframe.
+    vector<pair<int, ImagePrivate*>> order;
+    order.reserve(deltas.size());
+    for(auto &[img, delta] : deltas)
+        order.push_back({ depth[img], img });
+    sort(order.begin(), order.end());
+    for(auto &[d, img] : order)
+    {
+        ImageDelta *delta = deltas[img].get();
+        ImagePrivate *key = delta->Base;
+        for(auto it = deltas.find(key); it != deltas.end(); it = deltas.find(key))
+            key = it->second->Base;
+        delta->Key = key;
+
+        const uint32_t stride = img->Stride();
+        delta->KeySpans.resize(img->Height);
+        for(uint32_t row = 0; row < img->Height; ++row)
+        {
+            size_t offset = static_cast<size_t>(img->Height - 1 - row) * stride;
+            const uint8_t *a = key->ImageData->data() + offset;
+            const uint8_t *b = img->ImageData->data() + offset;
+            ImageDelta::Span &span = delta->KeySpans[row];
+            span = { 0, 0, static_cast<uint32_t>(delta->KeyPixels.size()) };
+            if(memcmp(a, b, img->Width) == 0)
+                continue;
+
+            uint32_t l = 0, r = img->Width;
+            while(a[l] == b[l]) ++l;
+            while(a[r - 1] == b[r - 1]) --r;
+            span.Left = static_cast<uint16_t>(l);
+            span.Right = static_cast<uint16_t>(r);
+            delta->KeyPixels.insert(delta->KeyPixels.end(), b + l, b + r);
         }
+
+        const size_t kept = delta->Pixels.size() + delta->KeyPixels.size()
+                          + delta->KeySpans.size() * sizeof(ImageDelta::Span);
+        if(kept >= img->ImageData->size())
+            deltas.erase(img);
+        else
+            delta->KeyPixels.shrink_to_fit();
+    }
+
+    for(auto &[img, delta] : deltas)
+    {
+        const size_t kept = delta->Pixels.size() + delta->KeyPixels.size()
+                          + delta->KeySpans.size() * sizeof(ImageDelta::Span);
+        // deduplicated buffers are still referenced by other images
+        if(img->ImageData.use_count() == 1)
+            DeltaSavedBytes += img->ImageData->size() - kept;
+        CountAllocation(sizeof(ImageDelta) + delta->Pixels.capacity() + sizeof(vector<uint8_t>)
+                        + delta->KeyPixels.capacity() + delta->KeySpans.capacity() * sizeof(ImageDelta::Span),
+                        2 + !delta->Pixels.empty() + !delta->KeyPixels.empty() + !delta->KeySpans.empty());
+        img->ImageData = make_shared<vector<uint8_t>>();
+        // a run table holds the pixels again, drawing goes by the keyframe
+        img->Runs.reset();
+        img->Delta = move(delta);
+        img->Kernel = nullptr;
+    }
+}
+
+// Full bitmaps are packed into shelves of LoadOptions::AtlasPageSize pages, in
+// the order animations first show them so that the sprites of one
+// animation end up next to each other. Deduplicated images share a slot.
+
+void CharacterPrivate::PackAtlas()
+{
+    ACS_TRACE_SCOPE("load", "PackAtlas");
+    vector<ImagePrivate*> order;
+    order.reserve(images.size());
+    // image IDs are the indexes of the image list
+    vector<bool> queued(images.size());
+    auto queue = [&](Image *img) {
+        if(!img || !img->p->Rows || img->p->ImageID >= queued.size() || queued[img->p->ImageID])
+            return;
+        queued[img->p->ImageID] = true;
+        order.push_back(img->p);
+    };
+    for(auto &[name, animation] : animations)
+        for(auto &[index, frame] : animation->Frames())
+        {
+            for(const FrameImage *fimg : frame->Images())
+                queue(fimg->GetImage());
+            for(const Overlay *overlay : frame->MouthOverlays())
+                queue(overlay->Image());
+        }
+    for(auto &[id, img] : images)
+        queue(img);
+
+    struct Shelf {
+        uint32_t Page = 0;
+        uint32_t X = 0;
+        uint32_t Y = 0;
+        uint32_t Height = 0;
+    };
+    const uint32_t pageSize = max<uint32_t>(Options.AtlasPageSize, 1);
+    vector<AtlasPage> pages;
+    map<const vector<uint8_t>*, AtlasRect> slots;
+    // first image of each slot, it fills the slot for all of them
+    vector<ImagePrivate*> owners;
+    Shelf shelf;
+    for(ImagePrivate *img : order)
+    {
+        const vector<uint8_t> *data = img->ImageData.get();
+        auto slot = slots.find(data);
+        if(slot != slots.end())
+        {
+            img->AtlasSlot = slot->second;
+            continue;
+        }
+
+        if(pages.empty() || img->Width > pages[shelf.Page].Width)
+        {
+            pages.push_back({ static_cast<uint16_t>(max<uint32_t>(pageSize, img->Width)), 0, {} });
+            shelf = { static_cast<uint32_t>(pages.size() - 1), 0, 0, 0 };
+        }
+        if(shelf.X + img->Width > pages[shelf.Page].Width)
+            shelf = { shelf.Page, 0, shelf.Y + shelf.Height, 0 };
+        if(shelf.Y + img->Height > max<uint32_t>(pageSize, img->Height) && shelf.Y > 0)
+        {
+            pages.push_back({ static_cast<uint16_t>(max<uint32_t>(pageSize, img->Width)), 0, {} });
+            shelf = { static_cast<uint32_t>(pages.size() - 1), 0, 0, 0 };
+        }
+
+        AtlasRect rect;
+        rect.Page = static_cast<uint16_t>(shelf.Page);
+        rect.X = static_cast<uint16_t>(shelf.X);
+        rect.Y = static_cast<uint16_t>(shelf.Y);
+        rect.Width = img->Width;
+        rect.Height = img->Height;
+        img->AtlasSlot = rect;
+        slots.emplace(data, rect);
+        owners.push_back(img);
+
+        shelf.X += img->Width;
+        shelf.Height = max<uint32_t>(shelf.Height, img->Height);
+        pages[shelf.Page].Height = static_cast<uint16_t>(max<uint32_t>(pages[shelf.Page].Height,
+                                                                       shelf.Y + shelf.Height));
+    }
+    if(pages.empty())
+        return;
+
+    // one buffer for every page, transparent where nothing was packed
+    vector<size_t> pageOffsets;
+    size_t total = 0;
+    for(const AtlasPage &page : pages)
+    {
+        pageOffsets.push_back(total);
+        total += static_cast<size_t>(page.Width) * page.Height;
+    }
+    Atlas.assign(total, TransparentColorIndex);
+    CountAllocation(total);
+    for(size_t i = 0; i < pages.size(); ++i)
+        pages[i].Pixels = { Atlas.data() + pageOffsets[i],
+                            static_cast<size_t>(pages[i].Width) * pages[i].Height };
+
+    auto slotRows = [&](const AtlasRect &rect) {
+        return Atlas.data() + pageOffsets[rect.Page] + static_cast<size_t>(rect.Y) * pages[rect.Page].Width + rect.X;
+    };
+    for(ImagePrivate *img : owners)
+    {
+        uint8_t *dst = slotRows(img->AtlasSlot);
+        for(uint32_t row = 0; row < img->Height; ++row)
+            memcpy(dst + static_cast<size_t>(row) * pages[img->AtlasSlot.Page].Width,
+                   img->Rows + row * img->RowPitch, img->Width);
+    }
+
+    auto released = make_shared<vector<uint8_t>>();
+    for(ImagePrivate *img : order)
+    {
+        const AtlasPage &page = pages[img->AtlasSlot.Page];
+        img->Rows = slotRows(img->AtlasSlot);
+        img->RowPitch = page.Width;
+        img->Packed = true;
+        img->ImageData = released;
     }
 
-    return true;
+    AtlasPages = move(pages);
+    Stats.AtlasPages = static_cast<uint32_t>(AtlasPages.size());
+    Stats.AtlasBytes = total;
 }
 
-string CharacterPrivate::ReadString(ifstream &ifs)
+void CharacterPrivate::BindImageRows()
+{
+    for(auto &[id, img] : images)
+        img->p->BindRows();
+}
+
+void CharacterPrivate::LoadSoundData(ACSReader &reader)
+{
+    ACS_TRACE_SCOPE("load", "LoadSoundData");
+    reader.Seek(ACS2AudioInfo.Offset);
+    uint32_t listcount = reader.Read<uint32_t>();
+
+    if(listcount > 0)
+    {
+        vector<ACSLOCATOR> locators(listcount);
+        vector<uint32_t> checksums(listcount);
+        for(uint32_t i = 0; i < listcount; ++i)
+        {
+            reader.Read(locators[i]);
+            reader.Read(checksums[i]);
+        }
+
+        for(uint32_t i = 0; i < listcount; ++i)
+        {
+            SoundPrivate *soundInfo = new SoundPrivate(reader, locators[i].Offset, locators[i].Size, i);
+            soundInfo->Checksum = checksums[i];
+            Sound *sound = new Sound(soundInfo);
+            sounds[i] = sound;
+            CountAllocation(sizeof(SoundPrivate) + sizeof(Sound), 2);
+            CountAllocation(soundInfo->RIFFData.size(), !soundInfo->RIFFData.empty());
+            Stats.Sounds++;
+            Stats.SoundBytes += soundInfo->RIFFData.size();
+        }
+    }
+}
+
+string CharacterPrivate::ReadString(ACSReader &reader)
 {
-    uint32_t length;
     string result;
-    result.clear();
-    if (!ifs.read(reinterpret_cast<char*>(&length), sizeof(uint32_t))) return result;
+    uint32_t length = reader.Read<uint32_t>();
     if (length == 0)
         return result;
 
-    vector<uint16_t> buf(length + 1); // include terminator
-    if (!ifs.read(reinterpret_cast<char*>(buf.data()), buf.size() * sizeof(uint16_t))) return result;
-    result.reserve(buf.size());
+    // include terminator
+    const uint8_t *units = reader.Current();
+    reader.Skip((static_cast<size_t>(length) + 1) * sizeof(uint16_t));
+    result.reserve(length);
 
-    for (uint16_t wc : buf) {
+    for (uint32_t i = 0; i < length; ++i) {
+        uint16_t wc = units[i * 2] | (units[i * 2 + 1] << 8);
         if (wc == L'\0') break; // stop at null terminator
         result.push_back(static_cast<char>(wc & 0xFF));
     }
@@ -564,17 +933,100 @@ std::vector<RGBQUAD> CharacterPrivate::BitmapPalette() const
     return Palette;
 }
 
-void CharacterPrivate::SkipString(ifstream &ifs)
+void CharacterPrivate::SkipString(ACSReader &reader)
 {
-    uint32_t length;
-    if (!ifs.read(reinterpret_cast<char*>(&length), sizeof(uint32_t))) return;
+    uint32_t length = reader.Read<uint32_t>();
     if (length == 0)
         return;
 
-    vector<uint16_t> buf(length + 1); // include terminator
-    if (!ifs.read(reinterpret_cast<char*>(buf.data()), buf.size() * sizeof(uint16_t))) return;
+    // include terminator
+    reader.Skip((static_cast<size_t>(length) + 1) * sizeof(uint16_t));
+}
+
+uint16_t CharacterPrivate::ResolveLangID(uint16_t langId) const
+{
+    if(LocalizedIndex.empty())
+        return 0;
+
+    if(LocalizedIndex.find(langId) != LocalizedIndex.end())
+        return langId;
+
+    // fall back to another sublanguage of the same primary language
+    for(auto &[id, strings] : LocalizedIndex)
+        if((id & 0x3FF) == (langId & 0x3FF))
+            return id;
 
-    return;
+    if(langId != LANG_ENGLISH_US)
+        return ResolveLangID(LANG_ENGLISH_US);
+
+    return LocalizedIndex.begin()->first;
+}
+
+string CharacterPrivate::LocalizedString(uint16_t langId, LocalizedField field)
+{
+    uint16_t resolved = ResolveLangID(langId);
+    auto entry = LocalizedIndex.find(resolved);
+    if(entry == LocalizedIndex.end())
+        return string();
+
+    lock_guard<mutex> lock(LocalizedLock);
+    auto key = make_pair(resolved, static_cast<int>(field));
+    auto cached = LocalizedCache.find(key);
+    if(cached != LocalizedCache.end())
+        return cached->second;
+
+    // UTF-16LE with a length prefix, converted to UTF-8
+    string result;
+    uint32_t offset = entry->second[field];
+    uint32_t length{};
+    memcpy(&length, LocalizedData.data() + offset, sizeof(uint32_t));
+    const uint8_t *units = LocalizedData.data() + offset + sizeof(uint32_t);
+    for(uint32_t i = 0; i < length; ++i)
+    {
+        uint32_t cp = units[i * 2] | (units[i * 2 + 1] << 8);
+        if(cp == 0)
+            break;
+        if(cp >= 0xD800 && cp < 0xDC00 && i + 1 < length)
+        {
+            uint32_t low = units[(i + 1) * 2] | (units[(i + 1) * 2 + 1] << 8);
+            if(low >= 0xDC00 && low < 0xE000)
+            {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                ++i;
+            }
+        }
+
+        if(cp < 0x80)
+            result.push_back(static_cast<char>(cp));
+        else if(cp < 0x800)
+        {
+            result.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            result.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else if(cp < 0x10000)
+        {
+            result.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            result.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            result.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            result.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    LocalizedCache[key] = result;
+    return result;
+}
+
+void CharacterPrivate::CountAllocation(uint64_t bytes, uint64_t count)
+{
+    Stats.Allocations += count;
+    if(count > 0)
+        Stats.AllocatedBytes += bytes;
 }
 
 string CharacterPrivate::GuidToString(GUID guid)
@@ -589,23 +1041,23 @@ string CharacterPrivate::GuidToString(GUID guid)
     return string(guid_cstr);
 }
 
-AnimationPrivate::AnimationPrivate(ifstream &ifs, uint32_t offset, CharacterPrivate *priv)
+AnimationPrivate::AnimationPrivate(ACSReader &reader, uint32_t offset, CharacterPrivate *priv)
     :c(priv)
 {
     //  ACSANIMATIONINFO type
-    ifs.seekg(offset, ios::beg);
-    if (ifs.fail()) return;
-    Name = CharacterPrivate::ReadString(ifs);
-    if (!ifs.read(reinterpret_cast<char*>(&Transition), sizeof(uint8_t))) return;
-    ReturnAnimation = CharacterPrivate::ReadString(ifs);
-
-    uint16_t frameCount{};
-    if (!ifs.read(reinterpret_cast<char*>(&frameCount), sizeof(uint16_t))) return;
+    reader.Seek(offset);
+    Name = CharacterPrivate::ReadString(reader);
+    Transition = static_cast<Animation::TransitionType>(reader.Read<uint8_t>());
+    ReturnAnimation = CharacterPrivate::ReadString(reader);
+
+    uint16_t frameCount = reader.Read<uint16_t>();
     for(int i = 0; i < frameCount; ++i)
     {
-        auto frame = new FramePrivate(ifs, c);
+        auto frame = new FramePrivate(reader, c);
         auto publicFrame = new Frame(frame);
         Frames[i] = publicFrame;
+        c->CountAllocation(sizeof(FramePrivate) + sizeof(Frame), 2);
+        c->Stats.Frames++;
     }
 }
 
@@ -615,214 +1067,627 @@ AnimationPrivate::~AnimationPrivate()
         delete ptr;
 }
 
-ImagePrivate::ImagePrivate(ifstream &ifs, uint32_t offset, CharacterPrivate *priv)
-    :c(priv)
+ImagePrivate::ImagePrivate(ACSReader &reader, uint32_t offset, CharacterPrivate *priv)
+    :ImageData(make_shared<vector<uint8_t>>())
+    ,c(priv)
 {
-    ifs.seekg(offset, ios::beg);
-    if (ifs.fail()) return;
-    if (!ifs.read(reinterpret_cast<char*>(&Unknown), sizeof(uint8_t))) return;
-    if (!ifs.read(reinterpret_cast<char*>(&Width), sizeof(uint16_t))) return;
-    if (!ifs.read(reinterpret_cast<char*>(&Height), sizeof(uint16_t))) return;
-    if (!ifs.read(reinterpret_cast<char*>(&Compressed), sizeof(bool))) return;
-
-    // read the image data
-    if (!ifs.read(reinterpret_cast<char*>(&ImageDataSize), sizeof(uint32_t))) return;
+    reader.Seek(offset);
+    reader.Read(Unknown);
+    reader.Read(Width);
+    reader.Read(Height);
+    Compressed = reader.Read<uint8_t>() != 0;
+
+    // read the image data, compressed images are decoded straight from
+    // the file buffer
+    reader.Read(ImageDataSize);
+    const size_t uncompressedSize = static_cast<size_t>(Stride()) * Height;
     if(ImageDataSize > 0)
     {
-        if(Compressed > 0)
+        if(Compressed)
         {
-            vector<uint8_t> ImageDataCompressed(ImageDataSize);
-            uint16_t uncompressedSize = ((Width + 3) & 0xFC) * Height;
-            if (!ifs.read(reinterpret_cast<char*>(ImageDataCompressed.data()), ImageDataCompressed.size()))
-                return;
-
-            ImageData.resize(uncompressedSize);
-            c->DecodeData(ImageDataCompressed, ImageData);
+            ImageData->resize(uncompressedSize);
+            const LoadClock::time_point decodeStart = LoadClock::now();
+            CharacterPrivate::DecodeData(reader.Current(), ImageDataSize,
+                                         ImageData->data(), ImageData->size());
+            c->Stats.ImageDecodeTime += NanosecondsSince(decodeStart);
+            c->Stats.CompressedImages++;
+            c->Stats.ImageCompressedBytes += ImageDataSize;
         }
         else
         {
-            ImageData.resize(ImageDataSize);
-
-            if (!ifs.read(reinterpret_cast<char*>(ImageData.data()), ImageDataSize))
-                return;
+            ImageData->assign(reader.Current(), reader.Current() + ImageDataSize);
+            // short bitmaps are padded so every row can be addressed
+            if(ImageData->size() < uncompressedSize)
+                ImageData->resize(uncompressedSize);
+            c->Stats.ImageStoredBytes += ImageDataSize;
         }
+        reader.Skip(ImageDataSize);
     }
+    c->Stats.ImageDecodedBytes += ImageData->size();
+    c->CountAllocation(sizeof(vector<uint8_t>) + ImageData->size(), 1 + !ImageData->empty());
+
     // Read the region data
-    uint32_t regionCompressedSize{};
-    uint32_t regionUncompressedSize{};
-    if (!ifs.read(reinterpret_cast<char*>(&regionCompressedSize), sizeof(uint32_t))) return;
-    if (!ifs.read(reinterpret_cast<char*>(&regionUncompressedSize), sizeof(uint32_t))) return;
-    if(regionCompressedSize > 0)
+    uint32_t regionCompressedSize = reader.Read<uint32_t>();
+    uint32_t regionUncompressedSize = reader.Read<uint32_t>();
+    RegionUncompressedSize = regionUncompressedSize;
+    RegionCompressed = regionCompressedSize > 0;
+    // TODO: decode, compressed region data or a raw RGNDATA structure
+    uint32_t regionSize = RegionCompressed ? regionCompressedSize : regionUncompressedSize;
+    RegionData.assign(reader.Current(), reader.Current() + regionSize);
+    reader.Skip(regionSize);
+    c->Stats.RegionBytes += regionSize;
+    c->CountAllocation(regionSize, regionSize > 0);
+}
+
+ImagePrivate::~ImagePrivate()
+{
+    ImageData.reset();
+}
+
+uint32_t ImagePrivate::Stride() const
+{
+    // DIB rows are padded to 4 bytes
+    return (static_cast<uint32_t>(Width) + 3) & ~3u;
+}
+
+void ImagePrivate::BindRows()
+{
+    const uint32_t stride = Stride();
+    Rows = nullptr;
+    RowPitch = 0;
+    if(Delta || Width == 0 || Height == 0 || ImageData->size() < static_cast<size_t>(stride) * Height)
+        return;
+
+    // DIBs are stored bottom-up
+    Rows = ImageData->data() + static_cast<size_t>(Height - 1) * stride;
+    RowPitch = -static_cast<ptrdiff_t>(stride);
+}
+
+void ImagePrivate::BuildTransparentRuns(uint8_t transparentIndex)
+{
+    const uint32_t stride = Stride();
+    if(ImageData->size() < static_cast<size_t>(stride) * Height)
+        return;
+
+    auto runs = make_shared<TransparentRuns>();
+    runs->Rows.reserve(Height + 1);
+    for(uint32_t row = 0; row < Height; ++row)
     {
-        // TODO: implement
-        // region data is compressed
+        runs->Rows.push_back({ static_cast<uint32_t>(runs->Runs.size()),
+                               static_cast<uint32_t>(runs->Pixels.size()) });
+
+        // DIBs are stored bottom-up
+        const uint8_t *src = ImageData->data() + static_cast<size_t>(Height - 1 - row) * stride;
+        uint32_t x = 0;
+        while(x < Width)
+        {
+            uint32_t skip = 0;
+            while(x < Width && src[x] == transparentIndex)
+            {
+                ++x;
+                ++skip;
+            }
+            if(x == Width)
+                break;
+
+            uint32_t start = x;
+            while(x < Width && src[x] != transparentIndex)
+                ++x;
+
+            runs->Runs.push_back({ static_cast<uint16_t>(skip), static_cast<uint16_t>(x - start) });
+            runs->Pixels.insert(runs->Pixels.end(), src + start, src + x);
+        }
     }
+    runs->Rows.push_back({ static_cast<uint32_t>(runs->Runs.size()),
+                           static_cast<uint32_t>(runs->Pixels.size()) });
+    runs->Runs.shrink_to_fit();
+    runs->Pixels.shrink_to_fit();
+    Runs = runs;
+}
+
+void ImagePrivate::Blit(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                        int x, int y, const uint32_t *palette) const
+{
+    const int rowBegin = max(0, -y);
+    const int rowEnd = min<int>(Height, targetHeight - y);
+    const int colBegin = max(0, -x);
+    const int colEnd = min<int>(Width, targetWidth - x);
+    if(rowBegin >= rowEnd || colBegin >= colEnd)
+        return;
+
+    if(Delta)
+        BlitAgainstKey(target, targetStride, x, y, rowBegin, rowEnd, colBegin, colEnd, palette);
     else
+        DrawRows(target, targetStride, x, y, rowBegin, rowEnd, colBegin, colEnd, palette);
+}
+
+// Draws the rows and columns of the image given, which lie inside the
+// target, from its own pixels
+void ImagePrivate::DrawRows(uint32_t *target, int targetStride, int x, int y,
+                            int rowBegin, int rowEnd, int colBegin, int colEnd,
+                            const uint32_t *palette) const
+{
+    if(rowBegin >= rowEnd || colBegin >= colEnd)
+        return;
+
+    uint32_t *dst = target + static_cast<ptrdiff_t>(y + rowBegin) * targetStride + x;
+    if(Kernel && colBegin == 0 && colEnd == Width)
     {
-        // TODO: implement
-        // uncompressed, data will be a raw RGNDATA structure
+        Kernel(Rows + rowBegin * RowPitch, RowPitch, Width, rowEnd - rowBegin, dst, targetStride, palette);
+        return;
     }
+
+    if(Runs)
+    {
+        for(int row = rowBegin; row < rowEnd; ++row, dst += targetStride)
+        {
+            const TransparentRuns::Row &r = Runs->Rows[row];
+            const TransparentRuns::Row &next = Runs->Rows[row + 1];
+            const uint8_t *src = Runs->Pixels.data() + r.FirstPixel;
+            int px = 0;
+            for(uint32_t i = r.FirstRun; i < next.FirstRun; ++i)
+            {
+                const TransparentRuns::Run &run = Runs->Runs[i];
+                px += run.Skip;
+                int begin = max(px, colBegin);
+                int end = min(px + run.Count, colEnd);
+                for(int col = begin; col < end; ++col)
+                    dst[col] = palette[src[col - px]];
+                px += run.Count;
+                src += run.Count;
+            }
+        }
+        return;
+    }
+
+    // no run table, walk every pixel
+    if(!Rows)
+        return;
+    for(int row = rowBegin; row < rowEnd; ++row, dst += targetStride)
+        BlitColorKeyed(Rows + row * RowPitch + colBegin, dst + colBegin, colEnd - colBegin, palette);
 }
 
-ImagePrivate::~ImagePrivate()
+// The palette has alpha 0xFF or 0, the top bit picks the pixel without a
+// branch so the loop vectorizes
+void ImagePrivate::BlitColorKeyed(const uint8_t *src, uint32_t *dst, int count, const uint32_t *palette)
 {
-    ImageData.clear();
+    for(int i = 0; i < count; ++i)
+    {
+        uint32_t argb = palette[src[i]];
+        uint32_t mask = static_cast<uint32_t>(static_cast<int32_t>(argb) >> 31);
+        dst[i] = (argb & mask) | (dst[i] & ~mask);
+    }
 }
 
-bool ImagePrivate::WriteToFile(std::filesystem::path file)
+// Rows equal to the keyframe's are drawn the way it draws them, the
+// others as the keyframe around the span that differs from it
+void ImagePrivate::BlitAgainstKey(uint32_t *target, int targetStride, int x, int y,
+                                  int rowBegin, int rowEnd, int colBegin, int colEnd,
+                                  const uint32_t *palette) const
 {
-    std::ofstream ofs(file, ios::out);
-    if(!ofs)
-        goto fail;
+    const ImagePrivate *key = Delta->Key;
+    if(!key || !key->Rows)
+        return;
 
-    BITMAPFILEHEADER fh;
-    fh.bfType = 0x4D42;
-    fh.bfSize = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + Width * Height * 3;
-    fh.bfReserved1 = 0;
-    fh.bfReserved2 = 0;
-    fh.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + sizeof(RGBQUAD)*c->BitmapPalette().size();
-
-    ofs.write(reinterpret_cast<char*>(&fh), sizeof(fh));
-
-    BITMAPINFO bi;
-    bi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bi.bmiHeader.biWidth = Width;
-    bi.bmiHeader.biHeight = Height;
-    bi.bmiHeader.biPlanes = 1;
-    bi.bmiHeader.biBitCount = 8;
-    bi.bmiHeader.biCompression = 0;
-    // 4 byte alignment
-    bi.bmiHeader.biSizeImage = (((Width+3)/4)*4)*Height;
-    bi.bmiHeader.biXPelsPerMeter = 0;
-    bi.bmiHeader.biYPelsPerMeter = 0;
-    bi.bmiHeader.biClrUsed = c->BitmapPalette().size();
-    bi.bmiHeader.biClrImportant = c->BitmapPalette().size();
-
-
-    ofs.write(reinterpret_cast<char*>(&bi.bmiHeader), sizeof(BITMAPINFOHEADER));
-    for (uint32_t i = 0; i < c->BitmapPalette().size(); i++)
-        ofs.write(reinterpret_cast<char*>(&c->BitmapPalette()[i]), sizeof(RGBQUAD));
-
-    ofs.write(reinterpret_cast<char*>(ImageData.data()), ImageData.size());
-    ofs.close();
-    return true;
-
-fail:
-    if(ofs.is_open())
-        ofs.close();
-    return false;
-}
-
-FramePrivate::FramePrivate(ifstream &ifs, CharacterPrivate *priv)
-    :c(priv)
-{
-    uint16_t frameImageCount{};
-    if (!ifs.read(reinterpret_cast<char*>(&frameImageCount), sizeof(uint16_t))) return;
-    for(int i = 0; i < frameImageCount; ++i)
+    const ImageDelta::Span *spans = Delta->KeySpans.data();
+    for(int row = rowBegin; row < rowEnd;)
     {
-        auto fr = new FrameImage();
-        uint32_t imgID{};
-        uint16_t offset_x{};
-        uint16_t offset_y{};
-        if (!ifs.read(reinterpret_cast<char*>(&imgID), sizeof(uint32_t)))
+        const ImageDelta::Span &span = spans[row];
+        const int left = max<int>(colBegin, span.Left);
+        const int right = min<int>(colEnd, span.Right);
+        if(left >= right)
         {
-            delete fr;
-            return;
+            int end = row + 1;
+            while(end < rowEnd && max<int>(colBegin, spans[end].Left) >= min<int>(colEnd, spans[end].Right))
+                ++end;
+            key->DrawRows(target, targetStride, x, y, row, end, colBegin, colEnd, palette);
+            row = end;
+            continue;
         }
-        if (!ifs.read(reinterpret_cast<char*>(&offset_x), sizeof(uint16_t)))
+
+        uint32_t *dst = target + static_cast<ptrdiff_t>(y + row) * targetStride + x;
+        if(key->Runs)
         {
-            delete fr;
-            return;
+            // one pass over the row's runs, leaving out the span
+            const TransparentRuns::Row &r = key->Runs->Rows[row];
+            const TransparentRuns::Row &next = key->Runs->Rows[row + 1];
+            const uint8_t *src = key->Runs->Pixels.data() + r.FirstPixel;
+            int px = 0;
+            for(uint32_t i = r.FirstRun; i < next.FirstRun; ++i)
+            {
+                const TransparentRuns::Run &run = key->Runs->Runs[i];
+                px += run.Skip;
+                const int begin = max(px, colBegin), end = min(px + run.Count, colEnd);
+                for(int col = begin; col < min(end, left); ++col)
+                    dst[col] = palette[src[col - px]];
+                for(int col = max(begin, right); col < end; ++col)
+                    dst[col] = palette[src[col - px]];
+                px += run.Count;
+                src += run.Count;
+            }
         }
-        if (!ifs.read(reinterpret_cast<char*>(&offset_y), sizeof(uint16_t)))
+        else
         {
-            delete fr;
-            return;
+            const uint8_t *keyRow = key->Rows + row * key->RowPitch;
+            BlitColorKeyed(keyRow + colBegin, dst + colBegin, left - colBegin, palette);
+            BlitColorKeyed(keyRow + right, dst + right, colEnd - right, palette);
         }
+        BlitColorKeyed(Delta->KeyPixels.data() + span.Offset + (left - span.Left), dst + left,
+                       right - left, palette);
+        ++row;
+    }
+}
 
-        fr->_OffsetX = offset_x;
-        fr->_OffsetY = offset_y;
+void ImagePrivate::BlitDelta(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                             int x, int y, const uint32_t *palette) const
+{
+    if(!Delta)
+    {
+        Blit(target, targetWidth, targetHeight, targetStride, x, y, palette);
+        return;
+    }
+
+    // transparent pixels are written too, they may uncover the base image
+    const int left = x + Delta->Left;
+    const int top = y + Delta->Top;
+    const int rowBegin = max(0, -top);
+    const int rowEnd = min<int>(Delta->Height, targetHeight - top);
+    const int colBegin = max(0, -left);
+    const int colEnd = min<int>(Delta->Width, targetWidth - left);
+    for(int row = rowBegin; row < rowEnd; ++row)
+    {
+        const uint8_t *src = Delta->Pixels.data() + static_cast<size_t>(row) * Delta->Width;
+        uint32_t *dst = target + static_cast<ptrdiff_t>(top + row) * targetStride + left;
+        for(int col = colBegin; col < colEnd; ++col)
+            dst[col] = palette[src[col]];
+    }
+}
 
-        auto imgPtr = c->FindImageByID(imgID);
-        if(imgPtr == nullptr)
+const vector<uint8_t> &ImagePrivate::Pixels(vector<uint8_t> &scratch) const
+{
+    if(!Delta && !Packed)
+        return *ImageData;
+
+    Materialize(scratch);
+    return scratch;
+}
+
+void ImagePrivate::Materialize(vector<uint8_t> &out) const
+{
+    if(Packed)
+    {
+        const uint32_t stride = Stride();
+        out.assign(static_cast<size_t>(stride) * Height, 0);
+        for(uint32_t row = 0; row < Height; ++row)
+            memcpy(out.data() + static_cast<size_t>(Height - 1 - row) * stride, Rows + row * RowPitch, Width);
+        return;
+    }
+    if(!Delta)
+    {
+        out.assign(ImageData->begin(), ImageData->end());
+        return;
+    }
+
+    Delta->Base->Materialize(out);
+    const uint32_t stride = Stride();
+    for(uint32_t row = 0; row < Delta->Height; ++row)
+    {
+        const uint8_t *src = Delta->Pixels.data() + static_cast<size_t>(row) * Delta->Width;
+        size_t offset = static_cast<size_t>(Height - 1 - (Delta->Top + row)) * stride + Delta->Left;
+        memcpy(out.data() + offset, src, Delta->Width);
+    }
+}
+
+// Whole files are assembled in memory and written with one call
+static bool WriteBuffer(const std::filesystem::path &file, const uint8_t *data, size_t size)
+{
+    std::ofstream ofs(file, ios::out | ios::binary | ios::trunc);
+    if(!ofs)
+        return false;
+
+    ofs.write(reinterpret_cast<const char*>(data), size);
+    return static_cast<bool>(ofs);
+}
+
+bool ImagePrivate::WriteToFile(std::filesystem::path file)
+{
+    const vector<RGBQUAD> &palette = c->Palette;
+    const uint32_t pixelBytes = Stride() * Height;
+    const uint32_t offBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER)
+                           + sizeof(RGBQUAD) * palette.size();
+    // rows past the stored data stay zero
+    vector<uint8_t> out(offBits + pixelBytes, 0);
+
+    BITMAPFILEHEADER fh{};
+    fh.bfType = 0x4D42;
+    fh.bfSize = offBits + pixelBytes;
+    fh.bfOffBits = offBits;
+    memcpy(out.data(), &fh, sizeof(fh));
+
+    BITMAPINFOHEADER bi{};
+    bi.biSize = sizeof(BITMAPINFOHEADER);
+    bi.biWidth = Width;
+    bi.biHeight = Height;
+    bi.biPlanes = 1;
+    bi.biBitCount = 8;
+    bi.biCompression = 0;
+    bi.biSizeImage = pixelBytes;
+    bi.biClrUsed = palette.size();
+    bi.biClrImportant = palette.size();
+    memcpy(out.data() + sizeof(fh), &bi, sizeof(bi));
+    if(!palette.empty())
+        memcpy(out.data() + sizeof(fh) + sizeof(bi), palette.data(), sizeof(RGBQUAD) * palette.size());
+
+    vector<uint8_t> scratch;
+    const vector<uint8_t> &pixels = Pixels(scratch);
+    memcpy(out.data() + offBits, pixels.data(), min<size_t>(pixels.size(), pixelBytes));
+
+    return WriteBuffer(file, out.data(), out.size());
+}
+
+// QOI, see https://qoiformat.org/qoi-specification.pdf
+#define QOI_OP_INDEX  0x00
+#define QOI_OP_DIFF   0x40
+#define QOI_OP_LUMA   0x80
+#define QOI_OP_RUN    0xc0
+#define QOI_OP_RGB    0xfe
+#define QOI_OP_RGBA   0xff
+
+vector<uint8_t> ImagePrivate::EncodeQOI() const
+{
+    struct RGBA {
+        uint8_t r, g, b, a;
+        bool operator==(const RGBA &o) const { return memcmp(this, &o, sizeof(RGBA)) == 0; }
+    };
+
+    // The source only has 256 colors, so the RGBA value and the index
+    // hash of every palette entry are computed once up front
+    RGBA colors[256] = {};
+    uint8_t hashes[256];
+    for(size_t i = 0; i < 256; ++i)
+    {
+        if(i < c->Palette.size() && i != c->TransparentColorIndex)
+            colors[i] = { c->Palette[i].rgbRed, c->Palette[i].rgbGreen, c->Palette[i].rgbBlue, 255 };
+        const RGBA &px = colors[i];
+        hashes[i] = (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+    }
+
+    vector<uint8_t> scratch;
+    const vector<uint8_t> &pixels = Pixels(scratch);
+    const uint32_t stride = Stride();
+
+    // header, worst case of 5 bytes a pixel, end marker
+    vector<uint8_t> out(14 + static_cast<size_t>(Width) * Height * 5 + 8);
+    uint8_t *o = out.data();
+    auto put32 = [&o](uint32_t v) {
+        *o++ = v >> 24; *o++ = v >> 16; *o++ = v >> 8; *o++ = v;
+    };
+    *o++ = 'q'; *o++ = 'o'; *o++ = 'i'; *o++ = 'f';
+    put32(Width);
+    put32(Height);
+    *o++ = 4;   // RGBA
+    *o++ = 0;   // sRGB with linear alpha
+
+    RGBA index[64] = {};
+    RGBA prev = { 0, 0, 0, 255 };
+    uint32_t run = 0;
+    const size_t total = static_cast<size_t>(Width) * Height;
+    size_t n = 0;
+    for(uint32_t y = 0; y < Height; ++y)
+    {
+        // DIB rows are bottom-up, QOI is top-down
+        size_t rowOffset = static_cast<size_t>(Height - 1 - y) * stride;
+        const uint8_t *row = rowOffset + Width <= pixels.size() ? pixels.data() + rowOffset : nullptr;
+        for(uint32_t x = 0; x < Width; ++x)
         {
-            delete fr;
-            return;
+            const uint8_t i = row ? row[x] : 0;
+            const RGBA &px = colors[i];
+            ++n;
+            if(px == prev)
+            {
+                if(++run == 62 || n == total)
+                {
+                    *o++ = QOI_OP_RUN | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+
+            if(run)
+            {
+                *o++ = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+
+            const uint8_t h = hashes[i];
+            if(index[h] == px)
+                *o++ = QOI_OP_INDEX | h;
+            else
+            {
+                index[h] = px;
+                if(px.a == prev.a)
+                {
+                    const int8_t vr = px.r - prev.r;
+                    const int8_t vg = px.g - prev.g;
+                    const int8_t vb = px.b - prev.b;
+                    const int8_t vgr = vr - vg;
+                    const int8_t vgb = vb - vg;
+                    if(vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                        *o++ = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                    else if(vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8)
+                    {
+                        *o++ = QOI_OP_LUMA | (vg + 32);
+                        *o++ = (vgr + 8) << 4 | (vgb + 8);
+                    }
+                    else
+                    {
+                        *o++ = QOI_OP_RGB;
+                        *o++ = px.r; *o++ = px.g; *o++ = px.b;
+                    }
+                }
+                else
+                {
+                    *o++ = QOI_OP_RGBA;
+                    *o++ = px.r; *o++ = px.g; *o++ = px.b; *o++ = px.a;
+                }
+            }
+            prev = px;
         }
+    }
 
-        fr->ImagePtr = imgPtr;
+    static const uint8_t endMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    memcpy(o, endMarker, sizeof(endMarker));
+    o += sizeof(endMarker);
+    out.resize(o - out.data());
+    return out;
+}
+
+bool ImagePrivate::WriteToQOIFile(std::filesystem::path file)
+{
+    vector<uint8_t> out = EncodeQOI();
+    return WriteBuffer(file, out.data(), out.size());
+}
+
+FramePrivate::FramePrivate(ACSReader &reader, CharacterPrivate *priv)
+    :c(priv)
+{
+    uint16_t frameImageCount = reader.Read<uint16_t>();
+    ImageIndexes.reserve(frameImageCount);
+    for(int i = 0; i < frameImageCount; ++i)
+    {
+        auto fr = new FrameImage();
+        uint32_t imgID = reader.Read<uint32_t>();
+        fr->_OffsetX = reader.Read<int16_t>();
+        fr->_OffsetY = reader.Read<int16_t>();
+        fr->ImagePtr = c->FindImageByID(imgID);
         ImageIndexes.push_back(fr);
     }
-    if (!ifs.read(reinterpret_cast<char*>(&AudioIndex), sizeof(uint16_t))) return;
-    if (!ifs.read(reinterpret_cast<char*>(&Duration), sizeof(uint16_t))) return;
-    if (!ifs.read(reinterpret_cast<char*>(&ExitFrameID), sizeof(int16_t))) return;
+    reader.Read(AudioIndex);
+    reader.Read(Duration);
+    reader.Read(ExitFrameID);
 
-    uint8_t branchCount{};
-    if (!ifs.read(reinterpret_cast<char*>(&branchCount), sizeof(uint8_t))) return;
+    uint8_t branchCount = reader.Read<uint8_t>();
+    Branches.reserve(branchCount);
     for(int i = 0; i < branchCount; ++i)
     {
         auto branch = new Branch;
-        if (!ifs.read(reinterpret_cast<char*>(&branch->_FrameID), sizeof(uint16_t))) return;
-        if (!ifs.read(reinterpret_cast<char*>(&branch->_Probability), sizeof(uint16_t))) return;
-
+        reader.Read(branch->_FrameID);
+        reader.Read(branch->_Probability);
         Branches.push_back(branch);
     }
 
-    uint8_t overlayCount{};
-    if (!ifs.read(reinterpret_cast<char*>(&overlayCount), sizeof(uint8_t))) return;
+    uint8_t overlayCount = reader.Read<uint8_t>();
+    MouthOverlays.reserve(overlayCount);
     for(int i = 0; i < overlayCount; ++i)
     {
-        auto overlay = new OverlayPrivate(ifs, c);
+        auto overlay = new OverlayPrivate(reader, c);
         auto overlayPublic = new Overlay(overlay);
         MouthOverlays.push_back(overlayPublic);
     }
 
     SoundEffect = c->FindSoundByID(AudioIndex);
-    return;
+    SelectKernel();
+
+    c->Stats.FrameImages += frameImageCount;
+    c->Stats.Branches += branchCount;
+    c->Stats.Overlays += overlayCount;
+    c->CountAllocation(frameImageCount * (sizeof(FrameImage) + sizeof(FrameImage*)),
+                       frameImageCount + (frameImageCount > 0));
+    c->CountAllocation(branchCount * (sizeof(Branch) + sizeof(Branch*)),
+                       branchCount + (branchCount > 0));
+    c->CountAllocation(overlayCount * (sizeof(OverlayPrivate) + sizeof(Overlay) + sizeof(Overlay*)),
+                       overlayCount * 2 + (overlayCount > 0));
 }
 
 FramePrivate::~FramePrivate()
 {
     for(auto &m : MouthOverlays)
         delete m;
+    for(auto &i : ImageIndexes)
+        delete i;
+    for(auto &b : Branches)
+        delete b;
 }
 
-OverlayPrivate::OverlayPrivate(ifstream &ifs, CharacterPrivate *priv)
+OverlayPrivate::OverlayPrivate(ACSReader &reader, CharacterPrivate *priv)
     :c(priv)
 {
-    if(!ifs.read(reinterpret_cast<char*>(&OverlayType), sizeof(uint8_t))) return;
-    if(!ifs.read(reinterpret_cast<char*>(&ReplaceTop), sizeof(bool))) return;
-    if(!ifs.read(reinterpret_cast<char*>(&ImageID), sizeof(uint16_t))) return;
-    if(!ifs.read(reinterpret_cast<char*>(&Unknown), sizeof(uint8_t))) return;
-    if(!ifs.read(reinterpret_cast<char*>(&HasRegionData), sizeof(bool))) return;
-    if(!ifs.read(reinterpret_cast<char*>(&OffsetX), sizeof(int16_t))) return;
-    if(!ifs.read(reinterpret_cast<char*>(&OffsetY), sizeof(int16_t))) return;
-    if(!ifs.read(reinterpret_cast<char*>(&Width), sizeof(uint16_t))) return;
-    if(!ifs.read(reinterpret_cast<char*>(&Height), sizeof(uint16_t))) return;
+    OverlayType = static_cast<Overlay::Type>(reader.Read<uint8_t>());
+    ReplaceTop = reader.Read<uint8_t>() != 0;
+    reader.Read(ImageID);
+    reader.Read(Unknown);
+    HasRegionData = reader.Read<uint8_t>() != 0;
+    reader.Read(OffsetX);
+    reader.Read(OffsetY);
+    reader.Read(Width);
+    reader.Read(Height);
     if(HasRegionData)
     {
-        // This region data should not be compressed
-        uint32_t dataSize{};
-        if(!ifs.read(reinterpret_cast<char*>(&dataSize), sizeof(uint32_t))) return;
-        RGNDATAHEADER regionHeader{};
-        if(!ifs.read(reinterpret_cast<char*>(&regionHeader), sizeof(RGNDATAHEADER))) return;
-        if(regionHeader.nCount > 0)
-        {
-            // TODO: finish impl, find an agent that uses this???
-        }
+        // RGNDATA in a size prefixed block, not compressed
+        // TODO: decode, find an agent that uses this???
+        uint32_t regionSize = reader.Read<uint32_t>();
+        RegionData.assign(reader.Current(), reader.Current() + regionSize);
+        reader.Skip(regionSize);
+        c->Stats.RegionBytes += regionSize;
+        c->CountAllocation(regionSize, regionSize > 0);
     }
+
+    Image = c->FindImageByID(ImageID);
 }
 
-SoundPrivate::SoundPrivate(std::ifstream &ifs, uint32_t offset, uint32_t size, uint32_t id)
+SoundPrivate::SoundPrivate(ACSReader &reader, uint32_t offset, uint32_t size, uint32_t id)
     :SoundID(id)
 {
-    ifs.seekg(offset, ios::beg);
-    if(ifs.fail())
-        return;
+    const uint8_t *data = reader.Data() + offset;
+    RIFFData.assign(data, data + size);
+    ParseRIFF();
+}
 
-    RIFFData.resize(size);
-    if(!ifs.read(reinterpret_cast<char*>(RIFFData.data()), size))
+void SoundPrivate::ParseRIFF()
+{
+    // RIFF <size> WAVE, followed by word aligned <id> <size> chunks
+    const uint8_t *data = RIFFData.data();
+    const size_t size = RIFFData.size();
+    if(size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
         return;
+
+    bool hasFormat = false;
+    bool hasData = false;
+    size_t pos = 12;
+    while(pos + 8 <= size && !(hasFormat && hasData))
+    {
+        uint32_t chunkSize{};
+        memcpy(&chunkSize, data + pos + 4, sizeof(uint32_t));
+        const uint8_t *chunk = data + pos + 8;
+        size_t available = min<size_t>(chunkSize, size - pos - 8);
+
+        if(memcmp(data + pos, "fmt ", 4) == 0 && available >= 16)
+        {
+            memcpy(&Format.FormatTag, chunk, sizeof(uint16_t));
+            memcpy(&Format.Channels, chunk + 2, sizeof(uint16_t));
+            memcpy(&Format.SampleRate, chunk + 4, sizeof(uint32_t));
+            memcpy(&Format.ByteRate, chunk + 8, sizeof(uint32_t));
+            memcpy(&Format.BlockAlign, chunk + 12, sizeof(uint16_t));
+            memcpy(&Format.BitsPerSample, chunk + 14, sizeof(uint16_t));
+            hasFormat = true;
+        }
+        else if(memcmp(data + pos, "data", 4) == 0)
+        {
+            // some files overstate the data size, clamp it to what is there
+            PCMOffset = pos + 8;
+            PCMSize = available;
+            hasData = true;
+        }
+
+        pos += 8 + static_cast<size_t>(chunkSize) + (chunkSize & 1);
+    }
+
+    if(!hasFormat || !hasData)
+    {
+        Format = WaveFormat{};
+        PCMOffset = 0;
+        PCMSize = 0;
+    }
 }
 
 SoundPrivate::~SoundPrivate()
@@ -832,16 +1697,5 @@ SoundPrivate::~SoundPrivate()
 
 bool SoundPrivate::WriteToFile(std::filesystem::path &file)
 {
-    std::ofstream ofs(file, ios::out);
-    if(!ofs)
-        goto fail;
-
-    ofs.write(reinterpret_cast<char*>(RIFFData.data()), RIFFData.size());
-    ofs.close();
-    return true;
-
-fail:
-    if(ofs.is_open())
-        ofs.close();
-    return false;
+    return WriteBuffer(file, RIFFData.data(), RIFFData.size());
 }
@@ -6,11 +6,16 @@
 #include <iostream>
 #include <fstream>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <memory>
 #include <filesystem>
 
 #define UTOPIA_BE_MAGIC         0x4C50
@@ -27,6 +32,11 @@
 #define CHAR_STYLE_NO_AUTO_PACE 0x00040000
 #define CHAR_STYLE_STANDARD     0x00100000
 
+#define LANG_ENGLISH_US         0x0409
+
+// Longest run of delta images before another keyframe
+#define MAX_DELTA_CHAIN         8
+
 #ifdef WIN32
 #include <windows.h>
 #else
@@ -68,15 +78,112 @@ struct ICONIMAGE {
 
 namespace libacsfile {
 
+    // Cursor over a character file held in memory. The ACS 2.0 structure is
+    // checked once by CharacterPrivate::ValidateACS2 before parsing starts,
+    // so reads through this cursor are not bounds checked.
+    class ACSReader
+    {
+    public:
+        ACSReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+        const uint8_t* Data() const { return data; }
+        size_t Size() const { return size; }
+        size_t Tell() const { return pos; }
+        const uint8_t* Current() const { return data + pos; }
+        void Seek(size_t offset) { pos = offset; }
+        void Skip(size_t count) { pos += count; }
+        template<typename T> void Read(T &value)
+        {
+            memcpy(&value, data + pos, sizeof(T));
+            pos += sizeof(T);
+        }
+        template<typename T> T Read()
+        {
+            T value;
+            Read(value);
+            return value;
+        }
+    private:
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+        size_t pos = 0;
+    };
+
+    // Wall clock for LoadStats phases
+    typedef std::chrono::steady_clock LoadClock;
+    inline uint64_t NanosecondsSince(LoadClock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(LoadClock::now() - start).count();
+    }
+
+    // Row-run encoding of an image over palette indices. Each row is a list
+    // of (transparent pixels to skip, opaque pixels to copy) pairs; the
+    // opaque indices of all runs are packed into Pixels. Rows are top-down.
+    struct TransparentRuns {
+        struct Run {
+            uint16_t Skip;
+            uint16_t Count;
+        };
+        struct Row {
+            uint32_t FirstRun;
+            uint32_t FirstPixel;
+        };
+        std::vector<Row> Rows;  // Height + 1 entries
+        std::vector<Run> Runs;
+        std::vector<uint8_t> Pixels;
+    };
+
+    uint64_t HashImageData(const std::vector<uint8_t> &data);
+
+    class ImagePrivate;
+    // Dirty rectangle of an image relative to the image it follows in an
+    // animation. Coordinates and rows are top-down.
+    struct ImageDelta {
+        ImagePrivate *Base = nullptr;
+        uint16_t Left{};
+        uint16_t Top{};
+        uint16_t Width{};
+        uint16_t Height{};
+        std::vector<uint8_t> Pixels;
+        // The image against the keyframe its chain starts from, what
+        // drawing it reads: per row the columns that differ, empty for
+        // rows equal to the keyframe's, and their pixels
+        struct Span {
+            uint16_t Left;
+            uint16_t Right;
+            uint32_t Offset;
+        };
+        ImagePrivate *Key = nullptr;
+        std::vector<Span> KeySpans;
+        std::vector<uint8_t> KeyPixels;
+    };
+
+    // Draws a whole image that lies inside the target. Source rows are
+    // walked from the top row with srcStride, negative for bottom-up DIBs.
+    typedef void (*BlitKernel)(const uint8_t *src, ptrdiff_t srcStride, int width, int height,
+                               uint32_t *dst, ptrdiff_t dstStride, const uint32_t *palette);
+
+    class FramePrivate;
+    // Clears the target and draws a frame, see Frame::Composite
+    typedef void (*CompositeKernel)(const FramePrivate *frame, uint32_t *target, int targetWidth,
+                                    int targetHeight, int targetStride, const uint32_t *palette,
+                                    const Overlay *mouth);
+
     class SoundPrivate {
     private:
         friend class Sound;
         friend class CharacterPrivate;
-        explicit SoundPrivate(std::ifstream &ifs, uint32_t offset, uint32_t size, uint32_t id);
+        friend class CharacterWriter;
+        explicit SoundPrivate(ACSReader &reader, uint32_t offset, uint32_t size, uint32_t id);
         ~SoundPrivate();
         bool WriteToFile(std::filesystem::path &file);
+        void ParseRIFF();
         uint32_t SoundID{};
+        uint32_t Checksum{};
         std::vector<uint8_t> RIFFData;
+        WaveFormat Format{};
+        // location of the "data" chunk payload inside RIFFData
+        size_t PCMOffset{};
+        size_t PCMSize{};
     };
 
     class CharacterPrivate;
@@ -85,16 +192,56 @@ namespace libacsfile {
     private:
         friend class libacsfile::Image;
         friend class libacsfile::CharacterPrivate;
-        explicit ImagePrivate(std::ifstream &ifs, uint32_t offset, CharacterPrivate *priv);
+        friend class libacsfile::FramePrivate;
+        friend class libacsfile::CharacterWriter;
+        explicit ImagePrivate(ACSReader &reader, uint32_t offset, CharacterPrivate *priv);
         ~ImagePrivate();
         bool WriteToFile(std::filesystem::path file);
+        bool WriteToQOIFile(std::filesystem::path file);
+        std::vector<uint8_t> EncodeQOI() const;
+        uint32_t Stride() const;
+        void BuildTransparentRuns(uint8_t transparentIndex);
+        void SelectKernel(uint8_t transparentIndex);
+        void Blit(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                  int x, int y, const uint32_t *palette) const;
+        void BlitDelta(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                       int x, int y, const uint32_t *palette) const;
+        void DrawRows(uint32_t *target, int targetStride, int x, int y,
+                      int rowBegin, int rowEnd, int colBegin, int colEnd,
+                      const uint32_t *palette) const;
+        void BlitAgainstKey(uint32_t *target, int targetStride, int x, int y,
+                            int rowBegin, int rowEnd, int colBegin, int colEnd,
+                            const uint32_t *palette) const;
+        static void BlitColorKeyed(const uint8_t *src, uint32_t *dst, int count, const uint32_t *palette);
+        const std::vector<uint8_t>& Pixels(std::vector<uint8_t> &scratch) const;
+        void Materialize(std::vector<uint8_t> &out) const;
+        void BindRows();
         uint32_t ImageID{};
         uint8_t Unknown{};
         uint16_t Width{};
         uint16_t Height{};
         bool Compressed{};
-        std::vector<uint8_t> ImageData;
+        // may be shared between several images when deduplicated
+        std::shared_ptr<std::vector<uint8_t>> ImageData;
+        // Top row of the full bitmap and the step to the row below, into
+        // ImageData or an atlas page. nullptr without a full bitmap.
+        const uint8_t *Rows = nullptr;
+        ptrdiff_t RowPitch = 0;
+        // set when ImageData was dropped in favour of the atlas
+        bool Packed{};
+        AtlasRect AtlasSlot{};
+        std::shared_ptr<TransparentRuns> Runs;
+        // set when ImageData was dropped in favour of a delta
+        std::unique_ptr<ImageDelta> Delta;
+        // no transparent pixels, set by SelectKernel
+        bool Opaque{};
+        // specialized for this image at load, nullptr without a full bitmap
+        BlitKernel Kernel = nullptr;
         uint32_t ImageDataSize;
+        uint32_t Checksum{};
+        bool RegionCompressed{};
+        uint32_t RegionUncompressedSize{};
+        std::vector<uint8_t> RegionData;
         BITMAPINFO *bi;
         libacsfile::Image *PublicImage = nullptr;
         libacsfile::CharacterPrivate *c = nullptr;
@@ -105,13 +252,16 @@ namespace libacsfile {
     private:
         friend class libacsfile::Overlay;
         friend class libacsfile::FramePrivate;
-        explicit OverlayPrivate(std::ifstream &ifs, CharacterPrivate *priv);
+        friend class libacsfile::CharacterWriter;
+        explicit OverlayPrivate(ACSReader &reader, CharacterPrivate *priv);
         Overlay::Type OverlayType{};
         bool ReplaceTop{};
         uint16_t ImageID{};
         libacsfile::Image* Image = nullptr;
         uint8_t Unknown{};
         bool HasRegionData{};
+        // RGNDATA as read, written back as is
+        std::vector<uint8_t> RegionData;
         int16_t OffsetX{};
         int16_t OffsetY{};
         uint16_t Width{};
@@ -124,8 +274,19 @@ namespace libacsfile {
     private:
         friend class Frame;
         friend class AnimationPrivate;
-        explicit FramePrivate(std::ifstream &ifs, CharacterPrivate *priv);
+        friend class CharacterWriter;
+        friend class AnimationPlayerPrivate;
+        explicit FramePrivate(ACSReader &reader, CharacterPrivate *priv);
         ~FramePrivate();
+        void SelectKernel();
+        void Draw(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                  const uint32_t *palette, const Overlay *mouth) const;
+        const Overlay* FindMouth(Overlay::Type type) const;
+        bool FollowsByDelta(const FramePrivate *previous) const;
+        template<bool Single, bool Covers, bool Overlays>
+        static void Composite(const FramePrivate *frame, uint32_t *target, int targetWidth,
+                              int targetHeight, int targetStride, const uint32_t *palette,
+                              const Overlay *mouth);
         std::vector<FrameImage*> ImageIndexes{};
         Sound* SoundEffect = nullptr;
         uint16_t AudioIndex{};
@@ -133,6 +294,7 @@ namespace libacsfile {
         int16_t ExitFrameID{};
         std::vector<Branch*> Branches{};
         std::vector<Overlay*> MouthOverlays{};
+        CompositeKernel Kernel = nullptr;
         libacsfile::CharacterPrivate *c = nullptr;
     };
 
@@ -141,7 +303,9 @@ namespace libacsfile {
     private:
         friend class libacsfile::Animation;
         friend class libacsfile::CharacterPrivate;
-        explicit AnimationPrivate(std::ifstream &ifs, uint32_t offset, CharacterPrivate *priv);
+        friend class libacsfile::CharacterWriter;
+        friend class libacsfile::AnimationPlayerPrivate;
+        explicit AnimationPrivate(ACSReader &reader, uint32_t offset, CharacterPrivate *priv);
         ~AnimationPrivate();
         std::string Name{};
         std::string DisplayName{};
@@ -154,26 +318,55 @@ namespace libacsfile {
     class CharacterPrivate
     {
     public:
-        static std::string ReadString(std::ifstream &ifs);
+        static std::string ReadString(ACSReader &reader);
+        static void SkipString(ACSReader &reader);
         Image* FindImageByID(uint16_t ImageID);
         Sound* FindSoundByID(uint16_t SoundID);
         std::vector<RGBQUAD> BitmapPalette() const;
-        uint32_t DecodeData(const std::vector<uint8_t> &src, std::vector<uint8_t> &trg, uint32_t offset);
+        static uint32_t DecodeData(const std::vector<uint8_t> &src, std::vector<uint8_t> &trg, uint32_t offset = 0);
+        static uint32_t DecodeData(const uint8_t *src, size_t srcSize, uint8_t *trg, size_t trgSize);
     private:
         friend class Character;
-        CharacterPrivate(const std::string& filename);
+        friend class CharacterWriter;
+        friend class ImagePrivate;
+        friend class AnimationPrivate;
+        friend class FramePrivate;
+        friend class OverlayPrivate;
+        friend class AnimationPlayerPrivate;
+        CharacterPrivate(const std::string& filename, const LoadOptions &options);
         ~CharacterPrivate();
         std::string GuidToString(GUID guid);
-        void LoadUtopiaLECharacter(std::ifstream &ifs);
-        void LoadACS15Character(std::ifstream &ifs);
-        void LoadACS2Character(std::ifstream &ifs);
-        bool LoadCharacterData(std::ifstream &ifs);
-        bool LoadAnimationData(std::ifstream &ifs);
-        bool LoadImageData(std::ifstream &ifs);
-        bool LoadSoundData(std::ifstream &ifs);
-        void SkipString(std::ifstream &ifs);
+        void LoadUtopiaLECharacter(ACSReader &reader);
+        void LoadACS15Character(ACSReader &reader);
+        void LoadACS2Character(ACSReader &reader);
+        void ValidateACS2(const ACSReader &reader);
+        void LoadCharacterData(ACSReader &reader);
+        void LoadAnimationData(ACSReader &reader);
+        void LoadImageData(ACSReader &reader);
+        void LoadSoundData(ACSReader &reader);
+        enum LocalizedField {
+            LocalizedName = 0,
+            LocalizedDescription = 1,
+            LocalizedExtraData = 2
+        };
+        uint16_t ResolveLangID(uint16_t langId) const;
+        std::string LocalizedString(uint16_t langId, LocalizedField field);
+        void DeduplicateImages();
+        void BuildTransparentRuns();
+        void SelectImageKernels();
+        void DeltaEncodeImages();
+        void PackAtlas();
+        void BindImageRows();
+        void CountAllocation(uint64_t bytes, uint64_t count = 1);
     private:
         bool acsValid;
+        LoadOptions Options{};
+        LoadStats Stats{};
+        uint64_t DeduplicatedBytes{};
+        uint64_t DeltaSavedBytes{};
+        // every atlas page back to back
+        std::vector<uint8_t> Atlas;
+        std::vector<AtlasPage> AtlasPages;
         GUID CharacterID{};
         GUID EngineID{};
         GUID ModeID{};
@@ -205,6 +398,7 @@ namespace libacsfile {
         uint16_t VoiceLangID{};
         uint16_t Gender{};
         uint16_t Age{};
+        bool VoiceExtraData = false;
         uint8_t TextLines;
         uint8_t CharsPerLine;
         bool Italicized = false;
@@ -216,16 +410,21 @@ namespace libacsfile {
         bool TrayIconEnabled = false;
         uint32_t MonoSize{};
         ICONIMAGE MonoBitmap{};
+        std::vector<uint8_t> MonoIconData;
         uint32_t ColorSize{};
         ICONIMAGE ColorBitmap{};
+        std::vector<uint8_t> ColorIconData;
         std::map<std::string, std::vector<std::string>> States;
         std::map<std::string, std::vector<libacsfile::Animation*>> StatePtrs;
 
-        // Fields correspond with ACSLOCALIZEDINFO
         uint16_t LangID{};
-        std::string CharacterName{};
-        std::string CharacterDescription{};
-        std::string CharacterExtraData{};
+
+        // Raw ACSLOCALIZEDINFO block, indexed by LANGID at load. Each entry
+        // holds the offsets of its name, description and extra data strings.
+        std::vector<uint8_t> LocalizedData;
+        std::map<uint16_t, std::array<uint32_t, 3>> LocalizedIndex;
+        std::map<std::pair<uint16_t, int>, std::string> LocalizedCache;
+        std::mutex LocalizedLock;
 
         std::map<std::string, libacsfile::Animation*> animations;
         std::map<uint16_t, libacsfile::Image*> images;
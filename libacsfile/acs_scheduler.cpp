@@ -0,0 +1,188 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// A binary min-heap of deadlines. Rescheduling pushes a new entry and
+// bumps the client's generation instead of searching the heap, stale
+// entries are dropped when they reach the top or when they outnumber the
+// live ones.
+
+#include "acsscheduler.h"
+#include "acstrace.h"
+
+#include <algorithm>
+
+// Stale entries tolerated on top of the live ones before compacting
+#define SCHEDULER_STALE_SLACK 64
+
+using namespace libacsfile;
+using namespace std;
+
+namespace libacsfile {
+    class FrameSchedulerPrivate {
+    private:
+        friend class FrameScheduler;
+        struct Entry {
+            uint64_t Deadline;
+            FrameScheduler::Client Client;
+            uint32_t Generation;
+        };
+        struct Slot {
+            uint64_t Deadline = FrameScheduler::Never;
+            uint32_t Generation = 0;
+            bool Used = false;
+        };
+        // earliest deadline on top
+        static bool Later(const Entry &a, const Entry &b) { return a.Deadline > b.Deadline; }
+        bool Stale(const Entry &entry) const;
+        void DropStale();
+        void Compact();
+
+        uint64_t Coalesce = 0;
+        size_t Scheduled = 0;
+        size_t Used = 0;
+        vector<Entry> Heap;
+        vector<Slot> Slots;
+        vector<FrameScheduler::Client> Free;
+    };
+}
+
+bool FrameSchedulerPrivate::Stale(const Entry &entry) const
+{
+    const Slot &slot = Slots[entry.Client];
+    return !slot.Used || slot.Generation != entry.Generation;
+}
+
+void FrameSchedulerPrivate::DropStale()
+{
+    while(!Heap.empty() && Stale(Heap.front()))
+    {
+        pop_heap(Heap.begin(), Heap.end(), Later);
+        Heap.pop_back();
+    }
+}
+
+void FrameSchedulerPrivate::Compact()
+{
+    Heap.erase(remove_if(Heap.begin(), Heap.end(), [this](const Entry &entry) { return Stale(entry); }),
+               Heap.end());
+    make_heap(Heap.begin(), Heap.end(), Later);
+}
+
+FrameScheduler::FrameScheduler(uint64_t coalesce)
+    :p(new FrameSchedulerPrivate)
+{
+    p->Coalesce = coalesce;
+}
+
+FrameScheduler::~FrameScheduler()
+{
+    delete p;
+}
+
+FrameScheduler::Client FrameScheduler::Add()
+{
+    Client client;
+    if(!p->Free.empty())
+    {
+        client = p->Free.back();
+        p->Free.pop_back();
+    }
+    else
+    {
+        client = static_cast<Client>(p->Slots.size());
+        p->Slots.emplace_back();
+    }
+    FrameSchedulerPrivate::Slot &slot = p->Slots[client];
+    slot.Used = true;
+    slot.Deadline = Never;
+    ++p->Used;
+    return client;
+}
+
+void FrameScheduler::Remove(Client client)
+{
+    if(client >= p->Slots.size() || !p->Slots[client].Used)
+        return;
+
+    Schedule(client, Never);
+    p->Slots[client].Used = false;
+    p->Free.push_back(client);
+    --p->Used;
+}
+
+void FrameScheduler::Schedule(Client client, uint64_t deadline)
+{
+    if(client >= p->Slots.size() || !p->Slots[client].Used)
+        return;
+
+    FrameSchedulerPrivate::Slot &slot = p->Slots[client];
+    if(slot.Deadline == deadline)
+        return;
+    if(slot.Deadline != Never)
+        --p->Scheduled;
+    // whatever entry the client had is stale from here on
+    ++slot.Generation;
+    slot.Deadline = deadline;
+    if(deadline == Never)
+        return;
+
+    ++p->Scheduled;
+    p->Heap.push_back({ deadline, client, slot.Generation });
+    push_heap(p->Heap.begin(), p->Heap.end(), FrameSchedulerPrivate::Later);
+    if(p->Heap.size() > p->Scheduled * 2 + SCHEDULER_STALE_SLACK)
+        p->Compact();
+}
+
+uint64_t FrameScheduler::Deadline(Client client) const
+{
+    if(client >= p->Slots.size() || !p->Slots[client].Used)
+        return Never;
+    return p->Slots[client].Deadline;
+}
+
+uint64_t FrameScheduler::NextWakeup()
+{
+    p->DropStale();
+    return p->Heap.empty() ? Never : p->Heap.front().Deadline;
+}
+
+size_t FrameScheduler::TakeDue(uint64_t now, vector<Client> &due)
+{
+    ACS_TRACE_SCOPE("playback", "FrameScheduler::TakeDue");
+    const uint64_t limit = now > Never - p->Coalesce ? Never - 1 : now + p->Coalesce;
+    size_t count = 0;
+    for(p->DropStale(); !p->Heap.empty() && p->Heap.front().Deadline <= limit; p->DropStale())
+    {
+        const Client client = p->Heap.front().Client;
+        pop_heap(p->Heap.begin(), p->Heap.end(), FrameSchedulerPrivate::Later);
+        p->Heap.pop_back();
+
+        FrameSchedulerPrivate::Slot &slot = p->Slots[client];
+        ++slot.Generation;
+        slot.Deadline = Never;
+        --p->Scheduled;
+        due.push_back(client);
+        ++count;
+    }
+    return count;
+}
+
+uint64_t FrameScheduler::Coalesce() const
+{
+    return p->Coalesce;
+}
+
+void FrameScheduler::SetCoalesce(uint64_t coalesce)
+{
+    p->Coalesce = coalesce;
+}
+
+size_t FrameScheduler::Clients() const
+{
+    return p->Used;
+}
+
+size_t FrameScheduler::Scheduled() const
+{
+    return p->Scheduled;
+}
@@ -0,0 +1,43 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Shared by the test executables, each one includes it once. A failed
+// CHECK is printed and counted, TestResult gives the exit code.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+static int failures = 0;
+
+#define CHECK(cond, what) \
+    do { if(!(cond)) { std::cerr << "FAIL " << what << std::endl; ++failures; } } while(0)
+
+static inline int TestResult()
+{
+    if(failures)
+        std::cerr << failures << " failures" << std::endl;
+    return failures ? 1 : 0;
+}
+
+static inline std::string WriteTemporary(const std::string &name, const std::vector<uint8_t> &data)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    ofs.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return path.string();
+}
+
+// splitmix64, for the tests' own choices
+static inline uint64_t NextRandom(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
@@ -0,0 +1,219 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#include "acstrace.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+using namespace libacsfile;
+using namespace std;
+
+#ifdef ACS_TRACING
+
+namespace {
+
+    struct TraceEvent {
+        const char *Category;
+        const char *Name;
+        std::string Detail;
+        uint64_t Start;     // ns since the trace started
+        uint64_t Duration;
+        uint32_t Thread;
+        bool Instant;
+    };
+
+    atomic<bool> enabled{false};
+    mutex traceLock;
+    string traceFile;
+    vector<TraceEvent> events;
+    chrono::steady_clock::time_point traceStart;
+    atomic<uint32_t> nextThread{1};
+
+    uint64_t Now()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()
+                                                          - traceStart).count();
+    }
+
+    uint32_t ThreadID()
+    {
+        static thread_local uint32_t id = nextThread.fetch_add(1);
+        return id;
+    }
+
+    void Record(TraceEvent &&event)
+    {
+        lock_guard<mutex> lock(traceLock);
+        if(enabled.load(memory_order_relaxed))
+            events.push_back(move(event));
+    }
+
+    string Escape(const string &text)
+    {
+        string result;
+        result.reserve(text.size());
+        for(char ch : text)
+        {
+            if(ch == '"' || ch == '\\')
+            {
+                result.push_back('\\');
+                result.push_back(ch);
+            }
+            else if(static_cast<unsigned char>(ch) < 0x20)
+            {
+                char buf[7];
+                snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                result += buf;
+            }
+            else
+                result.push_back(ch);
+        }
+        return result;
+    }
+
+    // Starts recording when ACS_TRACE is set, flushes at exit
+    struct EnvironmentTrace {
+        EnvironmentTrace()
+        {
+            const char *file = getenv("ACS_TRACE");
+            if(file && *file)
+                Trace::Start(file);
+        }
+        ~EnvironmentTrace()
+        {
+            Trace::Stop();
+        }
+    } environmentTrace;
+}
+
+bool Trace::Start(const string &filename)
+{
+    lock_guard<mutex> lock(traceLock);
+    if(enabled)
+        return true;
+
+    // fail early rather than losing the trace at exit
+    ofstream probe(filename, ios::binary | ios::trunc);
+    if(!probe)
+        return false;
+
+    traceFile = filename;
+    events.clear();
+    events.reserve(4096);
+    traceStart = chrono::steady_clock::now();
+    enabled = true;
+    return true;
+}
+
+void Trace::Stop()
+{
+    vector<TraceEvent> recorded;
+    string filename;
+    {
+        lock_guard<mutex> lock(traceLock);
+        if(!enabled)
+            return;
+        enabled = false;
+        recorded.swap(events);
+        filename.swap(traceFile);
+    }
+
+    // Timestamps are microseconds, as the trace event format expects
+    string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char buf[160];
+    for(size_t i = 0; i < recorded.size(); ++i)
+    {
+        const TraceEvent &e = recorded[i];
+        json += "{\"cat\":\"";
+        json += e.Category;
+        json += "\",\"name\":\"";
+        json += e.Name;
+        if(e.Instant)
+            snprintf(buf, sizeof(buf), "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",
+                     e.Start / 1000.0, e.Thread);
+        else
+            snprintf(buf, sizeof(buf), "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u",
+                     e.Start / 1000.0, e.Duration / 1000.0, e.Thread);
+        json += buf;
+        if(!e.Detail.empty())
+            json += ",\"args\":{\"detail\":\"" + Escape(e.Detail) + "\"}";
+        json += i + 1 < recorded.size() ? "},\n" : "}\n";
+    }
+    json += "]}\n";
+
+    ofstream ofs(filename, ios::binary | ios::trunc);
+    ofs.write(json.data(), json.size());
+}
+
+bool Trace::Enabled()
+{
+    return enabled.load(memory_order_relaxed);
+}
+
+void Trace::Instant(const char *category, const char *name, const string &detail)
+{
+    if(!Enabled())
+        return;
+
+    Record({ category, name, detail, Now(), 0, ThreadID(), true });
+}
+
+Trace::Scope::Scope(const char *category, const char *name)
+    :category(category)
+    ,name(name)
+{
+    if(!Enabled())
+        return;
+
+    active = true;
+    start = Now();
+}
+
+Trace::Scope::~Scope()
+{
+    if(!active)
+        return;
+
+    uint64_t end = Now();
+    Record({ category, name, move(detail), start, end - start, ThreadID(), false });
+}
+
+#else
+
+bool Trace::Start(const string &)
+{
+    return false;
+}
+
+void Trace::Stop()
+{
+}
+
+bool Trace::Enabled()
+{
+    return false;
+}
+
+void Trace::Instant(const char *, const char *, const string &)
+{
+}
+
+Trace::Scope::Scope(const char *category, const char *name)
+    :category(category)
+    ,name(name)
+{
+}
+
+Trace::Scope::~Scope()
+{
+}
+
+#endif
@@ -0,0 +1,349 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#include "acs_private.h"
+#include "acsfile.h"
+#include "acstrace.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace libacsfile;
+using namespace std;
+
+// Image and sound IDs are 16 bit inside the loader, 65535 means "no sound"
+#define VALIDATE_MAX_IMAGES     65536
+#define VALIDATE_MAX_SOUNDS     65535
+#define VALIDATE_NO_SOUND       65535
+
+// Upper bound for the LZ77 expansion of one compressed byte, keeps a
+// corrupt Width/Height from turning a tiny file into a huge allocation
+#define VALIDATE_MAX_RATIO      4096
+
+namespace {
+
+    string Hex(uint64_t value)
+    {
+        char buf[19];
+        snprintf(buf, sizeof(buf), "0x%llx", static_cast<unsigned long long>(value));
+        return string(buf);
+    }
+
+    // Bounds checked twin of ACSReader, every failure names the structure
+    // being read and the file offset
+    class CheckedReader
+    {
+    public:
+        explicit CheckedReader(const ACSReader &reader)
+            : data(reader.Data()), size(reader.Size()) {}
+
+        string Context;
+
+        [[noreturn]] void Fail(const string &message) const
+        {
+            throw runtime_error(Context + ": " + message);
+        }
+
+        void Seek(uint64_t offset, const char *what)
+        {
+            if(offset > size)
+                Fail(string(what) + " offset " + Hex(offset) + " is past the end of the file ("
+                     + Hex(size) + " bytes)");
+            pos = offset;
+        }
+
+        void Need(uint64_t count, const char *what) const
+        {
+            if(count > size - pos)
+                Fail(string(what) + " at offset " + Hex(pos) + " needs " + to_string(count)
+                     + " bytes, " + to_string(size - pos) + " left in the file");
+        }
+
+        template<typename T> T Read(const char *what)
+        {
+            Need(sizeof(T), what);
+            T value;
+            memcpy(&value, data + pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        void Skip(uint64_t count, const char *what)
+        {
+            Need(count, what);
+            pos += count;
+        }
+
+        void SkipString(const char *what)
+        {
+            uint32_t length = Read<uint32_t>(what);
+            if(length > 0)
+                Skip((static_cast<uint64_t>(length) + 1) * sizeof(uint16_t), what);
+        }
+
+        string ReadString(const char *what)
+        {
+            uint32_t length = Read<uint32_t>(what);
+            if(length == 0)
+                return string();
+
+            uint64_t bytes = (static_cast<uint64_t>(length) + 1) * sizeof(uint16_t);
+            Need(bytes, what);
+            string result;
+            for(uint32_t i = 0; i < length; ++i)
+            {
+                if(data[pos + i * 2] == 0 && data[pos + i * 2 + 1] == 0)
+                    break;
+                result.push_back(static_cast<char>(data[pos + i * 2]));
+            }
+            pos += bytes;
+            return result;
+        }
+
+        void CheckLocator(const ACSLOCATOR &locator, const char *what) const
+        {
+            if(static_cast<uint64_t>(locator.Offset) + locator.Size > size)
+                Fail(string(what) + " (offset " + Hex(locator.Offset) + ", "
+                     + to_string(locator.Size) + " bytes) runs past the end of the file ("
+                     + Hex(size) + " bytes)");
+        }
+
+        uint64_t Tell() const { return pos; }
+
+    private:
+        const uint8_t *data = nullptr;
+        uint64_t size = 0;
+        uint64_t pos = 0;
+    };
+
+    struct ListInfo {
+        uint32_t Count = 0;
+        uint64_t Entries = 0;
+    };
+
+    // Checks the count and entries of an image or sound list
+    ListInfo CheckList(CheckedReader &r, const ACSLOCATOR &locator, uint32_t maxCount,
+                       const char *name)
+    {
+        ListInfo list;
+        r.Context = string("ACS ") + name + " list";
+        r.Seek(locator.Offset, "list");
+        list.Count = r.Read<uint32_t>("entry count");
+        if(list.Count > maxCount)
+            r.Fail(to_string(list.Count) + " entries, at most " + to_string(maxCount)
+                   + " are supported");
+        list.Entries = r.Tell();
+        r.Need(static_cast<uint64_t>(list.Count) * (sizeof(ACSLOCATOR) + sizeof(uint32_t)),
+               "entries");
+        return list;
+    }
+}
+
+void CharacterPrivate::ValidateACS2(const ACSReader &reader)
+{
+    ACS_TRACE_SCOPE("load", "ValidateACS2");
+    CheckedReader r(reader);
+
+    // Header
+    r.Context = "ACS header";
+    r.Seek(sizeof(uint32_t), "locators");
+    ACSLOCATOR characterInfo = r.Read<ACSLOCATOR>("character info locator");
+    ACSLOCATOR animationInfo = r.Read<ACSLOCATOR>("animation list locator");
+    ACSLOCATOR imageInfo = r.Read<ACSLOCATOR>("image list locator");
+    ACSLOCATOR audioInfo = r.Read<ACSLOCATOR>("audio list locator");
+    r.CheckLocator(characterInfo, "character info");
+    r.CheckLocator(animationInfo, "animation list");
+    r.CheckLocator(imageInfo, "image list");
+    r.CheckLocator(audioInfo, "audio list");
+
+    // ACSCHARACTERINFO
+    r.Context = "ACS character info";
+    r.Seek(characterInfo.Offset, "character info");
+    r.Skip(2 * sizeof(uint16_t), "version");
+    ACSLOCATOR localizedInfo = r.Read<ACSLOCATOR>("localized info locator");
+    r.CheckLocator(localizedInfo, "localized info");
+    r.Skip(sizeof(GUID) + 2 * sizeof(uint16_t), "character id and size");
+    uint8_t transparentIndex = r.Read<uint8_t>("transparent color index");
+    uint32_t flags = r.Read<uint32_t>("flags");
+    r.Skip(2 * sizeof(uint16_t), "animation set version");
+
+    if(flags & CHAR_STYLE_TTS)
+    {
+        r.Context = "ACS voice info";
+        r.Skip(2 * sizeof(GUID) + sizeof(uint32_t) + sizeof(uint16_t), "engine");
+        if(r.Read<uint8_t>("extra data flag"))
+        {
+            r.Skip(sizeof(uint16_t), "language id");
+            r.SkipString("dialect");
+            r.Skip(2 * sizeof(uint16_t), "gender and age");
+            r.SkipString("style");
+        }
+    }
+
+    r.Context = "ACS balloon info";
+    r.Skip(2 * sizeof(uint8_t) + 3 * sizeof(RGBQUAD), "lines and colors");
+    r.SkipString("font name");
+    r.Skip(2 * sizeof(int32_t) + 2 * sizeof(uint8_t), "font attributes");
+
+    r.Context = "ACS character info";
+    uint32_t paletteCount = r.Read<uint32_t>("palette size");
+    r.Skip(static_cast<uint64_t>(paletteCount) * sizeof(RGBQUAD), "palette");
+    if(paletteCount > 0 && transparentIndex >= paletteCount)
+        r.Fail("transparent color index " + to_string(transparentIndex)
+               + " is outside the palette of " + to_string(paletteCount) + " colors");
+
+    if(r.Read<uint8_t>("tray icon flag"))
+    {
+        r.Skip(r.Read<uint32_t>("tray icon mask size"), "tray icon mask");
+        r.Skip(r.Read<uint32_t>("tray icon color size"), "tray icon color bitmap");
+    }
+
+    uint16_t stateCount = r.Read<uint16_t>("state count");
+    for(uint16_t i = 0; i < stateCount; ++i)
+    {
+        r.Context = "ACS state " + to_string(i);
+        r.SkipString("name");
+        uint16_t animationCount = r.Read<uint16_t>("animation count");
+        for(uint16_t j = 0; j < animationCount; ++j)
+            r.SkipString("animation name");
+    }
+
+    // ACSLOCALIZEDINFO
+    r.Context = "ACS localized info";
+    r.Seek(localizedInfo.Offset, "localized info");
+    uint16_t localizationCount = r.Read<uint16_t>("entry count");
+    for(uint16_t i = 0; i < localizationCount; ++i)
+    {
+        r.Context = "ACS localized info entry " + to_string(i);
+        r.Skip(sizeof(uint16_t), "language id");
+        r.SkipString("name");
+        r.SkipString("description");
+        r.SkipString("extra data");
+    }
+
+    // Image list and image blocks
+    ListInfo imageList = CheckList(r, imageInfo, VALIDATE_MAX_IMAGES, "image");
+    for(uint32_t i = 0; i < imageList.Count; ++i)
+    {
+        ACSLOCATOR locator{};
+        memcpy(&locator, reader.Data() + imageList.Entries
+                         + static_cast<uint64_t>(i) * (sizeof(ACSLOCATOR) + sizeof(uint32_t)),
+               sizeof(ACSLOCATOR));
+        r.Context = "ACS image " + to_string(i);
+        r.CheckLocator(locator, "image block");
+        r.Seek(locator.Offset, "image block");
+        r.Skip(sizeof(uint8_t), "header");
+        uint16_t width = r.Read<uint16_t>("width");
+        uint16_t height = r.Read<uint16_t>("height");
+        bool compressed = r.Read<uint8_t>("compression flag") != 0;
+        uint32_t dataSize = r.Read<uint32_t>("data size");
+        r.Skip(dataSize, "bitmap data");
+
+        uint64_t bitmapSize = static_cast<uint64_t>((width + 3u) & ~3u) * height;
+        if(compressed && dataSize > 0
+            && bitmapSize > (static_cast<uint64_t>(dataSize) + 64) * VALIDATE_MAX_RATIO)
+            r.Fail(to_string(width) + "x" + to_string(height) + " bitmap cannot be encoded in "
+                   + to_string(dataSize) + " compressed bytes");
+
+        uint32_t regionCompressed = r.Read<uint32_t>("region compressed size");
+        uint32_t regionUncompressed = r.Read<uint32_t>("region size");
+        r.Skip(regionCompressed > 0 ? regionCompressed : regionUncompressed, "region data");
+    }
+
+    // Sound list, the RIFF data itself is parsed leniently by SoundPrivate
+    ListInfo soundList = CheckList(r, audioInfo, VALIDATE_MAX_SOUNDS, "audio");
+    for(uint32_t i = 0; i < soundList.Count; ++i)
+    {
+        ACSLOCATOR locator{};
+        memcpy(&locator, reader.Data() + soundList.Entries
+                         + static_cast<uint64_t>(i) * (sizeof(ACSLOCATOR) + sizeof(uint32_t)),
+               sizeof(ACSLOCATOR));
+        r.Context = "ACS sound " + to_string(i);
+        r.CheckLocator(locator, "sound data");
+    }
+
+    // Animation list and animations, all references are checked against
+    // the image and sound lists
+    r.Context = "ACS animation list";
+    r.Seek(animationInfo.Offset, "animation list");
+    uint32_t animationCount = r.Read<uint32_t>("entry count");
+    vector<pair<string, ACSLOCATOR>> animationLocators;
+    animationLocators.reserve(min<uint32_t>(animationCount, 4096));
+    for(uint32_t i = 0; i < animationCount; ++i)
+    {
+        r.Context = "ACS animation list entry " + to_string(i);
+        string name = r.ReadString("name");
+        ACSLOCATOR locator = r.Read<ACSLOCATOR>("locator");
+        r.Context = "ACS animation '" + name + "'";
+        r.CheckLocator(locator, "animation");
+        animationLocators.emplace_back(move(name), locator);
+    }
+
+    for(auto &[name, locator] : animationLocators)
+    {
+        const string context = "ACS animation '" + name + "'";
+        r.Context = context;
+        r.Seek(locator.Offset, "animation");
+        r.SkipString("name");
+        uint8_t transition = r.Read<uint8_t>("transition type");
+        if(transition > Animation::TransitionNone)
+            r.Fail("unknown transition type " + to_string(transition));
+        r.SkipString("return animation");
+
+        uint16_t frameCount = r.Read<uint16_t>("frame count");
+        for(uint16_t f = 0; f < frameCount; ++f)
+        {
+            r.Context = context + " frame " + to_string(f);
+            uint16_t imageCount = r.Read<uint16_t>("image count");
+            for(uint16_t j = 0; j < imageCount; ++j)
+            {
+                uint32_t imageID = r.Read<uint32_t>("image id");
+                if(imageID >= imageList.Count)
+                    r.Fail("image " + to_string(j) + " references image " + to_string(imageID)
+                           + ", the file has " + to_string(imageList.Count));
+                r.Skip(2 * sizeof(int16_t), "image offset");
+            }
+
+            uint16_t audioIndex = r.Read<uint16_t>("audio index");
+            if(audioIndex != VALIDATE_NO_SOUND && audioIndex >= soundList.Count)
+                r.Fail("references sound " + to_string(audioIndex) + ", the file has "
+                       + to_string(soundList.Count));
+            r.Skip(sizeof(uint16_t), "duration");
+
+            int16_t exitFrame = r.Read<int16_t>("exit frame");
+            if(exitFrame >= frameCount)
+                r.Fail("exit frame " + to_string(exitFrame) + " is outside the "
+                       + to_string(frameCount) + " frames of the animation");
+
+            uint8_t branchCount = r.Read<uint8_t>("branch count");
+            for(uint8_t b = 0; b < branchCount; ++b)
+            {
+                uint16_t target = r.Read<uint16_t>("branch target");
+                if(target >= frameCount)
+                    r.Fail("branch " + to_string(b) + " targets frame " + to_string(target)
+                           + ", the animation has " + to_string(frameCount));
+                r.Skip(sizeof(uint16_t), "branch probability");
+            }
+
+            uint8_t overlayCount = r.Read<uint8_t>("overlay count");
+            for(uint8_t o = 0; o < overlayCount; ++o)
+            {
+                r.Skip(2 * sizeof(uint8_t), "overlay type");
+                uint16_t imageID = r.Read<uint16_t>("overlay image id");
+                if(imageID >= imageList.Count)
+                    r.Fail("overlay " + to_string(o) + " references image " + to_string(imageID)
+                           + ", the file has " + to_string(imageList.Count));
+                r.Skip(sizeof(uint8_t), "overlay header");
+                bool hasRegion = r.Read<uint8_t>("overlay region flag") != 0;
+                r.Skip(2 * sizeof(int16_t) + 2 * sizeof(uint16_t), "overlay rectangle");
+                if(hasRegion)
+                    r.Skip(r.Read<uint32_t>("overlay region size"), "overlay region data");
+            }
+        }
+    }
+}
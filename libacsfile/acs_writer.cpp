@@ -0,0 +1,694 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#include "acs_writer.h"
+#include "acs_private.h"
+#include "acsfile.h"
+#include "acstrace.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+#define COMPRESS_HASH_BITS      16
+#define COMPRESS_MAX_LENGTH     4096
+#define COMPRESS_MAX_DISTANCE   (4673 + 0xFFFFE)
+
+using namespace libacsfile;
+using namespace std;
+
+vector<uint8_t> libacsfile::CompressData(const vector<uint8_t> &data, SaveOptions::Compression preset)
+{
+    Compressor compressor(preset);
+    return compressor.Compress(data);
+}
+
+Compressor::Compressor(SaveOptions::Compression preset)
+{
+    MaxChain = preset == SaveOptions::Best ? 512 : 16;
+    Lazy = preset == SaveOptions::Best;
+}
+
+static inline uint32_t HashBytes3(const uint8_t *p)
+{
+    uint32_t v = (p[0] << 16) | (p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+}
+
+// Offsets 1-64, 65-576 and 577-4672 add one to the run length, larger
+// offsets add two. A usable match has to leave at least one for the
+// length code and must be cheaper than emitting literals (9 bits each).
+static inline uint32_t MatchExtra(uint32_t distance)
+{
+    return distance > 4672 ? 2 : 1;
+}
+
+static inline uint32_t MatchBits(uint32_t distance, uint32_t length)
+{
+    uint32_t bits = 24;
+    if(distance <= 64)
+        bits = 8;
+    else if(distance <= 576)
+        bits = 12;
+    else if(distance <= 4672)
+        bits = 16;
+
+    uint32_t n = length - MatchExtra(distance);
+    uint32_t k = 0;
+    while((n >> (k + 1)) != 0)
+        ++k;
+    return bits + 2 * k + 1;
+}
+
+static inline bool MatchUsable(uint32_t distance, uint32_t length)
+{
+    if(length < MatchExtra(distance) + 1)
+        return false;
+    return MatchBits(distance, length) < length * 9;
+}
+
+void Compressor::PutBits(uint32_t bits, uint32_t count)
+{
+    if(count == 0)
+        return;
+    BitBuffer |= static_cast<uint64_t>(bits & ((1ull << count) - 1)) << BitCount;
+    BitCount += count;
+    while(BitCount >= 8)
+    {
+        Out->push_back(static_cast<uint8_t>(BitBuffer & 0xFF));
+        BitBuffer >>= 8;
+        BitCount -= 8;
+    }
+}
+
+void Compressor::FlushBits()
+{
+    // pad the last byte with ones, like the end marker
+    if(BitCount > 0)
+        PutBits(0xFF, 8 - BitCount);
+}
+
+void Compressor::PutLiteral(uint8_t byte)
+{
+    PutBits(0, 1);
+    PutBits(byte, 8);
+}
+
+void Compressor::PutMatch(uint32_t distance, uint32_t length)
+{
+    // bits are consumed LSB first, so prefixes read right to left
+    if(distance <= 64)
+    {
+        PutBits(0x1, 2);
+        PutBits(distance - 1, 6);
+    }
+    else if(distance <= 576)
+    {
+        PutBits(0x3, 3);
+        PutBits(distance - 65, 9);
+    }
+    else if(distance <= 4672)
+    {
+        PutBits(0x7, 4);
+        PutBits(distance - 577, 12);
+    }
+    else
+    {
+        PutBits(0xF, 4);
+        PutBits(distance - 4673, 20);
+    }
+
+    uint32_t n = length - MatchExtra(distance);
+    uint32_t k = 0;
+    while((n >> (k + 1)) != 0)
+        ++k;
+    PutBits((1u << k) - 1, k);
+    PutBits(0, 1);
+    PutBits(n - (1u << k), k);
+}
+
+void Compressor::Insert(const vector<uint8_t> &src, size_t pos)
+{
+    if(pos + 2 >= src.size())
+        return;
+    uint32_t hash = HashBytes3(src.data() + pos);
+    Prev[pos] = Head[hash];
+    Head[hash] = static_cast<int32_t>(pos);
+}
+
+uint32_t Compressor::FindMatch(const vector<uint8_t> &src, size_t pos, uint32_t &distance)
+{
+    if(pos + 2 >= src.size())
+        return 0;
+
+    const uint8_t *cur = src.data() + pos;
+    const uint32_t maxLength = static_cast<uint32_t>(min<size_t>(COMPRESS_MAX_LENGTH, src.size() - pos));
+    uint32_t best = 0;
+    uint32_t chain = MaxChain;
+    for(int32_t cand = Head[HashBytes3(cur)]; cand >= 0 && chain > 0; cand = Prev[cand], --chain)
+    {
+        uint32_t d = static_cast<uint32_t>(pos - cand);
+        if(d > COMPRESS_MAX_DISTANCE)
+            break;
+
+        const uint8_t *ref = src.data() + cand;
+        if(ref[best] != cur[best])
+            continue;
+
+        uint32_t len = 0;
+        while(len < maxLength && ref[len] == cur[len])
+            ++len;
+
+        if(len > best && MatchUsable(d, len))
+        {
+            best = len;
+            distance = d;
+            if(len == maxLength)
+                break;
+        }
+    }
+    return best;
+}
+
+vector<uint8_t> Compressor::Compress(const vector<uint8_t> &src)
+{
+    vector<uint8_t> out;
+    out.reserve(src.size() / 2 + 16);
+    Out = &out;
+    BitBuffer = 0;
+    BitCount = 0;
+    Head.assign(1u << COMPRESS_HASH_BITS, -1);
+    Prev.assign(src.size(), -1);
+
+    out.push_back(0x00);
+
+    size_t pos = 0;
+    while(pos < src.size())
+    {
+        uint32_t distance = 0;
+        uint32_t length = FindMatch(src, pos, distance);
+        Insert(src, pos);
+
+        if(Lazy && length > 0 && length < 64)
+        {
+            // take a literal if the next position starts a longer match
+            uint32_t nextDistance = 0;
+            uint32_t nextLength = FindMatch(src, pos + 1, nextDistance);
+            if(nextLength > length + 1)
+            {
+                PutLiteral(src[pos]);
+                ++pos;
+                continue;
+            }
+        }
+
+        if(length > 0)
+        {
+            PutMatch(distance, length);
+            for(uint32_t i = 1; i < length; ++i)
+                Insert(src, pos + i);
+            pos += length;
+        }
+        else
+        {
+            PutLiteral(src[pos]);
+            ++pos;
+        }
+    }
+
+    // end marker is a match with the largest 20 bit offset
+    PutBits(0xFFFFFF, 24);
+    FlushBits();
+    out.insert(out.end(), 6, 0xFF);
+
+    Out = nullptr;
+    Head.clear();
+    Prev.clear();
+    return out;
+}
+
+CharacterWriter::CharacterWriter(CharacterPrivate *priv, const SaveOptions &options)
+    :c(priv)
+    ,Options(options)
+{
+}
+
+void CharacterWriter::CollectAnimations()
+{
+    if(Options.Animations.empty())
+    {
+        for(auto &[name, animation] : c->animations)
+            Animations.push_back(animation->p);
+        return;
+    }
+
+    // keep the requested animations and everything they return to
+    set<string> keep;
+    vector<string> pending(Options.Animations.begin(), Options.Animations.end());
+    while(!pending.empty())
+    {
+        string name = pending.back();
+        pending.pop_back();
+        auto it = c->animations.find(name);
+        if(it == c->animations.end() || !keep.insert(name).second)
+            continue;
+        if(!it->second->p->ReturnAnimation.empty())
+            pending.push_back(it->second->p->ReturnAnimation);
+    }
+    for(auto &name : keep)
+        Animations.push_back(c->animations[name]->p);
+}
+
+void CharacterWriter::CollectImages()
+{
+    vector<ImagePrivate*> sources;
+    if(Options.Animations.empty())
+    {
+        for(auto &[id, img] : c->images)
+            sources.push_back(img->p);
+    }
+    else
+    {
+        set<uint32_t> referenced;
+        for(auto animation : Animations)
+        {
+            for(auto &[index, frame] : animation->Frames)
+            {
+                for(auto fimg : frame->p->ImageIndexes)
+                    if(fimg->GetImage())
+                        referenced.insert(fimg->GetImage()->ImageID());
+                for(auto overlay : frame->p->MouthOverlays)
+                    referenced.insert(overlay->p->ImageID);
+            }
+        }
+        for(uint32_t id : referenced)
+            if(c->images.find(id) != c->images.end())
+                sources.push_back(c->images[id]->p);
+    }
+
+    unordered_multimap<uint64_t, uint32_t> seen;
+    for(auto source : sources)
+    {
+        ImageEntry entry;
+        entry.Source = source;
+        source->Materialize(entry.Pixels);
+        // the reader always decodes into stride * height bytes
+        entry.Pixels.resize(static_cast<size_t>(source->Stride()) * source->Height);
+
+        uint64_t hash = 0;
+        if(Options.DeduplicateImages)
+        {
+            hash = HashImageData(entry.Pixels);
+            auto range = seen.equal_range(hash);
+            auto match = find_if(range.first, range.second, [&](const pair<const uint64_t, uint32_t> &it) {
+                const ImageEntry &other = Images[it.second];
+                return other.Source->Width == source->Width
+                       && other.Source->Height == source->Height
+                       && other.Pixels == entry.Pixels
+                       // the region is written with the image, it has to match too
+                       && other.Source->RegionCompressed == source->RegionCompressed
+                       && other.Source->RegionUncompressedSize == source->RegionUncompressedSize
+                       && other.Source->RegionData == source->RegionData;
+            });
+            if(match != range.second)
+            {
+                ImageIndex[source] = match->second;
+                continue;
+            }
+        }
+
+        uint32_t index = static_cast<uint32_t>(Images.size());
+        ImageIndex[source] = index;
+        if(Options.DeduplicateImages)
+            seen.emplace(hash, index);
+        Images.push_back(move(entry));
+    }
+}
+
+void CharacterWriter::CollectSounds()
+{
+    if(Options.Animations.empty())
+    {
+        for(auto &[id, sound] : c->sounds)
+        {
+            SoundIndex[id] = static_cast<uint16_t>(Sounds.size());
+            Sounds.push_back(sound->p);
+        }
+        return;
+    }
+
+    set<uint16_t> referenced;
+    for(auto animation : Animations)
+        for(auto &[index, frame] : animation->Frames)
+            if(frame->p->AudioIndex != 65535)
+                referenced.insert(frame->p->AudioIndex);
+
+    for(uint16_t id : referenced)
+    {
+        auto it = c->sounds.find(id);
+        if(it == c->sounds.end())
+            continue;
+        SoundIndex[id] = static_cast<uint16_t>(Sounds.size());
+        Sounds.push_back(it->second->p);
+    }
+}
+
+void CharacterWriter::EncodeImages()
+{
+    ACS_TRACE_SCOPE("save", "EncodeImages");
+    unsigned int threads = Options.Threads;
+    if(threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    threads = min<unsigned int>(threads, max<size_t>(1, Images.size()));
+
+    atomic<size_t> next{0};
+    mutex errorLock;
+    string error;
+    auto worker = [&]() {
+        vector<uint8_t> check;
+        for(size_t i = next++; i < Images.size(); i = next++)
+        {
+            ImageEntry &entry = Images[i];
+            if(Options.Preset == SaveOptions::Store)
+            {
+                entry.Encoded = entry.Pixels;
+                entry.Compressed = false;
+                continue;
+            }
+
+            ACS_TRACE_SCOPE("save", "CompressImage");
+            Compressor compressor(Options.Preset);
+            entry.Encoded = compressor.Compress(entry.Pixels);
+            entry.Compressed = true;
+            if(entry.Encoded.size() >= entry.Pixels.size())
+            {
+                entry.Encoded = entry.Pixels;
+                entry.Compressed = false;
+                continue;
+            }
+
+            if(Options.Verify)
+            {
+                check.assign(entry.Pixels.size(), 0);
+                CharacterPrivate::DecodeData(entry.Encoded, check);
+                if(check != entry.Pixels)
+                {
+                    lock_guard<mutex> lock(errorLock);
+                    error = "Compressed image " + to_string(entry.Source->ImageID) + " does not decode back";
+                }
+            }
+        }
+    };
+
+    vector<thread> pool;
+    for(unsigned int i = 1; i < threads; ++i)
+        pool.emplace_back(worker);
+    worker();
+    for(auto &t : pool)
+        t.join();
+
+    if(!error.empty())
+        throw runtime_error(error);
+}
+
+template<typename T>
+void CharacterWriter::Put(const T &value)
+{
+    PutBytes(&value, sizeof(T));
+}
+
+void CharacterWriter::PutBytes(const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+    Buffer.insert(Buffer.end(), bytes, bytes + size);
+}
+
+void CharacterWriter::PutString(const string &str)
+{
+    Put<uint32_t>(static_cast<uint32_t>(str.size()));
+    if(str.empty())
+        return;
+
+    // strings are stored as UTF-16 with a terminator
+    for(char ch : str)
+        Put<uint16_t>(static_cast<uint8_t>(ch));
+    Put<uint16_t>(0);
+}
+
+void CharacterWriter::PutLocator(size_t at, uint32_t offset, uint32_t size)
+{
+    ACSLOCATOR locator{ offset, size };
+    memcpy(Buffer.data() + at, &locator, sizeof(ACSLOCATOR));
+}
+
+void CharacterWriter::WriteCharacterInfo(ACSLOCATOR &info)
+{
+    info.Offset = static_cast<uint32_t>(Buffer.size());
+    Put(c->MinorVersion);
+    Put(c->MajorVersion);
+    size_t localizedAt = Buffer.size();
+    Put(ACSLOCATOR{});
+    Put(c->CharacterID);
+    Put(c->CharacterWidth);
+    Put(c->CharacterHeight);
+    Put(c->TransparentColorIndex);
+    Put(c->Flags);
+    Put(c->AnimationSetMajorVersion);
+    Put(c->AnimationSetMinorVersion);
+
+    if(c->Flags & CHAR_STYLE_TTS)
+    {
+        Put(c->EngineID);
+        Put(c->ModeID);
+        Put(c->Speed);
+        Put(c->Pitch);
+        Put<uint8_t>(c->VoiceExtraData);
+        if(c->VoiceExtraData)
+        {
+            Put(c->LangID);
+            PutString(c->Dialect);
+            Put(c->Gender);
+            Put(c->Age);
+            PutString(c->Style);
+        }
+    }
+
+    Put(c->TextLines);
+    Put(c->CharsPerLine);
+    Put(c->ForegroundColor);
+    Put(c->BackgroundColor);
+    Put(c->BorderColor);
+    PutString(c->FontName);
+    Put(c->FontHeight);
+    Put(c->FontWeight);
+    Put<uint8_t>(c->Italicized);
+    Put(c->UnknownBalloonFlag);
+
+    Put<uint32_t>(static_cast<uint32_t>(c->Palette.size()));
+    PutBytes(c->Palette.data(), c->Palette.size() * sizeof(RGBQUAD));
+
+    Put<uint8_t>(c->TrayIconEnabled);
+    if(c->TrayIconEnabled)
+    {
+        Put<uint32_t>(static_cast<uint32_t>(c->MonoIconData.size()));
+        PutBytes(c->MonoIconData.data(), c->MonoIconData.size());
+        Put<uint32_t>(static_cast<uint32_t>(c->ColorIconData.size()));
+        PutBytes(c->ColorIconData.data(), c->ColorIconData.size());
+    }
+
+    set<string> kept;
+    for(auto animation : Animations)
+        kept.insert(animation->Name);
+
+    map<string, vector<string>> states;
+    for(auto &[state, names] : c->States)
+    {
+        for(auto &name : names)
+            if(Options.Animations.empty() || kept.count(name))
+                states[state].push_back(name);
+        if(Options.Animations.empty())
+            states[state];
+    }
+    Put<uint16_t>(static_cast<uint16_t>(states.size()));
+    for(auto &[state, names] : states)
+    {
+        PutString(state);
+        Put<uint16_t>(static_cast<uint16_t>(names.size()));
+        for(auto &name : names)
+            PutString(name);
+    }
+    info.Size = static_cast<uint32_t>(Buffer.size() - info.Offset);
+
+    // ACSLOCALIZEDINFO is kept verbatim, with every language
+    uint32_t localizedOffset = static_cast<uint32_t>(Buffer.size());
+    if(c->LocalizedData.empty())
+        Put<uint16_t>(0);
+    else
+        PutBytes(c->LocalizedData.data(), c->LocalizedData.size());
+    PutLocator(localizedAt, localizedOffset, static_cast<uint32_t>(Buffer.size() - localizedOffset));
+}
+
+void CharacterWriter::WriteAnimation(AnimationPrivate *animation)
+{
+    PutString(animation->Name);
+    Put<uint8_t>(animation->Transition);
+    PutString(animation->ReturnAnimation);
+    Put<uint16_t>(static_cast<uint16_t>(animation->Frames.size()));
+    for(auto &[index, frame] : animation->Frames)
+    {
+        FramePrivate *fp = frame->p;
+        Put<uint16_t>(static_cast<uint16_t>(fp->ImageIndexes.size()));
+        for(auto fimg : fp->ImageIndexes)
+        {
+            Put<uint32_t>(ImageIndex[fimg->GetImage()->p]);
+            Put<int16_t>(fimg->OffsetX());
+            Put<int16_t>(fimg->OffsetY());
+        }
+
+        auto sound = SoundIndex.find(fp->AudioIndex);
+        Put<uint16_t>(sound == SoundIndex.end() ? 65535 : sound->second);
+        Put(fp->Duration);
+        Put(fp->ExitFrameID);
+
+        Put<uint8_t>(static_cast<uint8_t>(fp->Branches.size()));
+        for(auto branch : fp->Branches)
+        {
+            Put<uint16_t>(branch->FrameID());
+            Put<uint16_t>(branch->Probability());
+        }
+
+        Put<uint8_t>(static_cast<uint8_t>(fp->MouthOverlays.size()));
+        for(auto overlay : fp->MouthOverlays)
+        {
+            OverlayPrivate *op = overlay->p;
+            uint16_t imageID = op->ImageID;
+            auto img = c->images.find(op->ImageID);
+            if(img != c->images.end())
+                imageID = static_cast<uint16_t>(ImageIndex[img->second->p]);
+
+            Put<uint8_t>(op->OverlayType);
+            Put<uint8_t>(op->ReplaceTop);
+            Put(imageID);
+            Put(op->Unknown);
+            Put<uint8_t>(op->HasRegionData);
+            Put(op->OffsetX);
+            Put(op->OffsetY);
+            Put(op->Width);
+            Put(op->Height);
+            if(op->HasRegionData)
+            {
+                Put<uint32_t>(static_cast<uint32_t>(op->RegionData.size()));
+                PutBytes(op->RegionData.data(), op->RegionData.size());
+            }
+        }
+    }
+}
+
+void CharacterWriter::Write(const string &filename)
+{
+    if(c->Type != Character::Agent20)
+        throw runtime_error("Only ACS 2.0 characters can be written");
+
+    CollectAnimations();
+    CollectImages();
+    CollectSounds();
+    EncodeImages();
+
+    Buffer.clear();
+    Put<uint32_t>(AGENT_CHAR_20_MAGIC);
+    size_t header = Buffer.size();
+    Buffer.resize(header + 4 * sizeof(ACSLOCATOR));
+
+    ACSLOCATOR characterInfo{};
+    WriteCharacterInfo(characterInfo);
+
+    vector<pair<ACSLOCATOR, uint32_t>> imageList;
+    for(auto &entry : Images)
+    {
+        ACSLOCATOR locator{ static_cast<uint32_t>(Buffer.size()), 0 };
+        ImagePrivate *source = entry.Source;
+        Put(source->Unknown);
+        Put(source->Width);
+        Put(source->Height);
+        Put<uint8_t>(entry.Compressed);
+        Put<uint32_t>(static_cast<uint32_t>(entry.Encoded.size()));
+        PutBytes(entry.Encoded.data(), entry.Encoded.size());
+        Put<uint32_t>(source->RegionCompressed ? static_cast<uint32_t>(source->RegionData.size()) : 0);
+        Put<uint32_t>(source->RegionCompressed ? source->RegionUncompressedSize
+                                               : static_cast<uint32_t>(source->RegionData.size()));
+        PutBytes(source->RegionData.data(), source->RegionData.size());
+        locator.Size = static_cast<uint32_t>(Buffer.size() - locator.Offset);
+        imageList.push_back({ locator, source->Checksum });
+    }
+
+    vector<pair<ACSLOCATOR, uint32_t>> soundList;
+    for(auto sound : Sounds)
+    {
+        ACSLOCATOR locator{ static_cast<uint32_t>(Buffer.size()),
+                            static_cast<uint32_t>(sound->RIFFData.size()) };
+        PutBytes(sound->RIFFData.data(), sound->RIFFData.size());
+        soundList.push_back({ locator, sound->Checksum });
+    }
+
+    vector<pair<string, ACSLOCATOR>> animationList;
+    for(auto animation : Animations)
+    {
+        ACSLOCATOR locator{ static_cast<uint32_t>(Buffer.size()), 0 };
+        WriteAnimation(animation);
+        locator.Size = static_cast<uint32_t>(Buffer.size() - locator.Offset);
+        string listName = animation->DisplayName.empty() ? animation->Name : animation->DisplayName;
+        animationList.push_back({ listName, locator });
+    }
+
+    ACSLOCATOR animationInfo{ static_cast<uint32_t>(Buffer.size()), 0 };
+    Put<uint32_t>(static_cast<uint32_t>(animationList.size()));
+    for(auto &[name, locator] : animationList)
+    {
+        PutString(name);
+        Put(locator);
+    }
+    animationInfo.Size = static_cast<uint32_t>(Buffer.size() - animationInfo.Offset);
+
+    ACSLOCATOR imageInfo{ static_cast<uint32_t>(Buffer.size()), 0 };
+    Put<uint32_t>(static_cast<uint32_t>(imageList.size()));
+    for(auto &[locator, checksum] : imageList)
+    {
+        Put(locator);
+        Put(checksum);
+    }
+    imageInfo.Size = static_cast<uint32_t>(Buffer.size() - imageInfo.Offset);
+
+    ACSLOCATOR audioInfo{ static_cast<uint32_t>(Buffer.size()), 0 };
+    Put<uint32_t>(static_cast<uint32_t>(soundList.size()));
+    for(auto &[locator, checksum] : soundList)
+    {
+        Put(locator);
+        Put(checksum);
+    }
+    audioInfo.Size = static_cast<uint32_t>(Buffer.size() - audioInfo.Offset);
+
+    if(Buffer.size() > UINT32_MAX)
+        throw runtime_error("Character is too large for an ACS file");
+
+    PutLocator(header, characterInfo.Offset, characterInfo.Size);
+    PutLocator(header + sizeof(ACSLOCATOR), animationInfo.Offset, animationInfo.Size);
+    PutLocator(header + 2 * sizeof(ACSLOCATOR), imageInfo.Offset, imageInfo.Size);
+    PutLocator(header + 3 * sizeof(ACSLOCATOR), audioInfo.Offset, audioInfo.Size);
+
+    ofstream ofs(filename, ios::binary | ios::trunc);
+    if(!ofs)
+        throw runtime_error("Cannot open file for writing: " + filename);
+    ofs.write(reinterpret_cast<const char*>(Buffer.data()), Buffer.size());
+    if(!ofs)
+        throw runtime_error("Failed to write " + filename);
+}
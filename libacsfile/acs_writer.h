@@ -0,0 +1,69 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "acs_private.h"
+#include "acsfile.h"
+
+namespace libacsfile {
+
+    // LZ77 encoder producing the bitstream CharacterPrivate::DecodeData reads
+    class Compressor
+    {
+    public:
+        explicit Compressor(SaveOptions::Compression preset);
+        std::vector<uint8_t> Compress(const std::vector<uint8_t> &src);
+    private:
+        void PutBits(uint32_t bits, uint32_t count);
+        void PutLiteral(uint8_t byte);
+        void PutMatch(uint32_t distance, uint32_t length);
+        void FlushBits();
+        uint32_t FindMatch(const std::vector<uint8_t> &src, size_t pos, uint32_t &distance);
+        void Insert(const std::vector<uint8_t> &src, size_t pos);
+        uint32_t MaxChain{};
+        bool Lazy{};
+        std::vector<int32_t> Head;
+        std::vector<int32_t> Prev;
+        std::vector<uint8_t> *Out = nullptr;
+        uint64_t BitBuffer{};
+        uint32_t BitCount{};
+    };
+
+    class CharacterWriter
+    {
+    public:
+        CharacterWriter(CharacterPrivate *priv, const SaveOptions &options);
+        void Write(const std::string &filename);
+    private:
+        struct ImageEntry {
+            ImagePrivate *Source = nullptr;
+            std::vector<uint8_t> Pixels;
+            std::vector<uint8_t> Encoded;
+            bool Compressed = false;
+        };
+        void CollectAnimations();
+        void CollectImages();
+        void CollectSounds();
+        void EncodeImages();
+        template<typename T> void Put(const T &value);
+        void PutBytes(const void *data, size_t size);
+        void PutString(const std::string &str);
+        void PutLocator(size_t at, uint32_t offset, uint32_t size);
+        void WriteCharacterInfo(ACSLOCATOR &info);
+        void WriteAnimation(AnimationPrivate *animation);
+        CharacterPrivate *c = nullptr;
+        SaveOptions Options;
+        std::vector<AnimationPrivate*> Animations;
+        std::vector<ImageEntry> Images;
+        std::map<const ImagePrivate*, uint32_t> ImageIndex;
+        std::vector<SoundPrivate*> Sounds;
+        std::map<uint16_t, uint16_t> SoundIndex;
+        std::vector<uint8_t> Buffer;
+    };
+}
@@ -0,0 +1,704 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Dumps characters as JSON and extracts their images, sounds and
+// animation graphs. Files and the images inside them are processed by
+// one bounded pool of workers.
+//   acsdump [--output=dir] [--jobs=N] [--extract=images,sounds,graph,web|none]
+//           [--image-format=bmp|qoi] [--roundtrip] file-or-directory...
+// Each character gets <output>/<name>/ holding character.json,
+// animations.json, images/ImageN.bmp (or .qoi) and sounds/SoundN.wav.
+// The web extract is a self-contained web/ with the images packed onto a
+// few PNG sprite sheets, the sounds and agent.json describing it all.
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+
+#include "acsfile.h"
+
+// Web sprite sheet size, large enough for few requests and small
+// enough for any browser to upload as a texture
+#define WEB_SHEET_SIZE 2048
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// A fixed set of workers over one task list. Tasks a running task adds
+// with Urgent go to the front, so a character's images are written
+// before the next file is loaded and only about one character per
+// worker is held in memory at a time.
+class WorkQueue
+{
+public:
+    explicit WorkQueue(unsigned int threads)
+    {
+        for(unsigned int i = 0; i < threads; ++i)
+            workers.emplace_back([this]() { Work(); });
+    }
+
+    ~WorkQueue()
+    {
+        Wait();
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto &t : workers)
+            t.join();
+    }
+
+    void Push(function<void()> task, bool urgent = false)
+    {
+        {
+            lock_guard<mutex> lock(m);
+            if(urgent)
+                tasks.push_front(std::move(task));
+            else
+                tasks.push_back(std::move(task));
+            ++pending;
+        }
+        wake.notify_one();
+    }
+
+    void Wait()
+    {
+        unique_lock<mutex> lock(m);
+        idle.wait(lock, [this]() { return pending == 0; });
+    }
+
+private:
+    void Work()
+    {
+        for(;;)
+        {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(m);
+                wake.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if(tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+            lock_guard<mutex> lock(m);
+            if(--pending == 0)
+                idle.notify_all();
+        }
+    }
+
+    mutex m;
+    condition_variable wake;
+    condition_variable idle;
+    deque<function<void()>> tasks;
+    size_t pending = 0;
+    bool stopping = false;
+    vector<thread> workers;
+};
+
+struct DumpOptions {
+    fs::path Output = ".";
+    unsigned int Jobs = 0;
+    bool Images = true;
+    bool Sounds = true;
+    bool Graph = true;
+    bool Web = false;
+    bool QOI = false;
+    bool RoundTrip = false;
+};
+
+static mutex consoleLock;
+static atomic<unsigned int> failures{0};
+
+static void Report(const string &line, bool error = false)
+{
+    lock_guard<mutex> lock(consoleLock);
+    (error ? cerr : cout) << line << endl;
+    if(error)
+        ++failures;
+}
+
+static string Quote(const string &s)
+{
+    string out = "\"";
+    for(unsigned char ch : s)
+    {
+        switch(ch)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if(ch < 0x20)
+            {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", ch);
+                out += escape;
+            }
+            else
+                out += static_cast<char>(ch);
+        }
+    }
+    return out + "\"";
+}
+
+static string TransitionName(libacsfile::Animation::TransitionType type)
+{
+    switch(type)
+    {
+    case libacsfile::Animation::TransitionReturnAnimation:
+        return "return";
+    case libacsfile::Animation::TransitionExitBranches:
+        return "exit";
+    case libacsfile::Animation::TransitionNone:
+        break;
+    }
+    return "none";
+}
+
+static string CharacterJSON(libacsfile::Character &acs, const fs::path &source)
+{
+    ostringstream js;
+    js << "{\n";
+    js << "  \"file\": " << Quote(source.string()) << ",\n";
+    js << "  \"guid\": " << Quote(acs.GUID()) << ",\n";
+    js << "  \"name\": " << Quote(acs.Name()) << ",\n";
+    js << "  \"description\": " << Quote(acs.Description()) << ",\n";
+    js << "  \"languages\": {";
+    bool first = true;
+    for(uint16_t lang : acs.Languages())
+    {
+        js << (first ? "\n" : ",\n") << "    \"" << lang << "\": { \"name\": " << Quote(acs.Name(lang))
+           << ", \"description\": " << Quote(acs.Description(lang)) << " }";
+        first = false;
+    }
+    js << (first ? "},\n" : "\n  },\n");
+    js << "  \"width\": " << acs.Width() << ",\n";
+    js << "  \"height\": " << acs.Height() << ",\n";
+
+    js << "  \"tts\": { \"enabled\": " << (acs.TTSEnabled() ? "true" : "false");
+    if(acs.TTSEnabled())
+        js << ", \"engine\": " << Quote(acs.TTSEngineGUID()) << ", \"mode\": " << Quote(acs.TTSModeGUID())
+           << ", \"speed\": " << acs.VoiceSpeed() << ", \"pitch\": " << acs.VoicePitch()
+           << ", \"gender\": " << acs.Gender() << ", \"age\": " << acs.Age()
+           << ", \"style\": " << Quote(acs.Style());
+    js << " },\n";
+    js << "  \"balloon\": { \"enabled\": " << (acs.BalloonEnabled() ? "true" : "false");
+    if(acs.BalloonEnabled())
+        js << ", \"font\": " << Quote(acs.BalloonFont());
+    js << " },\n";
+    js << "  \"trayIcon\": " << (acs.TrayIconEnabled() ? "true" : "false") << ",\n";
+
+    RGBQUAD transparent = acs.TransparentColor();
+    char color[16];
+    snprintf(color, sizeof(color), "#%02x%02x%02x", transparent.rgbRed, transparent.rgbGreen, transparent.rgbBlue);
+    js << "  \"transparentColor\": \"" << color << "\",\n";
+    js << "  \"paletteSize\": " << acs.ColorPalette().size() << ",\n";
+
+    js << "  \"states\": {";
+    first = true;
+    for(auto &[state, animations] : acs.States())
+    {
+        js << (first ? "\n" : ",\n") << "    " << Quote(state) << ": [";
+        for(size_t i = 0; i < animations.size(); ++i)
+            js << (i ? ", " : "") << Quote(animations[i]);
+        js << "]";
+        first = false;
+    }
+    js << (first ? "},\n" : "\n  },\n");
+
+    js << "  \"animations\": [";
+    first = true;
+    for(auto &name : acs.AnimationNames())
+    {
+        js << (first ? "" : ", ") << Quote(name);
+        first = false;
+    }
+    js << "],\n";
+
+    js << "  \"images\": [";
+    first = true;
+    for(auto &[id, img] : acs.Images())
+    {
+        js << (first ? "\n" : ",\n") << "    { \"id\": " << id << ", \"width\": " << img->Width()
+           << ", \"height\": " << img->Height() << ", \"compressed\": " << (img->Compressed() ? "true" : "false")
+           << ", \"size\": " << img->Size() << " }";
+        first = false;
+    }
+    js << (first ? "],\n" : "\n  ],\n");
+
+    js << "  \"sounds\": [";
+    first = true;
+    for(auto &[id, snd] : acs.Sounds())
+    {
+        const libacsfile::WaveFormat &format = snd->Format();
+        js << (first ? "\n" : ",\n") << "    { \"id\": " << id << ", \"size\": " << snd->Size()
+           << ", \"format\": " << format.FormatTag << ", \"channels\": " << format.Channels
+           << ", \"sampleRate\": " << format.SampleRate << ", \"bitsPerSample\": " << format.BitsPerSample << " }";
+        first = false;
+    }
+    js << (first ? "]\n" : "\n  ]\n");
+    js << "}\n";
+    return js.str();
+}
+
+// Frames are the nodes, branches and exit frames the edges, return
+// animations link animations together
+static string GraphJSON(libacsfile::Character &acs)
+{
+    ostringstream js;
+    js << "{\n  \"animations\": [";
+    bool firstAnimation = true;
+    for(auto &[name, anim] : acs.Animations())
+    {
+        js << (firstAnimation ? "\n" : ",\n");
+        firstAnimation = false;
+        js << "    {\n      \"name\": " << Quote(name) << ",\n";
+        js << "      \"transition\": \"" << TransitionName(anim->Transition()) << "\",\n";
+        js << "      \"return\": " << Quote(anim->ReturnAnimation()) << ",\n";
+        js << "      \"frames\": [";
+        bool firstFrame = true;
+        for(auto &[index, frame] : anim->Frames())
+        {
+            js << (firstFrame ? "\n" : ",\n");
+            firstFrame = false;
+            js << "        { \"index\": " << index << ", \"duration\": " << frame->Duration()
+               << ", \"exit\": " << frame->ExitFrame();
+            if(frame->Sound())
+                js << ", \"sound\": " << frame->AudioIndex();
+            js << ", \"images\": [";
+            bool first = true;
+            for(auto fimg : frame->Images())
+            {
+                js << (first ? "" : ", ") << "{ \"id\": " << fimg->GetImageID()
+                   << ", \"x\": " << fimg->OffsetX() << ", \"y\": " << fimg->OffsetY() << " }";
+                first = false;
+            }
+            js << "], \"branches\": [";
+            first = true;
+            for(auto branch : frame->Branches())
+            {
+                js << (first ? "" : ", ") << "{ \"frame\": " << branch->FrameID()
+                   << ", \"probability\": " << branch->Probability() << " }";
+                first = false;
+            }
+            js << "], \"overlays\": [";
+            first = true;
+            for(auto overlay : frame->MouthOverlays())
+            {
+                js << (first ? "" : ", ") << "{ \"type\": " << overlay->OverlayType();
+                if(overlay->Image())
+                    js << ", \"image\": " << overlay->Image()->ImageID();
+                js << ", \"x\": " << overlay->OffsetX() << ", \"y\": " << overlay->OffsetY() << " }";
+                first = false;
+            }
+            js << "] }";
+        }
+        js << (firstFrame ? "]\n" : "\n      ]\n") << "    }";
+    }
+    js << (firstAnimation ? "]\n" : "\n  ]\n") << "}\n";
+    return js.str();
+}
+
+// Everything a browser player needs in one compact document. Images are
+// [sheet, x, y, width, height] by image ID, frames list [image, x, y]
+// top first, branches [frame, percent] and overlays [type, image, x, y,
+// replacesTop]. Durations are in milliseconds.
+static string WebJSON(libacsfile::Character &acs, const vector<libacsfile::AtlasPage> &sheets)
+{
+    ostringstream js;
+    js << "{\"name\":" << Quote(acs.Name()) << ",\"width\":" << acs.Width() << ",\"height\":" << acs.Height();
+
+    js << ",\"sheets\":[";
+    for(size_t i = 0; i < sheets.size(); ++i)
+        js << (i ? "," : "") << "{\"file\":\"sheet" << i << ".png\",\"width\":" << sheets[i].Width
+           << ",\"height\":" << sheets[i].Height << "}";
+
+    // IDs index the lists, images without pixels are null
+    js << "],\"images\":[";
+    auto images = acs.Images();
+    uint32_t next = 0;
+    for(auto &[id, img] : images)
+    {
+        for(; next < id; ++next)
+            js << (next ? "," : "") << "null";
+        libacsfile::AtlasRect rect;
+        js << (id ? "," : "");
+        if(img->AtlasLocation(rect))
+            js << "[" << rect.Page << "," << rect.X << "," << rect.Y << "," << rect.Width << "," << rect.Height << "]";
+        else
+            js << "null";
+        next = id + 1;
+    }
+
+    js << "],\"sounds\":[";
+    next = 0;
+    for(auto &[id, snd] : acs.Sounds())
+    {
+        for(; next < id; ++next)
+            js << (next ? "," : "") << "null";
+        js << (id ? "," : "") << "\"sounds/Sound" << id << ".wav\"";
+        next = id + 1;
+    }
+
+    js << "],\"states\":{";
+    bool first = true;
+    for(auto &[state, animations] : acs.States())
+    {
+        js << (first ? "" : ",") << Quote(state) << ":[";
+        for(size_t i = 0; i < animations.size(); ++i)
+            js << (i ? "," : "") << Quote(animations[i]);
+        js << "]";
+        first = false;
+    }
+
+    js << "},\"animations\":{";
+    first = true;
+    for(auto &[name, anim] : acs.Animations())
+    {
+        js << (first ? "" : ",") << Quote(name) << ":{\"transition\":\"" << TransitionName(anim->Transition()) << "\"";
+        first = false;
+        if(anim->Transition() == libacsfile::Animation::TransitionReturnAnimation && !anim->ReturnAnimation().empty())
+            js << ",\"return\":" << Quote(anim->ReturnAnimation());
+        js << ",\"frames\":[";
+        bool firstFrame = true;
+        for(auto &[index, frame] : anim->Frames())
+        {
+            js << (firstFrame ? "" : ",") << "{\"duration\":" << frame->Duration() * 10;
+            firstFrame = false;
+            if(frame->ExitFrame() >= 0)
+                js << ",\"exit\":" << frame->ExitFrame();
+            if(frame->Sound())
+                js << ",\"sound\":" << frame->AudioIndex();
+            js << ",\"images\":[";
+            bool firstItem = true;
+            for(auto fimg : frame->Images())
+            {
+                js << (firstItem ? "" : ",") << "[" << fimg->GetImageID() << "," << fimg->OffsetX() << "," << fimg->OffsetY() << "]";
+                firstItem = false;
+            }
+            js << "]";
+            auto branches = frame->Branches();
+            if(!branches.empty())
+            {
+                js << ",\"branches\":[";
+                for(size_t i = 0; i < branches.size(); ++i)
+                    js << (i ? "," : "") << "[" << branches[i]->FrameID() << "," << branches[i]->Probability() << "]";
+                js << "]";
+            }
+            auto overlays = frame->MouthOverlays();
+            if(!overlays.empty())
+            {
+                js << ",\"overlays\":[";
+                for(size_t i = 0; i < overlays.size(); ++i)
+                {
+                    const libacsfile::Overlay *overlay = overlays[i];
+                    js << (i ? "," : "") << "[" << overlay->OverlayType() << ","
+                       << (overlay->Image() ? static_cast<int64_t>(overlay->Image()->ImageID()) : -1) << ","
+                       << overlay->OffsetX() << "," << overlay->OffsetY() << ","
+                       << (overlay->ReplacesTopImage() ? 1 : 0) << "]";
+                }
+                js << "]";
+            }
+            js << "}";
+        }
+        js << "]}";
+    }
+    js << "}}\n";
+    return js.str();
+}
+
+static bool WriteText(const fs::path &file, const string &text)
+{
+    ofstream ofs(file, ios::binary | ios::trunc);
+    return static_cast<bool>(ofs.write(text.data(), text.size()));
+}
+
+// Saves the character with both compression presets, reloads it and
+// checks every image decodes to the same pixels
+static bool RoundTrip(libacsfile::Character &original, const fs::path &source, const fs::path &scratch)
+{
+    bool ok = true;
+    for(auto preset : { libacsfile::SaveOptions::Fast, libacsfile::SaveOptions::Best })
+    {
+        libacsfile::SaveOptions options;
+        options.Preset = preset;
+        options.DeduplicateImages = false;
+        options.Verify = true;
+        // the pool is already busy, keep the writer on this worker
+        options.Threads = 1;
+
+        string label = source.string() + ": round trip (" + (preset == libacsfile::SaveOptions::Best ? "best" : "fast") + ")";
+        if(!original.Save(scratch.string(), options))
+        {
+            Report(label + ": " + original.GetLastError(), true);
+            return false;
+        }
+
+        libacsfile::Character copy;
+        if(!copy.Load(scratch.string()))
+        {
+            Report(label + ": " + copy.GetLastError(), true);
+            fs::remove(scratch);
+            return false;
+        }
+
+        bool same = copy.Images().size() == original.Images().size()
+                 && copy.Animations().size() == original.Animations().size()
+                 && copy.Sounds().size() == original.Sounds().size();
+        auto copies = copy.Images();
+        for(auto &[k,a] : original.Images())
+        {
+            auto b = copies.find(k);
+            if(b == copies.end() || a->Data() != b->second->Data())
+                same = false;
+        }
+
+        Report(label + ": " + to_string(fs::file_size(source)) + "B -> "
+               + to_string(fs::file_size(scratch)) + "B " + (same ? "OK" : "FAILED"), !same);
+        ok = ok && same;
+        fs::remove(scratch);
+    }
+    return ok;
+}
+
+static void DumpFile(const fs::path &source, const fs::path &outDir, const DumpOptions &options, WorkQueue &queue)
+{
+    // the web sheets are the atlas pages, the other extracts rebuild
+    // their bitmaps from it
+    libacsfile::LoadOptions load;
+    load.PackAtlas = options.Web;
+    load.AtlasPageSize = WEB_SHEET_SIZE;
+    auto acs = make_shared<libacsfile::Character>();
+    if(!acs->Load(source.string(), load))
+    {
+        Report(source.string() + ": " + acs->GetLastError(), true);
+        return;
+    }
+
+    error_code ec;
+    fs::create_directories(outDir, ec);
+    if(ec)
+    {
+        Report(outDir.string() + ": " + ec.message(), true);
+        return;
+    }
+
+    if(!WriteText(outDir / "character.json", CharacterJSON(*acs, source)))
+        Report((outDir / "character.json").string() + ": cannot write", true);
+    if(options.Graph && !WriteText(outDir / "animations.json", GraphJSON(*acs)))
+        Report((outDir / "animations.json").string() + ": cannot write", true);
+
+    if(options.RoundTrip)
+        RoundTrip(*acs, source, outDir / "roundtrip.acs");
+
+    size_t images = 0, sounds = 0;
+    if(options.Images)
+    {
+        fs::create_directories(outDir / "images", ec);
+        // batches keep the task overhead small next to the BMP writes
+        vector<libacsfile::Image*> all;
+        for(auto &[id, img] : acs->Images())
+            all.push_back(img);
+        images = all.size();
+        size_t batch = max<size_t>(1, all.size() / (4 * max(1u, options.Jobs)));
+        for(size_t start = 0; start < all.size(); start += batch)
+        {
+            size_t end = min(all.size(), start + batch);
+            bool qoi = options.QOI;
+            queue.Push([acs, all, start, end, outDir, qoi]() {
+                for(size_t i = start; i < end; ++i)
+                {
+                    fs::path file = outDir / "images" / ("Image" + to_string(all[i]->ImageID()) + (qoi ? ".qoi" : ".bmp"));
+                    if(!(qoi ? all[i]->WriteToQOIFile(file) : all[i]->WriteToFile(file)))
+                        Report(file.string() + ": cannot write", true);
+                }
+            }, true);
+        }
+    }
+
+    if(options.Sounds && !acs->Sounds().empty())
+    {
+        fs::create_directories(outDir / "sounds", ec);
+        sounds = acs->Sounds().size();
+        queue.Push([acs, outDir]() {
+            for(auto &[id, snd] : acs->Sounds())
+            {
+                fs::path file = outDir / "sounds" / ("Sound" + to_string(id) + ".wav");
+                if(!snd->WriteToFile(file))
+                    Report(file.string() + ": cannot write", true);
+            }
+        }, true);
+    }
+
+    size_t sheets = 0;
+    if(options.Web)
+    {
+        fs::path web = outDir / "web";
+        fs::create_directories(web / "sounds", ec);
+        // the same sounds as the sounds extract, counted once
+        sounds = acs->Sounds().size();
+        auto pages = make_shared<vector<libacsfile::AtlasPage>>(acs->AtlasPages());
+        sheets = pages->size();
+        if(!WriteText(web / "agent.json", WebJSON(*acs, *pages)))
+            Report((web / "agent.json").string() + ": cannot write", true);
+
+        // sheets are encoded in parallel, one task each
+        auto palette = make_shared<vector<RGBQUAD>>(acs->ColorPalette());
+        const int transparent = acs->TransparentIndex();
+        for(size_t i = 0; i < pages->size(); ++i)
+            queue.Push([acs, pages, palette, transparent, web, i]() {
+                const libacsfile::AtlasPage &page = (*pages)[i];
+                vector<uint8_t> png = libacsfile::EncodePNG(page.Pixels.Data, page.Width, page.Height, page.Width,
+                                                            *palette, transparent);
+                fs::path file = web / ("sheet" + to_string(i) + ".png");
+                if(!WriteText(file, string(png.begin(), png.end())))
+                    Report(file.string() + ": cannot write", true);
+            }, true);
+
+        queue.Push([acs, web]() {
+            for(auto &[id, snd] : acs->Sounds())
+            {
+                fs::path file = web / "sounds" / ("Sound" + to_string(id) + ".wav");
+                if(!snd->WriteToFile(file))
+                    Report(file.string() + ": cannot write", true);
+            }
+        }, true);
+    }
+
+    Report(source.string() + " -> " + outDir.string() + ": " + to_string(acs->Animations().size())
+           + " animations, " + to_string(images) + " images, " + to_string(sounds) + " sounds"
+           + (options.Web ? ", " + to_string(sheets) + " sheets" : ""));
+}
+
+static bool IsCharacterFile(const fs::path &file)
+{
+    string ext = file.extension().string();
+    transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char ch) { return tolower(ch); });
+    return ext == ".acs";
+}
+
+static bool ParseExtract(const string &list, DumpOptions &options)
+{
+    options.Images = options.Sounds = options.Graph = options.Web = false;
+    stringstream ss(list);
+    string item;
+    while(getline(ss, item, ','))
+    {
+        if(item == "images")
+            options.Images = true;
+        else if(item == "sounds")
+            options.Sounds = true;
+        else if(item == "graph")
+            options.Graph = true;
+        else if(item == "web")
+            options.Web = true;
+        else if(item != "none")
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    DumpOptions options;
+    vector<fs::path> inputs;
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool ok = true;
+        try
+        {
+            if(arg.rfind("--output=", 0) == 0)
+                options.Output = arg.substr(9);
+            else if(arg.rfind("--jobs=", 0) == 0)
+                options.Jobs = stoul(arg.substr(7));
+            else if(arg.rfind("--extract=", 0) == 0)
+                ok = ParseExtract(arg.substr(10), options);
+            else if(arg == "--image-format=bmp" || arg == "--image-format=qoi")
+                options.QOI = arg == "--image-format=qoi";
+            else if(arg == "--roundtrip")
+                options.RoundTrip = true;
+            else if(arg.rfind("--", 0) == 0)
+                ok = false;
+            else
+                inputs.push_back(arg);
+        }
+        catch(exception &)
+        {
+            ok = false;
+        }
+        if(!ok)
+        {
+            cerr << "Unknown option: " << arg << endl;
+            return 2;
+        }
+    }
+
+    if(inputs.empty())
+    {
+        cerr << "usage: " << argv[0] << " [--output=dir] [--jobs=N] [--extract=images,sounds,graph,web|none]" << endl
+             << "       [--image-format=bmp|qoi] [--roundtrip] file-or-directory..." << endl;
+        return 2;
+    }
+
+    // Directories are searched recursively. The file list is sorted so
+    // output directory names do not depend on directory iteration order.
+    vector<fs::path> files;
+    for(auto &input : inputs)
+    {
+        error_code ec;
+        if(fs::is_directory(input, ec))
+        {
+            for(auto it = fs::recursive_directory_iterator(input, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+                if(it->is_regular_file() && IsCharacterFile(it->path()))
+                    files.push_back(it->path());
+            if(ec)
+                Report(input.string() + ": " + ec.message(), true);
+        }
+        else if(fs::exists(input, ec))
+            files.push_back(input);
+        else
+            Report(input.string() + ": no such file or directory", true);
+    }
+    sort(files.begin(), files.end());
+
+    // Characters with the same file name get numbered directories
+    map<string, unsigned int> used;
+    vector<fs::path> outDirs;
+    for(auto &file : files)
+    {
+        string name = file.stem().string();
+        unsigned int n = ++used[name];
+        outDirs.push_back(options.Output / (n == 1 ? name : name + "-" + to_string(n)));
+    }
+
+    if(options.Jobs == 0)
+        options.Jobs = max(1u, thread::hardware_concurrency());
+    {
+        WorkQueue queue(options.Jobs);
+        for(size_t i = 0; i < files.size(); ++i)
+            queue.Push([&, i]() { DumpFile(files[i], outDirs[i], options, queue); });
+        queue.Wait();
+    }
+
+    return failures ? 1 : 0;
+}
@@ -3,6 +3,8 @@
 
 #include "acsfile.h"
 #include "acs_private.h"
+#include "acs_writer.h"
+#include "acstrace.h"
 
 using namespace libacsfile;
 using namespace std;
@@ -16,11 +18,12 @@ Character::~Character()
         delete p;
 }
 
-bool Character::Load(const string& filename)
+bool Character::Load(const string& filename, const LoadOptions &options)
 {
+    ACS_TRACE_SCOPE_DETAIL("load", "Character::Load", filename);
     try
     {
-        p = new CharacterPrivate(filename);
+        p = new CharacterPrivate(filename, options);
     }
     catch(runtime_error r)
     {
@@ -39,6 +42,34 @@ bool Character::Load(const string& filename)
     return false;
 }
 
+bool Character::Save(const string &filename, const SaveOptions &options)
+{
+    ACS_TRACE_SCOPE_DETAIL("save", "Character::Save", filename);
+    if(!p)
+    {
+        last_error = "No character loaded";
+        return false;
+    }
+
+    try
+    {
+        CharacterWriter writer(p, options);
+        writer.Write(filename);
+    }
+    catch(const runtime_error &r)
+    {
+        last_error = r.what();
+        return false;
+    }
+    catch(const exception &e)
+    {
+        last_error = e.what();
+        return false;
+    }
+
+    return true;
+}
+
 bool Character::Loaded()
 {
     if(!p)
@@ -61,19 +92,40 @@ string Character::GUID() const
 }
 
 string Character::Name() const
+{
+    return Name(LANG_ENGLISH_US);
+}
+
+string Character::Name(uint16_t langId) const
 {
     if(!p)
         return "";
 
-    return p->CharacterName;
+    return p->LocalizedString(langId, CharacterPrivate::LocalizedName);
 }
 
 string Character::Description() const
+{
+    return Description(LANG_ENGLISH_US);
+}
+
+string Character::Description(uint16_t langId) const
 {
     if(!p)
         return "";
 
-    return p->CharacterDescription;
+    return p->LocalizedString(langId, CharacterPrivate::LocalizedDescription);
+}
+
+vector<uint16_t> Character::Languages() const
+{
+    vector<uint16_t> languages;
+    if(!p)
+        return languages;
+
+    for(auto &[id, strings] : p->LocalizedIndex)
+        languages.push_back(id);
+    return languages;
 }
 
 uint16_t Character::Width() const
@@ -153,11 +205,35 @@ RGBQUAD Character::TransparentColor() const
     return p->Palette.at(p->TransparentColorIndex);
 }
 
+uint8_t Character::TransparentIndex() const
+{
+    if(!p)
+        return 0;
+
+    return p->TransparentColorIndex;
+}
+
 std::vector<RGBQUAD> Character::ColorPalette() const
 {
     return p->Palette;
 }
 
+std::vector<uint32_t> Character::ARGBPalette() const
+{
+    std::vector<uint32_t> argb(256, 0);
+    if(!p)
+        return argb;
+
+    for(size_t i = 0; i < p->Palette.size() && i < argb.size(); i++)
+    {
+        if(i == p->TransparentColorIndex)
+            continue;
+        const RGBQUAD &c = p->Palette[i];
+        argb[i] = 0xFF000000u | (c.rgbRed << 16) | (c.rgbGreen << 8) | c.rgbBlue;
+    }
+    return argb;
+}
+
 string Character::Style() const
 {
     if(!p)
@@ -171,6 +247,14 @@ bool Character::BalloonEnabled() const
     return (bool)(p->Flags & CHAR_STYLE_BALLOON);
 }
 
+bool Character::TrayIconEnabled() const
+{
+    if(!p)
+        return false;
+
+    return p->TrayIconEnabled;
+}
+
 Animation *Character::GetAnimation(std::string &name)
 {
     if(Animations().find(name) != Animations().end())
@@ -240,6 +324,38 @@ std::map<uint16_t, Sound *> Character::Sounds() const
     return p->sounds;
 }
 
+uint64_t Character::DeduplicatedBytes() const
+{
+    if(!p)
+        return 0;
+
+    return p->DeduplicatedBytes;
+}
+
+uint64_t Character::DeltaSavedBytes() const
+{
+    if(!p)
+        return 0;
+
+    return p->DeltaSavedBytes;
+}
+
+std::vector<AtlasPage> Character::AtlasPages() const
+{
+    if(!p)
+        return {};
+
+    return p->AtlasPages;
+}
+
+LoadStats Character::Stats() const
+{
+    if(!p)
+        return LoadStats();
+
+    return p->Stats;
+}
+
 string Animation::Name() const
 {
     return p->Name;
@@ -306,6 +422,36 @@ std::vector<Overlay *> Frame::MouthOverlays() const
     return p->MouthOverlays;
 }
 
+const Overlay *Frame::MouthOverlay(Overlay::Type type) const
+{
+    return p->FindMouth(type);
+}
+
+void Frame::Composite(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                      const uint32_t *palette, const Overlay *mouth) const
+{
+    p->Draw(target, targetWidth, targetHeight, targetStride, palette, mouth);
+}
+
+bool Frame::FollowsByDelta(const Frame *previous) const
+{
+    return previous && p->FollowsByDelta(previous->p);
+}
+
+void Frame::CompositeDelta(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                           const uint32_t *palette) const
+{
+    // without a delta image to redraw, draw the whole frame instead
+    const FrameImage *fimg = p->ImageIndexes.size() == 1 ? p->ImageIndexes[0] : nullptr;
+    if(!fimg || !fimg->GetImage() || !fimg->GetImage()->DeltaBase())
+    {
+        p->Draw(target, targetWidth, targetHeight, targetStride, palette, nullptr);
+        return;
+    }
+    fimg->GetImage()->BlitDelta(target, targetWidth, targetHeight, targetStride,
+                                fimg->OffsetX(), fimg->OffsetY(), palette);
+}
+
 Frame::Frame(FramePrivate *priv)
     :p(priv) {}
 
@@ -334,7 +480,58 @@ bool Image::Compressed() const
 
 std::vector<uint8_t> Image::Data() const
 {
-    return p->ImageData;
+    if(p->Delta || p->Packed)
+    {
+        std::vector<uint8_t> pixels;
+        p->Materialize(pixels);
+        return pixels;
+    }
+    return *p->ImageData;
+}
+
+const uint8_t *Image::Bits() const
+{
+    if(p->Delta || p->Packed || p->ImageData->empty())
+        return nullptr;
+    return p->ImageData->data();
+}
+
+uint32_t Image::Stride() const
+{
+    return p->Stride();
+}
+
+bool Image::AtlasLocation(AtlasRect &rect) const
+{
+    if(!p->Packed)
+        return false;
+    rect = p->AtlasSlot;
+    return true;
+}
+
+Image *Image::DeltaBase() const
+{
+    if(!p->Delta)
+        return nullptr;
+
+    return p->Delta->Base->PublicImage;
+}
+
+void Image::BlitDelta(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                      int x, int y, const uint32_t *palette) const
+{
+    p->BlitDelta(target, targetWidth, targetHeight, targetStride, x, y, palette);
+}
+
+bool Image::HasTransparentRuns() const
+{
+    return p->Runs != nullptr;
+}
+
+void Image::Blit(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                 int x, int y, const uint32_t *palette) const
+{
+    p->Blit(target, targetWidth, targetHeight, targetStride, x, y, palette);
 }
 
 uint16_t Image::Width() const
@@ -352,6 +549,16 @@ bool Image::WriteToFile(std::filesystem::path file)
     return p->WriteToFile(file);
 }
 
+bool Image::WriteToQOIFile(std::filesystem::path file)
+{
+    return p->WriteToQOIFile(file);
+}
+
+std::vector<uint8_t> Image::EncodeQOI() const
+{
+    return p->EncodeQOI();
+}
+
 Image::Image(ImagePrivate *priv)
     :p(priv) {}
 
@@ -419,6 +626,11 @@ Image *Overlay::Image() const
     return p->Image;
 }
 
+bool Overlay::ReplacesTopImage() const
+{
+    return p->ReplaceTop;
+}
+
 Overlay::Overlay(OverlayPrivate *priv)
     :p(priv) { }
 
@@ -464,4 +676,23 @@ std::vector<uint8_t> Sound::Data() const
     return p->RIFFData;
 }
 
+const WaveFormat &Sound::Format() const
+{
+    return p->Format;
+}
+
+DataView Sound::PCM() const
+{
+    DataView view;
+    if(p->PCMSize == 0)
+        return view;
+
+    view.Data = p->RIFFData.data() + p->PCMOffset;
+    view.Size = p->PCMSize;
+    return view;
+}
 
+bool Sound::WriteToFile(std::filesystem::path file)
+{
+    return p->WriteToFile(file);
+}
@@ -21,15 +21,58 @@ namespace libacsfile {
     class AnimationPrivate;
     class CharacterPrivate;
     class SoundPrivate;
+    class CharacterWriter;
+    class AnimationPlayerPrivate;
+
+    // Non-owning view into data held by the character
+    struct DataView {
+        const uint8_t *Data = nullptr;
+        size_t Size = 0;
+    };
+
+    // Location of an image in the sprite atlas, see LoadOptions::PackAtlas
+    struct AtlasRect {
+        uint16_t Page = 0;
+        uint16_t X = 0;
+        uint16_t Y = 0;
+        uint16_t Width = 0;
+        uint16_t Height = 0;
+    };
+
+    // One atlas page, Width bytes a row top-down, palette indexes as in
+    // the images. All pages lie back to back in one buffer.
+    struct AtlasPage {
+        uint16_t Width = 0;
+        uint16_t Height = 0;
+        DataView Pixels;
+    };
+
+    // Contents of the RIFF "fmt " chunk
+    struct WaveFormat {
+        uint16_t FormatTag = 0;
+        uint16_t Channels = 0;
+        uint32_t SampleRate = 0;
+        uint32_t ByteRate = 0;
+        uint16_t BlockAlign = 0;
+        uint16_t BitsPerSample = 0;
+    };
 
     class Sound {
     public:
+        enum FormatTag {
+            FormatPCM = 0x0001
+        };
         uint32_t SoundID() const;
         uint32_t Size() const;
         std::vector<uint8_t> Data() const;
+        // Parsed once at load, PCM() is empty when the RIFF data
+        // has no usable "fmt " and "data" chunks
+        const WaveFormat& Format() const;
+        DataView PCM() const;
         bool WriteToFile(std::filesystem::path file);
     private:
         friend class libacsfile::CharacterPrivate;
+        friend class libacsfile::CharacterWriter;
         explicit Sound(libacsfile::SoundPrivate *priv);
         ~Sound();
         libacsfile::SoundPrivate *p = nullptr;
@@ -40,12 +83,35 @@ namespace libacsfile {
         uint32_t ImageID() const;
         uint32_t Size() const;
         bool Compressed() const;
+        // Bottom-up DIB rows, Stride() bytes each
         std::vector<uint8_t> Data() const;
+        // Data() without a copy, nullptr for delta encoded and atlas images
+        const uint8_t* Bits() const;
+        uint32_t Stride() const;
         uint16_t Width() const;
         uint16_t Height() const;
+        bool HasTransparentRuns() const;
+        // Where the image was packed, false when it is not in the atlas
+        bool AtlasLocation(libacsfile::AtlasRect &rect) const;
+        // Composites the image into a top-down ARGB32 buffer at (x, y),
+        // stride is in pixels. Transparent pixels are left untouched.
+        void Blit(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                  int x, int y, const uint32_t *palette) const;
+        // Image this one is stored as a delta against, nullptr for keyframes.
+        // BlitDelta only redraws the dirty rectangle over a buffer that
+        // holds DeltaBase() blitted at the same position.
+        libacsfile::Image* DeltaBase() const;
+        void BlitDelta(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                       int x, int y, const uint32_t *palette) const;
+        // 8-bit BMP with the character palette
         bool WriteToFile(std::filesystem::path file);
+        // RGBA QOI, the transparent index becomes fully transparent
+        bool WriteToQOIFile(std::filesystem::path file);
+        std::vector<uint8_t> EncodeQOI() const;
     private:
         friend class libacsfile::CharacterPrivate;
+        friend class libacsfile::FramePrivate;
+        friend class libacsfile::CharacterWriter;
         explicit Image(libacsfile::ImagePrivate *priv);
         ~Image();
         libacsfile::ImagePrivate *p = nullptr;
@@ -68,9 +134,12 @@ namespace libacsfile {
         uint16_t Width() const;
         uint16_t Height() const;
         libacsfile::Image* Image() const;
+        // Drawn instead of the frame's top image rather than over it
+        bool ReplacesTopImage() const;
     private:
         friend class libacsfile::OverlayPrivate;
         friend class libacsfile::FramePrivate;
+        friend class libacsfile::CharacterWriter;
         explicit Overlay(libacsfile::OverlayPrivate *priv);
         ~Overlay();
         libacsfile::OverlayPrivate *p = nullptr;
@@ -111,8 +180,29 @@ namespace libacsfile {
         std::vector<FrameImage*> Images() const;
         std::vector<Branch*> Branches() const;
         std::vector<Overlay*> MouthOverlays() const;
+        // The mouth overlay of the given type, nullptr if the frame has none
+        const Overlay* MouthOverlay(Overlay::Type type) const;
+        // Clears a top-down ARGB32 target and draws the frame images, the
+        // first listed image on top, then the mouth overlay if one of
+        // MouthOverlays() is given. Uses the kernel picked for this frame
+        // at load for character-sized targets. Does not allocate.
+        void Composite(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                       const uint32_t *palette, const Overlay *mouth = nullptr) const;
+        // Whether the frame is previous with its image swapped for a delta
+        // of it at the same place (see Image::DeltaBase). Playing forward,
+        // CompositeDelta then turns a target holding previous into this
+        // frame by redrawing only the dirty rectangle.
+        bool FollowsByDelta(const Frame *previous) const;
+        // Updates a target that holds previous composited without a mouth
+        // overlay, only valid when FollowsByDelta(previous). A frame
+        // without a delta image is composited whole. The palette needs the
+        // transparent index all zero, like ARGBPalette().
+        void CompositeDelta(uint32_t *target, int targetWidth, int targetHeight, int targetStride,
+                            const uint32_t *palette) const;
     private:
         friend class libacsfile::AnimationPrivate;
+        friend class libacsfile::CharacterWriter;
+        friend class libacsfile::AnimationPlayerPrivate;
         explicit Frame(libacsfile::FramePrivate *priv);
         ~Frame();
         libacsfile::FramePrivate *p = nullptr;
@@ -131,11 +221,91 @@ namespace libacsfile {
         std::map<uint16_t, Frame*> Frames() const;
     private:
         friend class libacsfile::CharacterPrivate;
+        friend class libacsfile::CharacterWriter;
+        friend class libacsfile::AnimationPlayerPrivate;
         explicit Animation(libacsfile::AnimationPrivate *priv);
         ~Animation();
         libacsfile::AnimationPrivate *p = nullptr;
     };
 
+    struct LoadOptions {
+        // Collapse byte-identical decoded images onto one shared buffer
+        bool DeduplicateImages = false;
+        // Build per-row skip/opaque run tables for fast blitting
+        bool BuildTransparentRuns = false;
+        // Store images that follow each other in an animation as a
+        // keyframe plus dirty rectangle, dropping their full bitmaps
+        bool DeltaEncodeImages = false;
+        // Pack the full bitmaps into a few atlas pages in one buffer, the
+        // images of an animation next to each other, and draw from there
+        bool PackAtlas = false;
+        // Width of atlas pages, pages grow to as many rows as this too.
+        // Wider images get a page of their own.
+        uint16_t AtlasPageSize = 1024;
+    };
+
+    // Filled in by Character::Load. Times are wall clock nanoseconds,
+    // allocations are the objects and buffers the loader creates itself
+    // (strings and container bookkeeping are not counted).
+    struct LoadStats {
+        uint64_t HeaderTime = 0;        // reading the file and its header
+        uint64_t ValidateTime = 0;
+        uint64_t CharacterInfoTime = 0;
+        uint64_t ImageReadTime = 0;
+        uint64_t ImageDecodeTime = 0;
+        uint64_t PostProcessTime = 0;   // LoadOptions image passes
+        uint64_t SoundTime = 0;
+        uint64_t AnimationTime = 0;
+        uint64_t TotalTime = 0;
+
+        uint64_t FileBytes = 0;
+        uint32_t Images = 0;
+        uint32_t CompressedImages = 0;
+        uint64_t ImageCompressedBytes = 0;  // in the file, compressed images only
+        uint64_t ImageStoredBytes = 0;      // in the file, uncompressed images only
+        uint64_t ImageDecodedBytes = 0;
+        uint64_t RegionBytes = 0;
+        uint32_t Sounds = 0;
+        uint64_t SoundBytes = 0;
+        uint32_t Animations = 0;
+        uint32_t Frames = 0;
+        uint32_t FrameImages = 0;
+        uint32_t Branches = 0;
+        uint32_t Overlays = 0;
+        uint32_t AtlasPages = 0;
+        uint64_t AtlasBytes = 0;
+
+        uint64_t Allocations = 0;
+        uint64_t AllocatedBytes = 0;
+    };
+
+    struct SaveOptions {
+        enum Compression {
+            Store,  // images are written uncompressed
+            Fast,   // greedy matching over short hash chains
+            Best    // lazy matching over long hash chains
+        };
+        Compression Preset = Fast;
+        // Animations to keep, empty keeps everything. Return animations of
+        // kept animations are kept too, unreferenced images and sounds are dropped.
+        std::vector<std::string> Animations;
+        // Write byte-identical images only once
+        bool DeduplicateImages = true;
+        // Decode every compressed image again and compare before writing
+        bool Verify = false;
+        // Compression worker count, 0 uses every available core
+        unsigned int Threads = 0;
+    };
+
+    // Compresses data into the bitstream used by ACS image data
+    std::vector<uint8_t> CompressData(const std::vector<uint8_t> &data,
+                                      SaveOptions::Compression preset = SaveOptions::Fast);
+
+    // Indexed PNG of width x height palette indexes, rows top-down and
+    // stride bytes apart. transparentIndex, if not -1, gets zero alpha.
+    std::vector<uint8_t> EncodePNG(const uint8_t *pixels, uint32_t width, uint32_t height, size_t stride,
+                                   const std::vector<RGBQUAD> &palette, int transparentIndex = -1);
+
     class Character {
     public:
         enum Type {
@@ -147,12 +317,20 @@ namespace libacsfile {
         };
         Character() = default;
         ~Character();
-        bool Load(const std::string &filename);
+        bool Load(const std::string &filename, const LoadOptions &options = LoadOptions());
         bool Loaded();
+        // Writes the character back out as an ACS 2.0 file
+        bool Save(const std::string &filename, const SaveOptions &options = SaveOptions());
         std::string GetLastError() const;
         std::string GUID() const;
+        // Localized strings are UTF-8. Without a LANGID the English entry
+        // is used; unknown languages fall back to the same primary language,
+        // then English, then the first entry in the file.
         std::string Name() const;
+        std::string Name(uint16_t langId) const;
         std::string Description() const;
+        std::string Description(uint16_t langId) const;
+        std::vector<uint16_t> Languages() const;
         uint16_t Width() const;
         uint16_t Height() const;
         bool TTSEnabled() const;
@@ -164,7 +342,10 @@ namespace libacsfile {
         uint16_t Age() const;
         std::string Style() const;
         RGBQUAD TransparentColor() const;
+        uint8_t TransparentIndex() const;
         std::vector<RGBQUAD> ColorPalette() const;
+        // Palette as ARGB32, the transparent index has zero alpha
+        std::vector<uint32_t> ARGBPalette() const;
         bool BalloonEnabled() const;
         std::string BalloonFont() const;
         bool TrayIconEnabled() const;
@@ -179,6 +360,12 @@ namespace libacsfile {
 
         std::map<uint16_t, Image*> Images() const;
         std::map<uint16_t, Sound*> Sounds() const;
+        uint64_t DeduplicatedBytes() const;
+        uint64_t DeltaSavedBytes() const;
+        // Empty unless loaded with LoadOptions::PackAtlas
+        std::vector<AtlasPage> AtlasPages() const;
+        // Where load time and memory went, see LoadStats
+        LoadStats Stats() const;
     private:
         libacsfile::CharacterPrivate *p = nullptr;
         std::string last_error;
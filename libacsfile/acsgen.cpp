@@ -0,0 +1,105 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Writes synthetic ACS 2.0 characters for tests and benchmarks.
+//   acsgen [--preset=small|large|pathological] [--option=value...] out.acs
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <functional>
+#include <stdexcept>
+
+#include "acsgenerator.h"
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    libacsfile::GeneratorOptions options;
+    using Setter = function<void(const string&)>;
+    auto integer = [](auto &field) -> Setter {
+        return [&field](const string &value) {
+            field = static_cast<remove_reference_t<decltype(field)>>(stoull(value));
+        };
+    };
+    map<string, Setter> setters = {
+        { "seed", integer(options.Seed) },
+        { "width", integer(options.Width) },
+        { "height", integer(options.Height) },
+        { "languages", integer(options.Languages) },
+        { "voice", integer(options.Voice) },
+        { "images", integer(options.Images) },
+        { "image-width", integer(options.ImageWidth) },
+        { "image-height", integer(options.ImageHeight) },
+        { "compression-ratio", [&](const string &value) { options.CompressionRatio = stod(value); } },
+        { "animations", integer(options.Animations) },
+        { "frames", integer(options.FramesPerAnimation) },
+        { "images-per-frame", integer(options.ImagesPerFrame) },
+        { "derived-images", integer(options.DerivedImages) },
+        { "dirty-rect-size", integer(options.DirtyRectSize) },
+        { "sequential-animations", integer(options.SequentialAnimations) },
+        { "branches", integer(options.BranchesPerFrame) },
+        { "overlays", integer(options.OverlaysPerFrame) },
+        { "sound-frames", integer(options.SoundFrames) },
+        { "sounds", integer(options.Sounds) },
+        { "sound-bytes", integer(options.SoundBytes) },
+        { "states", integer(options.States) },
+        { "animations-per-state", integer(options.AnimationsPerState) },
+    };
+
+    string output;
+    try
+    {
+        // the preset goes first so the other options can adjust it
+        for(int i = 1; i < argc; ++i)
+        {
+            string arg = argv[i];
+            if(arg.rfind("--preset=", 0) == 0)
+                options = libacsfile::GeneratorPreset(arg.substr(9));
+        }
+
+        for(int i = 1; i < argc; ++i)
+        {
+            string arg = argv[i];
+            if(arg.rfind("--", 0) != 0)
+            {
+                output = arg;
+                continue;
+            }
+
+            size_t eq = arg.find('=');
+            string key = arg.substr(2, eq == string::npos ? string::npos : eq - 2);
+            if(key == "preset")
+                continue;
+            auto setter = setters.find(key);
+            if(setter == setters.end() || eq == string::npos)
+                throw runtime_error("Unknown option: " + arg);
+            setter->second(arg.substr(eq + 1));
+        }
+
+        if(output.empty())
+        {
+            cerr << "usage: " << argv[0] << " [--preset=small|large|pathological] [--option=value...] out.acs" << endl;
+            cerr << "options:";
+            for(auto &[key, setter] : setters)
+                cerr << " --" << key;
+            cerr << endl;
+            return 2;
+        }
+
+        vector<uint8_t> data = libacsfile::GenerateCharacter(options);
+        ofstream ofs(output, ios::binary | ios::trunc);
+        if(!ofs.write(reinterpret_cast<const char*>(data.data()), data.size()))
+            throw runtime_error("Cannot write " + output);
+        cout << output << ": " << data.size() << " bytes" << endl;
+    }
+    catch(exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace libacsfile {
+
+    // Shape of a synthetic ACS 2.0 character. The same options and seed
+    // always produce the same bytes.
+    struct GeneratorOptions {
+        uint64_t Seed = 1;
+        uint16_t Width = 128;
+        uint16_t Height = 128;
+        // Languages in the localized info, English first
+        uint16_t Languages = 1;
+        bool Voice = false;
+
+        uint32_t Images = 32;
+        uint16_t ImageWidth = 128;
+        uint16_t ImageHeight = 128;
+        // Approximate compressed / raw size of the image data, values of
+        // 1 or more store the images uncompressed
+        double CompressionRatio = 0.25;
+
+        uint32_t Animations = 8;
+        uint16_t FramesPerAnimation = 8;
+        uint16_t ImagesPerFrame = 1;
+        // Percentage of images drawn as the image before them with one
+        // rectangle redrawn, DirtyRectSize percent of each side, like
+        // consecutive poses of an animation
+        uint8_t DerivedImages = 0;
+        uint8_t DirtyRectSize = 15;
+        // Percentage of animations showing one image per frame, the next
+        // image each frame at a fixed offset. Over derived images these
+        // are what LoadOptions::DeltaEncodeImages turns into delta chains.
+        uint8_t SequentialAnimations = 0;
+        // Upper bounds, every frame draws a count between 0 and these
+        uint8_t BranchesPerFrame = 0;
+        uint8_t OverlaysPerFrame = 0;
+        // Percentage of frames that play a sound
+        uint8_t SoundFrames = 10;
+
+        uint32_t Sounds = 4;
+        uint32_t SoundBytes = 8000;     // PCM bytes per sound
+
+        uint16_t States = 4;
+        uint16_t AnimationsPerState = 2;
+    };
+
+    // Options of the acsgen presets, "default", "small", "large" and
+    // "pathological". Throws std::runtime_error for other names.
+    GeneratorOptions GeneratorPreset(const std::string &name);
+
+    // Throws std::runtime_error if the options cannot be represented in an
+    // ACS file (too many images or sounds, more than 4 GiB of data)
+    std::vector<uint8_t> GenerateCharacter(const GeneratorOptions &options);
+}
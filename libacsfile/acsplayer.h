@@ -0,0 +1,116 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "acsfile.h"
+
+namespace libacsfile {
+    class AnimationPlayerPrivate;
+
+    struct PlayerOptions {
+        // What a step does with frames whose time has already passed
+        enum LatePolicy {
+            Skip,       // leave them out and show the one due now
+            Shorten,    // show each of them for what is left of its time
+            Delay       // give each its whole duration, the rest runs late
+        };
+        LatePolicy Late = Skip;
+    };
+
+    // Totals since the player was made or ResetMetrics, in milliseconds
+    struct PlayerMetrics {
+        uint32_t Animations = 0;        // finished
+        // Frame durations of the finished animations
+        uint64_t NominalTime = 0;
+        // From when their first frame was due until a step saw them finish
+        uint64_t AchievedTime = 0;
+        uint32_t FramesShown = 0;
+        uint32_t FramesSkipped = 0;
+        // Frames entered after their due time, and by how much
+        uint32_t LateFrames = 0;
+        uint64_t TotalLateness = 0;
+        uint64_t MaxLateness = 0;
+    };
+
+    // Where playback stands after AnimationPlayer::Advance or Next
+    struct PlayerStep {
+        // What to show, both stay on the last frame once playback is idle
+        const libacsfile::Animation *Animation = nullptr;
+        const libacsfile::Frame *Frame = nullptr;
+        uint16_t FrameIndex = 0;
+        // A frame was entered during the step, possibly the same one again
+        bool FrameEntered = false;
+        // Sound of the last frame entered during the step that has one,
+        // that frame, and the player time it started. Skipping may have
+        // entered other frames after it in the same step.
+        const libacsfile::Sound *Sound = nullptr;
+        const libacsfile::Frame *SoundFrame = nullptr;
+        uint16_t SoundFrameIndex = 0;
+        uint64_t SoundStart = 0;
+        // Player time in milliseconds the shown frame ends
+        uint64_t Deadline = 0;
+        // The animation is leaving through its exit frames
+        bool Stopping = false;
+        // How long after its due time the shown frame was entered
+        uint64_t Lateness = 0;
+        // Animations that finished during the step, and the nominal and
+        // achieved durations of the last of them
+        uint16_t Completed = 0;
+        uint64_t NominalDuration = 0;
+        uint64_t AchievedDuration = 0;
+    };
+
+    // Animation playback as the Agent runtime does it, without a clock or
+    // a window. Frames without images are passed over, branches are rolled
+    // against their probabilities, a stop follows the exit frames, and the
+    // animation that finished last returns to rest (its return animation,
+    // or its exit frames from the frame it held) before the next one
+    // starts. Branch choices come from seed, so the same calls always give
+    // the same frames. Play may allocate, stepping never does.
+    //
+    // Deadlines are absolute on the player clock, each frame ends its
+    // duration after the previous one was due to end, so late steps do
+    // not add up unless PlayerOptions::Delay asks for that.
+    class AnimationPlayer {
+    public:
+        // Deadline while nothing is playing
+        static constexpr uint64_t Never = UINT64_MAX;
+
+        explicit AnimationPlayer(uint64_t seed = 0, const PlayerOptions &options = PlayerOptions());
+        ~AnimationPlayer();
+        AnimationPlayer(const AnimationPlayer&) = delete;
+        AnimationPlayer& operator=(const AnimationPlayer&) = delete;
+
+        // Starts animation with the next step when idle, otherwise stops
+        // the playing one and queues animation behind it
+        void Play(const libacsfile::Animation *animation);
+        // The playing animation leaves through its exit frames, queued
+        // animations still follow
+        void Stop();
+        // Drops the queue and everything shown, the clock keeps its time
+        void Reset();
+
+        // Moves the clock on by elapsed milliseconds and follows every
+        // frame due by then
+        const PlayerStep& Advance(uint64_t elapsed);
+        // Moves the clock to the deadline and enters the frame after it,
+        // for playing headless at full speed
+        const PlayerStep& Next();
+        const PlayerStep& Current() const;
+
+        uint64_t Now() const;
+        bool Playing() const;
+        size_t Queued() const;
+
+        PlayerOptions Options() const;
+        void SetOptions(const PlayerOptions &options);
+        PlayerMetrics Metrics() const;
+        void ResetMetrics();
+    private:
+        libacsfile::AnimationPlayerPrivate *p = nullptr;
+    };
+}
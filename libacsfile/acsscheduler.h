@@ -0,0 +1,50 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace libacsfile {
+    class FrameSchedulerPrivate;
+
+    // Frame deadlines of any number of players on one shared clock, so a
+    // host needs a single timer for all of them. Clients whose deadlines
+    // fall within the coalescing window of the earliest one are handed
+    // out together and woken by the same tick. Scheduling a client again
+    // replaces its deadline. Nothing allocates once the queue has grown
+    // to the number of clients.
+    class FrameScheduler {
+    public:
+        typedef uint32_t Client;
+        // Deadline of a client that is not scheduled
+        static constexpr uint64_t Never = UINT64_MAX;
+
+        explicit FrameScheduler(uint64_t coalesce = 0);
+        ~FrameScheduler();
+        FrameScheduler(const FrameScheduler&) = delete;
+        FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+        Client Add();
+        // The handle is reused by a later Add
+        void Remove(Client client);
+        // Never unschedules the client
+        void Schedule(Client client, uint64_t deadline);
+        uint64_t Deadline(Client client) const;
+
+        // Earliest deadline to wake up for, Never when nothing is scheduled
+        uint64_t NextWakeup();
+        // Appends the clients due by now plus the coalescing window to due,
+        // earliest first, and unschedules them. Returns how many there were.
+        size_t TakeDue(uint64_t now, std::vector<Client> &due);
+
+        uint64_t Coalesce() const;
+        void SetCoalesce(uint64_t coalesce);
+        size_t Clients() const;
+        size_t Scheduled() const;
+    private:
+        libacsfile::FrameSchedulerPrivate *p = nullptr;
+    };
+}
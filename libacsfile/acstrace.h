@@ -0,0 +1,59 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Chrome/Perfetto trace events (chrome://tracing, ui.perfetto.dev).
+// Spans are only compiled in when the library is configured with
+// LIBACSFILE_TRACING, which defines ACS_TRACING for libacsfile and
+// everything linking it. Recording starts when the ACS_TRACE environment
+// variable names an output file, or through Trace::Start(). The file is
+// written by Trace::Stop() or at exit.
+
+namespace libacsfile {
+    namespace Trace {
+        // Returns false if tracing is compiled out or the file can't be created
+        bool Start(const std::string &filename);
+        void Stop();
+        bool Enabled();
+        void Instant(const char *category, const char *name, const std::string &detail = std::string());
+
+        // Records a complete event from construction to destruction.
+        // category and name must be string literals.
+        class Scope
+        {
+        public:
+            Scope(const char *category, const char *name);
+            ~Scope();
+            bool Active() const { return active; }
+            void Detail(const std::string &text) { detail = text; }
+        private:
+            const char *category;
+            const char *name;
+            std::string detail;
+            uint64_t start = 0;
+            bool active = false;
+        };
+    }
+}
+
+#ifdef ACS_TRACING
+#define ACS_TRACE_CONCAT2(a, b) a##b
+#define ACS_TRACE_CONCAT(a, b) ACS_TRACE_CONCAT2(a, b)
+#define ACS_TRACE_SCOPE(category, name) \
+    libacsfile::Trace::Scope ACS_TRACE_CONCAT(acsTraceScope, __LINE__)(category, name)
+// detail is only evaluated while recording
+#define ACS_TRACE_SCOPE_DETAIL(category, name, detail) \
+    libacsfile::Trace::Scope ACS_TRACE_CONCAT(acsTraceScope, __LINE__)(category, name); \
+    if(ACS_TRACE_CONCAT(acsTraceScope, __LINE__).Active()) \
+        ACS_TRACE_CONCAT(acsTraceScope, __LINE__).Detail(detail)
+#define ACS_TRACE_INSTANT(category, name) \
+    do { if(libacsfile::Trace::Enabled()) libacsfile::Trace::Instant(category, name); } while(0)
+#else
+#define ACS_TRACE_SCOPE(category, name) do {} while(0)
+#define ACS_TRACE_SCOPE_DETAIL(category, name, detail) do {} while(0)
+#define ACS_TRACE_INSTANT(category, name) do {} while(0)
+#endif
@@ -0,0 +1,367 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Microbenchmarks for the loader and the compositing paths. Every result
+// is printed as one JSON object per line so runs can be diffed:
+//   {"name":"DecodeData/large","iterations":..,"ns_per_op":..,"mb_per_s":..,"allocs_per_op":..}
+//   libacsfile_bench [--filter=substring] [--min-time=ms]
+
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <functional>
+#include <filesystem>
+#include <new>
+
+#include "acsfile.h"
+#include "acs_private.h"
+#include "acsgenerator.h"
+
+using namespace std;
+using namespace libacsfile;
+
+// Counting every allocation in the process gives allocs/op without
+// instrumenting the library
+static atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+    if(void *ptr = malloc(size ? size : 1))
+        return ptr;
+    throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+struct Benchmark {
+    string Name;
+    uint64_t BytesPerOp = 0;        // 0 leaves mb_per_s out
+    function<void()> Run;
+};
+
+static double minTime = 0.2;
+
+static void Measure(const Benchmark &bench)
+{
+    typedef chrono::steady_clock Clock;
+    bench.Run();
+
+    // grow the batch until it runs for at least minTime
+    uint64_t iterations = 1;
+    double elapsed = 0;
+    uint64_t allocated = 0;
+    for(;;)
+    {
+        uint64_t before = allocations.load(memory_order_relaxed);
+        Clock::time_point start = Clock::now();
+        for(uint64_t i = 0; i < iterations; ++i)
+            bench.Run();
+        elapsed = chrono::duration<double>(Clock::now() - start).count();
+        allocated = allocations.load(memory_order_relaxed) - before;
+        if(elapsed >= minTime || iterations >= (1ull << 40))
+            break;
+        double scale = elapsed > 0 ? minTime * 1.2 / elapsed : 100;
+        iterations = static_cast<uint64_t>(iterations * min(100.0, max(2.0, scale)));
+    }
+
+    char line[512];
+    int n = snprintf(line, sizeof(line), "{\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f",
+                     bench.Name.c_str(), static_cast<unsigned long long>(iterations),
+                     elapsed * 1e9 / iterations);
+    if(bench.BytesPerOp)
+        n += snprintf(line + n, sizeof(line) - n, ",\"mb_per_s\":%.1f",
+                      bench.BytesPerOp * iterations / elapsed / 1e6);
+    snprintf(line + n, sizeof(line) - n, ",\"allocs_per_op\":%.2f}",
+             static_cast<double>(allocated) / iterations);
+    cout << line << endl;
+}
+
+// A library preset with a fixed seed
+static GeneratorOptions PresetCharacter(const string &name, uint64_t seed)
+{
+    GeneratorOptions options = GeneratorPreset(name);
+    options.Seed = seed;
+    return options;
+}
+
+// Animations stepping through images that each change a small rectangle
+// of the one before, what LoadOptions::DeltaEncodeImages is for
+static GeneratorOptions DeltaCharacter()
+{
+    GeneratorOptions options;
+    options.Seed = 3;
+    options.Images = 64;
+    options.ImageWidth = 200;
+    options.ImageHeight = 160;
+    options.Width = 200;
+    options.Height = 160;
+    options.Animations = 8;
+    options.FramesPerAnimation = 8;
+    options.DerivedImages = 100;
+    options.SequentialAnimations = 100;
+    options.Sounds = 1;
+    options.SoundBytes = 2000;
+    return options;
+}
+
+static string WriteTemporary(const string &name, const vector<uint8_t> &data)
+{
+    filesystem::path path = filesystem::temp_directory_path() / name;
+    ofstream ofs(path, ios::binary | ios::trunc);
+    ofs.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return path.string();
+}
+
+// Offset and size of the compressed data of the first compressed image
+static bool FirstCompressedImage(const vector<uint8_t> &file, size_t &offset, uint32_t &size,
+                                 uint32_t &decodedSize)
+{
+    ACSLOCATOR imageInfo{};
+    memcpy(&imageInfo, file.data() + 4 + 2 * sizeof(ACSLOCATOR), sizeof(ACSLOCATOR));
+    uint32_t count{};
+    memcpy(&count, file.data() + imageInfo.Offset, sizeof(uint32_t));
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        ACSLOCATOR locator{};
+        memcpy(&locator, file.data() + imageInfo.Offset + 4 + i * 12, sizeof(ACSLOCATOR));
+        const uint8_t *image = file.data() + locator.Offset;
+        uint16_t width{}, height{};
+        memcpy(&width, image + 1, sizeof(uint16_t));
+        memcpy(&height, image + 3, sizeof(uint16_t));
+        if(image[5] == 0)
+            continue;
+        memcpy(&size, image + 6, sizeof(uint32_t));
+        offset = locator.Offset + 10;
+        decodedSize = ((width + 3u) & ~3u) * height;
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    string filter;
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg.rfind("--filter=", 0) == 0)
+            filter = arg.substr(9);
+        else if(arg.rfind("--min-time=", 0) == 0)
+            minTime = stod(arg.substr(11)) / 1000.0;
+        else
+        {
+            cerr << "usage: " << argv[0] << " [--filter=substring] [--min-time=ms]" << endl;
+            return 2;
+        }
+    }
+
+    const vector<uint8_t> smallFile = GenerateCharacter(PresetCharacter("small", 1));
+    const vector<uint8_t> largeFile = GenerateCharacter(PresetCharacter("large", 2));
+    const string smallPath = WriteTemporary("libacsfile_bench_small.acs", smallFile);
+    const string largePath = WriteTemporary("libacsfile_bench_large.acs", largeFile);
+    const string deltaPath = WriteTemporary("libacsfile_bench_delta.acs", GenerateCharacter(DeltaCharacter()));
+
+    Character character;
+    if(!character.Load(largePath))
+    {
+        cerr << character.GetLastError() << endl;
+        return 1;
+    }
+
+    vector<Benchmark> benchmarks;
+
+    // DecodeData straight from the file buffer into a reused bitmap
+    for(auto &[name, file] : { make_pair(string("small"), &smallFile),
+                               make_pair(string("large"), &largeFile) })
+    {
+        size_t offset{};
+        uint32_t size{}, decodedSize{};
+        if(!FirstCompressedImage(*file, offset, size, decodedSize))
+            continue;
+        auto bitmap = make_shared<vector<uint8_t>>(decodedSize);
+        const uint8_t *src = file->data() + offset;
+        benchmarks.push_back({ "DecodeData/" + name, decodedSize, [=]() {
+            CharacterPrivate::DecodeData(src, size, bitmap->data(), bitmap->size());
+        } });
+    }
+
+    // ReadString over a block of animation names
+    {
+        auto strings = make_shared<vector<uint8_t>>();
+        for(int i = 0; i < 64; ++i)
+        {
+            string name = "Animation" + to_string(i * 7919);
+            uint32_t length = static_cast<uint32_t>(name.size());
+            strings->insert(strings->end(), reinterpret_cast<uint8_t*>(&length),
+                            reinterpret_cast<uint8_t*>(&length) + sizeof(uint32_t));
+            for(char ch : name)
+            {
+                strings->push_back(static_cast<uint8_t>(ch));
+                strings->push_back(0);
+            }
+            strings->push_back(0);
+            strings->push_back(0);
+        }
+        benchmarks.push_back({ "ReadString/64", strings->size(), [strings]() {
+            ACSReader reader(strings->data(), strings->size());
+            for(int i = 0; i < 64; ++i)
+                CharacterPrivate::ReadString(reader);
+        } });
+    }
+
+    // Full loads, default options and everything the inspector turns on
+    LoadOptions inspector;
+    inspector.DeduplicateImages = true;
+    inspector.BuildTransparentRuns = true;
+    inspector.DeltaEncodeImages = true;
+    for(auto &[name, path, bytes] : { make_tuple(string("small"), smallPath, smallFile.size()),
+                                      make_tuple(string("large"), largePath, largeFile.size()) })
+    {
+        benchmarks.push_back({ "Load/" + name, bytes, [path = path]() {
+            Character c;
+            c.Load(path);
+        } });
+        benchmarks.push_back({ "Load/" + name + "/inspector", bytes, [path = path, inspector]() {
+            Character c;
+            c.Load(path, inspector);
+        } });
+        benchmarks.push_back({ "Load/" + name + "/atlas", bytes, [path = path]() {
+            LoadOptions atlas;
+            atlas.PackAtlas = true;
+            Character c;
+            c.Load(path, atlas);
+        } });
+    }
+
+    // Expanding one image to ARGB through the palette
+    auto palette = make_shared<vector<uint32_t>>(character.ARGBPalette());
+    auto canvas = make_shared<vector<uint32_t>>(static_cast<size_t>(character.Width()) * character.Height());
+    Image *image = character.Images().begin()->second;
+    const int width = character.Width(), height = character.Height();
+    benchmarks.push_back({ "ExpandImage/argb", static_cast<uint64_t>(image->Width()) * image->Height() * 4,
+                           [=]() {
+        image->Blit(canvas->data(), width, height, width, 0, 0, palette->data());
+    } });
+
+    // QOI export of the same image
+    benchmarks.push_back({ "EncodeQOI", static_cast<uint64_t>(image->Width()) * image->Height() * 4,
+                           [=]() {
+        image->EncodeQOI();
+    } });
+
+    // Compositing every frame of one animation, as the renderer does
+    Animation *animation = character.Animations().begin()->second;
+    auto frames = make_shared<vector<Frame*>>();
+    for(auto &[index, frame] : animation->Frames())
+        frames->push_back(frame);
+    benchmarks.push_back({ "CompositeFrame", static_cast<uint64_t>(width) * height * 4 * frames->size(),
+                           [=]() {
+        for(Frame *frame : *frames)
+        {
+            fill(canvas->begin(), canvas->end(), 0);
+            for(auto fimg : frame->Images())
+                if(fimg->GetImage())
+                    fimg->GetImage()->Blit(canvas->data(), width, height, width,
+                                           fimg->OffsetX(), fimg->OffsetY(), palette->data());
+        }
+    } });
+
+    // The same through the kernel each frame picked at load
+    benchmarks.push_back({ "CompositeFrame/kernel", static_cast<uint64_t>(width) * height * 4 * frames->size(),
+                           [=]() {
+        for(Frame *frame : *frames)
+            frame->Composite(canvas->data(), width, height, width, palette->data());
+    } });
+
+    // The same with every image drawn out of the atlas pages
+    auto packed = make_shared<Character>();
+    LoadOptions atlas;
+    atlas.PackAtlas = true;
+    packed->Load(largePath, atlas);
+    auto packedFrames = make_shared<vector<Frame*>>();
+    for(auto &[index, frame] : packed->Animations().begin()->second->Frames())
+        packedFrames->push_back(frame);
+    benchmarks.push_back({ "CompositeFrame/atlas", static_cast<uint64_t>(width) * height * 4 * packedFrames->size(),
+                           [=]() {
+        for(Frame *frame : *packedFrames)
+            frame->Composite(canvas->data(), width, height, width, palette->data());
+    } });
+
+    // Playing every animation forward with and without delta images:
+    // drawing each frame anew from the keyframe and dirty rectangles, and
+    // updating the previous frame by its dirty rectangle as FrameCache does
+    for(auto &[name, delta] : { make_pair(string("full"), false), make_pair(string("delta"), true) })
+    {
+        LoadOptions options;
+        options.DeltaEncodeImages = delta;
+        auto character = make_shared<Character>();
+        character->Load(deltaPath, options);
+        auto played = make_shared<vector<Frame*>>();
+        for(auto &[animationName, animation] : character->Animations())
+            for(auto &[index, frame] : animation->Frames())
+                played->push_back(frame);
+        auto argb = make_shared<vector<uint32_t>>(character->ARGBPalette());
+        const int w = character->Width(), h = character->Height();
+        const uint64_t bytes = static_cast<uint64_t>(w) * h * 4 * played->size();
+        auto target = make_shared<vector<uint32_t>>(static_cast<size_t>(w) * h);
+        // the frames belong to the character, the lambdas keep it alive
+        benchmarks.push_back({ "CompositeSequence/" + name, bytes, [character, played, argb, target, w, h]() {
+            for(Frame *frame : *played)
+                frame->Composite(target->data(), w, h, w, argb->data());
+        } });
+        if(!delta)
+            continue;
+
+        // the copy stands in for the new cache buffer the previous frame
+        // is copied into
+        auto previous = make_shared<vector<uint32_t>>(static_cast<size_t>(w) * h);
+        benchmarks.push_back({ "CompositeSequence/delta/incremental", bytes,
+                               [character, played, argb, target, previous, w, h]() {
+            const Frame *last = nullptr;
+            for(Frame *frame : *played)
+            {
+                if(frame->FollowsByDelta(last))
+                {
+                    copy(previous->begin(), previous->end(), target->begin());
+                    frame->CompositeDelta(target->data(), w, h, w, argb->data());
+                }
+                else
+                    frame->Composite(target->data(), w, h, w, argb->data());
+                previous->swap(*target);
+                last = frame;
+            }
+        } });
+    }
+
+    // Looking up animations by name
+    auto names = make_shared<vector<string>>(character.AnimationNames());
+    benchmarks.push_back({ "GetAnimation", 0, [names, &character]() {
+        for(auto &name : *names)
+            character.GetAnimation(name);
+    } });
+
+    for(auto &bench : benchmarks)
+        if(filter.empty() || bench.Name.find(filter) != string::npos)
+            Measure(bench);
+
+    filesystem::remove(smallPath);
+    filesystem::remove(largePath);
+    filesystem::remove(deltaPath);
+    return 0;
+}
@@ -0,0 +1,278 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// AnimationPlayer over generated characters: the same seed plays the
+// same frames, stepping never allocates, a stopped player always runs
+// out, and each late policy takes as long as it promises.
+
+#include <string>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+
+#include "acsfile.h"
+#include "acsgenerator.h"
+#include "acsplayer.h"
+#include "acs_test.h"
+
+using namespace std;
+using namespace libacsfile;
+
+// Counting every allocation in the process, like the benchmarks do
+static atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+    if(void *ptr = malloc(size ? size : 1))
+        return ptr;
+    throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+// Next() calls a stopped player gets to go idle
+#define IDLE_STEP_LIMIT 100000
+
+struct StepRecord {
+    const libacsfile::Animation *Animation;
+    const libacsfile::Frame *Frame;
+    const libacsfile::Sound *Sound;
+    uint64_t Deadline;
+    uint16_t Completed;
+
+    bool operator==(const StepRecord &other) const
+    {
+        return Animation == other.Animation && Frame == other.Frame && Sound == other.Sound
+            && Deadline == other.Deadline && Completed == other.Completed;
+    }
+};
+
+// Plays every animation in turn with uneven steps, stopping some of them
+// early, and records what each step showed
+static vector<StepRecord> Play(const vector<const Animation*> &animations, uint64_t seed)
+{
+    AnimationPlayer player(seed);
+    uint64_t choices = 1;
+    vector<StepRecord> steps;
+    for(const Animation *animation : animations)
+    {
+        player.Play(animation);
+        for(int i = 0; i < 64 && player.Playing(); ++i)
+        {
+            if(NextRandom(choices) % 16 == 0)
+                player.Stop();
+            const PlayerStep &step = player.Advance(NextRandom(choices) % 200);
+            steps.push_back({ step.Animation, step.Frame, step.Sound, step.Deadline, step.Completed });
+        }
+    }
+    return steps;
+}
+
+static void Determinism(const string &preset, const vector<const Animation*> &animations)
+{
+    for(uint64_t seed : { 0ull, 1ull, 0xdeadbeefull })
+    {
+        const vector<StepRecord> first = Play(animations, seed);
+        CHECK(first == Play(animations, seed), preset + ": seed " + to_string(seed) + " plays differently");
+    }
+}
+
+static void NoAllocations(const string &preset, const vector<const Animation*> &animations)
+{
+    AnimationPlayer player(7);
+    uint64_t choices = 2;
+    uint64_t allocated = 0, steps = 0;
+    for(const Animation *animation : animations)
+    {
+        // Play may allocate, only the steps are counted
+        player.Play(animation);
+        for(int i = 0; i < 64 && player.Playing(); ++i, ++steps)
+        {
+            const uint64_t elapsed = NextRandom(choices) % 300;
+            const uint64_t before = allocations.load(memory_order_relaxed);
+            player.Advance(elapsed);
+            allocated += allocations.load(memory_order_relaxed) - before;
+        }
+    }
+    CHECK(allocated == 0, preset + ": " + to_string(allocated) + " allocations in " + to_string(steps) + " steps");
+}
+
+static void StopsGoIdle(const string &preset, const vector<const Animation*> &animations)
+{
+    uint64_t choices = 3;
+    for(const Animation *animation : animations)
+    {
+        AnimationPlayer player(NextRandom(choices));
+        player.Play(animation);
+        // something queued behind it returns the animation to rest first
+        if(NextRandom(choices) % 2)
+            player.Play(animations[NextRandom(choices) % animations.size()]);
+        for(uint64_t i = NextRandom(choices) % 32; i > 0 && player.Playing(); --i)
+            player.Next();
+
+        // the queued animation is stopped as well once it starts
+        int steps = 0;
+        while(player.Playing() && steps < IDLE_STEP_LIMIT)
+        {
+            player.Stop();
+            player.Next();
+            ++steps;
+        }
+        CHECK(!player.Playing(), preset + ": " + animation->Name() + " still playing after "
+                                     + to_string(steps) + " steps");
+        CHECK(player.Current().Deadline == AnimationPlayer::Never, preset + ": " + animation->Name()
+                                                                      + " idle with a deadline");
+    }
+}
+
+// Frame durations the animation adds up to when played straight through
+static uint64_t NominalDuration(const Animation *animation)
+{
+    uint64_t nominal = 0;
+    for(auto &[index, frame] : animation->Frames())
+        if(!frame->Images().empty())
+            nominal += static_cast<uint64_t>(frame->Duration()) * 10;
+    return nominal;
+}
+
+// Animations without branches, played alone: on time every policy takes
+// exactly the nominal time. Stepping late by tick, skipping finishes
+// within a tick of it, shortening shows every frame and delaying adds
+// up the lateness of every frame.
+static void LatePolicies(const string &preset, const vector<const Animation*> &animations)
+{
+    const uint64_t tick = 170;
+    for(PlayerOptions::LatePolicy late : { PlayerOptions::Skip, PlayerOptions::Shorten, PlayerOptions::Delay })
+    {
+        const string policy = late == PlayerOptions::Skip ? "skip" : late == PlayerOptions::Shorten ? "shorten" : "delay";
+        PlayerOptions options;
+        options.Late = late;
+        for(const Animation *animation : animations)
+        {
+            const string name = preset + "/" + policy + ": " + animation->Name();
+            const uint64_t nominal = NominalDuration(animation);
+            const uint32_t frames = static_cast<uint32_t>(animation->Frames().size());
+
+            AnimationPlayer onTime(0, options);
+            onTime.Play(animation);
+            const PlayerStep *step = &onTime.Advance(0);
+            for(uint32_t i = 0; i <= frames && !step->Completed; ++i)
+            {
+                const uint64_t due = step->Deadline;
+                step = &onTime.Advance(due - onTime.Now());
+                if(step->Sound)
+                    CHECK(step->SoundFrame == step->Frame && step->SoundStart == due, name + " sound start");
+            }
+            CHECK(step->Completed == 1, name + " on time did not finish");
+            CHECK(step->NominalDuration == nominal, name + " nominal " + to_string(step->NominalDuration)
+                                                        + ", expected " + to_string(nominal));
+            CHECK(step->AchievedDuration == nominal, name + " on time took " + to_string(step->AchievedDuration)
+                                                         + " of " + to_string(nominal));
+            CHECK(onTime.Metrics().LateFrames == 0, name + " on time has late frames");
+
+            AnimationPlayer behind(0, options);
+            behind.Play(animation);
+            step = &behind.Current();
+            for(uint32_t i = 0; i <= 2 * frames + nominal / tick + 2 && !step->Completed; ++i)
+            {
+                step = &behind.Advance(tick);
+                if(!step->Sound)
+                    continue;
+                // the sound goes with its own frame, which skipping may have left
+                // already, as may the animation finishing
+                const uint64_t soundEnd = step->SoundStart + static_cast<uint64_t>(step->SoundFrame->Duration()) * 10;
+                if(step->SoundFrame == step->Frame && !step->Completed)
+                    CHECK(soundEnd == step->Deadline, name + " sound start of the shown frame");
+                else
+                    CHECK(late == PlayerOptions::Skip && soundEnd <= behind.Now(), name + " sound start of a skipped frame");
+            }
+            const PlayerMetrics metrics = behind.Metrics();
+            const uint64_t achieved = step->AchievedDuration;
+            CHECK(step->Completed == 1, name + " late did not finish");
+            CHECK(step->NominalDuration == nominal && metrics.NominalTime == nominal, name + " late nominal");
+            CHECK(metrics.Animations == 1 && metrics.AchievedTime == achieved, name + " late metrics");
+            CHECK(achieved >= nominal, name + " late took " + to_string(achieved) + " of " + to_string(nominal));
+            if(late == PlayerOptions::Skip)
+            {
+                CHECK(achieved < nominal + tick, name + " skipping took " + to_string(achieved) + " of " + to_string(nominal));
+                CHECK(metrics.FramesShown + metrics.FramesSkipped == frames, name + " skipping lost frames");
+            }
+            else
+            {
+                CHECK(metrics.FramesShown == frames && metrics.FramesSkipped == 0, name + " skipped frames");
+                if(late == PlayerOptions::Shorten)
+                {
+                    // a step enters one frame, the first one at or after it is due
+                    uint64_t due = 0, steps = 0;
+                    for(auto &[index, frame] : animation->Frames())
+                    {
+                        steps = max(steps + 1, (due + tick - 1) / tick);
+                        due += static_cast<uint64_t>(frame->Duration()) * 10;
+                    }
+                    steps = max(steps + 1, (due + tick - 1) / tick);
+                    CHECK(achieved == steps * tick, name + " shortening took " + to_string(achieved)
+                                                        + ", expected " + to_string(steps * tick));
+                }
+                else
+                    CHECK(achieved >= nominal + metrics.TotalLateness && achieved < nominal + metrics.TotalLateness + tick,
+                          name + " delaying took " + to_string(achieved) + " of " + to_string(nominal)
+                              + " + " + to_string(metrics.TotalLateness) + " late");
+            }
+        }
+    }
+}
+
+int main()
+{
+    // large branches between frames, pathological on every frame
+    for(const char *preset : { "small", "large", "pathological" })
+    {
+        const string path = WriteTemporary(string("libacsfile_test_player_") + preset + ".acs",
+                                           GenerateCharacter(GeneratorPreset(preset)));
+        Character character;
+        if(!character.Load(path))
+        {
+            CHECK(false, string(preset) + ": load: " + character.GetLastError());
+            continue;
+        }
+        filesystem::remove(path);
+
+        vector<const Animation*> animations;
+        for(auto &[name, animation] : character.Animations())
+            animations.push_back(animation);
+
+        Determinism(preset, animations);
+        NoAllocations(preset, animations);
+        StopsGoIdle(preset, animations);
+    }
+
+    // the default preset has no branches, so every animation plays its
+    // frames in order
+    const string path = WriteTemporary("libacsfile_test_player_default.acs",
+                                       GenerateCharacter(GeneratorPreset("default")));
+    Character character;
+    if(character.Load(path))
+    {
+        vector<const Animation*> animations;
+        for(auto &[name, animation] : character.Animations())
+            animations.push_back(animation);
+        LatePolicies("default", animations);
+    }
+    else
+        CHECK(false, "default: load: " + character.GetLastError());
+    filesystem::remove(path);
+
+    return TestResult();
+}
@@ -0,0 +1,99 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Save and reload generated characters with each compression preset and
+// check that no image changes on the way.
+
+#include <string>
+#include <map>
+#include <vector>
+#include <filesystem>
+
+#include "acsfile.h"
+#include "acsgenerator.h"
+#include "acs_test.h"
+
+using namespace std;
+using namespace libacsfile;
+
+// A delta encoded image drawn alone must match its materialized pixels
+static bool BlitMatchesData(const Image *img, const vector<uint32_t> &palette)
+{
+    const int width = img->Width(), height = img->Height();
+    const uint32_t stride = img->Stride();
+    const vector<uint8_t> data = img->Data();
+    vector<uint32_t> target(static_cast<size_t>(width) * height, 0);
+    img->Blit(target.data(), width, height, width, 0, 0, palette.data());
+    for(int row = 0; row < height; ++row)
+        for(int col = 0; col < width; ++col)
+        {
+            // bitmaps are stored bottom-up
+            uint32_t argb = palette[data[static_cast<size_t>(height - 1 - row) * stride + col]];
+            if(target[static_cast<size_t>(row) * width + col] != (argb >> 24 ? argb : 0))
+                return false;
+        }
+    return true;
+}
+
+static void RoundTrip(const string &preset)
+{
+    const string source = WriteTemporary("libacsfile_test_" + preset + ".acs",
+                                         GenerateCharacter(GeneratorPreset(preset)));
+    const string saved = filesystem::path(source).replace_extension(".saved.acs").string();
+
+    Character original;
+    CHECK(original.Load(source), preset + ": load: " + original.GetLastError());
+    const map<uint16_t, Image*> images = original.Images();
+
+    for(SaveOptions::Compression compression : { SaveOptions::Fast, SaveOptions::Best })
+    {
+        const string name = preset + (compression == SaveOptions::Fast ? "/fast" : "/best");
+        SaveOptions options;
+        options.Preset = compression;
+        // keep one entry per image so the image lists line up
+        options.DeduplicateImages = false;
+        if(!original.Save(saved, options))
+        {
+            CHECK(false, name + ": save: " + original.GetLastError());
+            continue;
+        }
+
+        for(bool delta : { false, true })
+        {
+            LoadOptions loadOptions;
+            loadOptions.DeltaEncodeImages = delta;
+            Character reloaded;
+            if(!reloaded.Load(saved, loadOptions))
+            {
+                CHECK(false, name + ": reload: " + reloaded.GetLastError());
+                continue;
+            }
+
+            const map<uint16_t, Image*> again = reloaded.Images();
+            CHECK(again.size() == images.size(), name + ": image count");
+            const vector<uint32_t> palette = reloaded.ARGBPalette();
+            auto before = images.begin();
+            for(auto after = again.begin(); before != images.end() && after != again.end(); ++before, ++after)
+            {
+                const Image *img = after->second;
+                const string which = name + (delta ? "/delta" : "") + ": image " + to_string(before->first);
+                CHECK(img->Width() == before->second->Width() && img->Height() == before->second->Height(),
+                      which + " size");
+                CHECK(img->Data() == before->second->Data(), which + " data");
+                if(img->DeltaBase())
+                    CHECK(BlitMatchesData(img, palette), which + " delta blit");
+            }
+        }
+    }
+
+    filesystem::remove(source);
+    filesystem::remove(saved);
+}
+
+int main()
+{
+    for(const char *preset : { "small", "large", "pathological" })
+        RoundTrip(preset);
+
+    return TestResult();
+}
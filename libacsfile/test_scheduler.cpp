@@ -0,0 +1,160 @@
+// libacsfile - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// FrameScheduler against a model that keeps one deadline per client and
+// searches all of them, over random sequences of calls.
+
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include "acsscheduler.h"
+#include "acs_test.h"
+
+using namespace std;
+using namespace libacsfile;
+
+// Calls per sequence, enough for the stale entries to be compacted
+#define SCHEDULER_TEST_CALLS 20000
+
+struct Model {
+    uint64_t Coalesce = 0;
+    // deadline of every client, Never when not scheduled
+    map<FrameScheduler::Client, uint64_t> Deadlines;
+
+    uint64_t NextWakeup() const
+    {
+        uint64_t next = FrameScheduler::Never;
+        for(auto &[client, deadline] : Deadlines)
+            next = min(next, deadline);
+        return next;
+    }
+
+    // due clients with their deadlines, earliest first
+    vector<pair<uint64_t, FrameScheduler::Client>> TakeDue(uint64_t now)
+    {
+        const uint64_t limit = now > FrameScheduler::Never - Coalesce ? FrameScheduler::Never - 1 : now + Coalesce;
+        vector<pair<uint64_t, FrameScheduler::Client>> due;
+        for(auto &[client, deadline] : Deadlines)
+            if(deadline != FrameScheduler::Never && deadline <= limit)
+            {
+                due.push_back({ deadline, client });
+                deadline = FrameScheduler::Never;
+            }
+        sort(due.begin(), due.end());
+        return due;
+    }
+
+    size_t Scheduled() const
+    {
+        return count_if(Deadlines.begin(), Deadlines.end(),
+                        [](auto &entry) { return entry.second != FrameScheduler::Never; });
+    }
+};
+
+// reschedules is how many extra calls in 8 reschedule a client, which
+// piles up stale entries
+static void Sequence(uint64_t seed, uint32_t maxClients, uint64_t span, uint32_t reschedules = 0)
+{
+    const string name = "seed " + to_string(seed);
+    uint64_t random = seed;
+    FrameScheduler scheduler(NextRandom(random) % 8);
+    Model model;
+    model.Coalesce = scheduler.Coalesce();
+    uint64_t now = 0;
+    vector<FrameScheduler::Client> due;
+
+    for(int call = 0; call < SCHEDULER_TEST_CALLS; ++call)
+    {
+        const string at = name + " call " + to_string(call);
+        // any client handle, including removed ones
+        const FrameScheduler::Client client = static_cast<FrameScheduler::Client>(NextRandom(random) % (maxClients + 1));
+        const uint64_t op = NextRandom(random) % (8 + reschedules);
+        switch(op < 8 ? op : 4)
+        {
+        case 0:
+            if(model.Deadlines.size() < maxClients)
+            {
+                const FrameScheduler::Client added = scheduler.Add();
+                CHECK(!model.Deadlines.count(added), at + ": Add returned client " + to_string(added) + " in use");
+                model.Deadlines[added] = FrameScheduler::Never;
+            }
+            break;
+        case 1:
+            scheduler.Remove(client);
+            model.Deadlines.erase(client);
+            break;
+        case 2:
+            scheduler.Schedule(client, FrameScheduler::Never);
+            if(model.Deadlines.count(client))
+                model.Deadlines[client] = FrameScheduler::Never;
+            break;
+        case 3:
+        case 4:
+        {
+            // past, present and future deadlines, some near the end of time
+            uint64_t deadline = now - min(now, span / 4) + NextRandom(random) % span;
+            if(NextRandom(random) % 64 == 0)
+                deadline = FrameScheduler::Never - 1 - NextRandom(random) % 4;
+            scheduler.Schedule(client, deadline);
+            if(model.Deadlines.count(client))
+                model.Deadlines[client] = deadline;
+            break;
+        }
+        case 5:
+            CHECK(scheduler.NextWakeup() == model.NextWakeup(), at + ": NextWakeup");
+            break;
+        case 6:
+        {
+            now += NextRandom(random) % (span / 2);
+            if(NextRandom(random) % 256 == 0)
+                now = FrameScheduler::Never - 1;
+            due.clear();
+            const map<FrameScheduler::Client, uint64_t> before = model.Deadlines;
+            const size_t count = scheduler.TakeDue(now, due);
+            const vector<pair<uint64_t, FrameScheduler::Client>> expected = model.TakeDue(now);
+            CHECK(count == due.size(), at + ": TakeDue count");
+            // clients due at the same time may come in any order
+            vector<pair<uint64_t, FrameScheduler::Client>> taken;
+            for(FrameScheduler::Client c : due)
+                taken.push_back({ before.count(c) ? before.at(c) : FrameScheduler::Never, c });
+            CHECK(is_sorted(taken.begin(), taken.end(),
+                            [](auto &a, auto &b) { return a.first < b.first; }), at + ": TakeDue order");
+            sort(taken.begin(), taken.end());
+            CHECK(taken == expected, at + ": TakeDue returned " + to_string(taken.size())
+                                         + " clients, expected " + to_string(expected.size()));
+            if(now == FrameScheduler::Never - 1)
+                now = 0;
+            break;
+        }
+        case 7:
+            if(NextRandom(random) % 16 == 0)
+            {
+                scheduler.SetCoalesce(NextRandom(random) % 8);
+                model.Coalesce = scheduler.Coalesce();
+            }
+            break;
+        }
+
+        CHECK(scheduler.Clients() == model.Deadlines.size(), at + ": Clients");
+        CHECK(scheduler.Scheduled() == model.Scheduled(), at + ": Scheduled");
+        const uint64_t expected = model.Deadlines.count(client) ? model.Deadlines[client] : FrameScheduler::Never;
+        CHECK(scheduler.Deadline(client) == expected, at + ": Deadline of client " + to_string(client));
+        if(failures)
+            return;
+    }
+}
+
+int main()
+{
+    // few clients rescheduled often, many clients with spread deadlines
+    for(uint64_t seed = 1; seed <= 20; ++seed)
+        Sequence(seed, 4, 50);
+    for(uint64_t seed = 21; seed <= 30; ++seed)
+        Sequence(seed, 300, 5000);
+    for(uint64_t seed = 31; seed <= 40; ++seed)
+        Sequence(seed, 32, 1000, 64);
+
+    return TestResult();
+}
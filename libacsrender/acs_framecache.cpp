@@ -0,0 +1,220 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#include "acsframecache.h"
+#include "acstrace.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+using namespace libacsrender;
+using namespace std;
+
+namespace libacsrender {
+    class FrameCachePrivate {
+    private:
+        friend class FrameCache;
+        struct Key {
+            const libacsfile::Frame *Frame;
+            int Mouth;
+            bool operator==(const Key &o) const { return Frame == o.Frame && Mouth == o.Mouth; }
+        };
+        struct KeyHash {
+            size_t operator()(const Key &k) const
+            {
+                return hash<const void*>()(k.Frame) ^ (static_cast<size_t>(k.Mouth) * 0x9E3779B97F4A7C15ull);
+            }
+        };
+        struct Entry {
+            Key Id;
+            shared_ptr<vector<uint32_t>> Pixels;
+        };
+
+        FrameCachePrivate(const Compositor &compositor, size_t maxBytes)
+            :Renderer(compositor), MaxBytes(maxBytes) {}
+        FrameCache::Pixels Find(const Key &key, bool touch);
+        void SetLast(const Key &key, const FrameCache::Pixels &pixels);
+        FrameCache::Pixels Insert(const Key &key, bool prefetch);
+        void Evict();
+
+        const Compositor &Renderer;
+        size_t MaxBytes;
+        size_t FrameBytes() const { return Renderer.BufferSize(); }
+
+        mutable mutex Lock;
+        // most recently used first
+        list<Entry> Entries;
+        unordered_map<Key, list<Entry>::iterator, KeyHash> Index;
+        // evicted buffers nobody else holds, reused instead of allocating
+        vector<shared_ptr<vector<uint32_t>>> Spare;
+        // the frame without a mouth handed out or composited last, playing
+        // forward the next one is often a delta of it
+        const libacsfile::Frame *LastFrame = nullptr;
+        FrameCache::Pixels Last;
+        FrameCache::Counters Counters;
+    };
+}
+
+FrameCache::Pixels FrameCachePrivate::Find(const Key &key, bool touch)
+{
+    auto it = Index.find(key);
+    if(it == Index.end())
+        return nullptr;
+    if(touch)
+        Entries.splice(Entries.begin(), Entries, it->second);
+    return it->second->Pixels;
+}
+
+void FrameCachePrivate::SetLast(const Key &key, const FrameCache::Pixels &pixels)
+{
+    if(key.Mouth != FrameCache::NoMouth)
+        return;
+    LastFrame = key.Frame;
+    Last = pixels;
+}
+
+// Composites outside the lock so readers and other misses are not held
+// up, the first of two racing inserts wins
+FrameCache::Pixels FrameCachePrivate::Insert(const Key &key, bool prefetch)
+{
+    shared_ptr<vector<uint32_t>> pixels;
+    FrameCache::Pixels previous;
+    {
+        lock_guard<mutex> lock(Lock);
+        if(!Spare.empty())
+        {
+            pixels = move(Spare.back());
+            Spare.pop_back();
+        }
+        if(key.Mouth == FrameCache::NoMouth && Last && key.Frame->FollowsByDelta(LastFrame))
+            previous = Last;
+    }
+    if(!pixels)
+        pixels = make_shared<vector<uint32_t>>(FrameBytes() / sizeof(uint32_t));
+
+    {
+        ACS_TRACE_SCOPE("render", "FrameCache composite");
+        if(previous)
+            Renderer.CompositeDelta(key.Frame, previous->data(), pixels->data());
+        else if(key.Mouth == FrameCache::NoMouth)
+            Renderer.Composite(key.Frame, pixels->data());
+        else
+            Renderer.Composite(key.Frame, static_cast<libacsfile::Overlay::Type>(key.Mouth), pixels->data());
+    }
+
+    lock_guard<mutex> lock(Lock);
+    if(FrameCache::Pixels cached = Find(key, true))
+    {
+        Spare.push_back(move(pixels));
+        if(!prefetch)
+            SetLast(key, cached);
+        return cached;
+    }
+    if(prefetch)
+        ++Counters.Prefetches;
+    if(previous)
+        ++Counters.Deltas;
+    // a prefetched frame is not on screen yet, Last stays the shown one
+    if(!prefetch)
+        SetLast(key, pixels);
+    if(FrameBytes() > MaxBytes)
+        return pixels;
+
+    Entries.push_front({ key, pixels });
+    Index[key] = Entries.begin();
+    Counters.Bytes += FrameBytes();
+    ++Counters.Frames;
+    Evict();
+    return pixels;
+}
+
+void FrameCachePrivate::Evict()
+{
+    while(Counters.Bytes > MaxBytes && !Entries.empty())
+    {
+        Entry &last = Entries.back();
+        if(last.Pixels.use_count() == 1)
+            Spare.push_back(move(last.Pixels));
+        Index.erase(last.Id);
+        Entries.pop_back();
+        Counters.Bytes -= FrameBytes();
+        --Counters.Frames;
+        ++Counters.Evictions;
+    }
+    // keep only as many spares as could be refilled before the next eviction
+    if(Spare.size() > 4)
+        Spare.resize(4);
+}
+
+FrameCache::FrameCache(const Compositor &compositor, size_t maxBytes)
+    :p(new FrameCachePrivate(compositor, maxBytes)) {}
+
+FrameCache::~FrameCache()
+{
+    delete p;
+}
+
+FrameCache::Pixels FrameCache::Get(const libacsfile::Frame *frame, int mouth)
+{
+    FrameCachePrivate::Key key{ frame, mouth };
+    {
+        lock_guard<mutex> lock(p->Lock);
+        if(Pixels cached = p->Find(key, true))
+        {
+            ++p->Counters.Hits;
+            p->SetLast(key, cached);
+            return cached;
+        }
+        ++p->Counters.Misses;
+    }
+    return p->Insert(key, false);
+}
+
+void FrameCache::Prefetch(const libacsfile::Frame *frame, int mouth)
+{
+    FrameCachePrivate::Key key{ frame, mouth };
+    {
+        lock_guard<mutex> lock(p->Lock);
+        if(p->Index.find(key) != p->Index.end())
+            return;
+    }
+    p->Insert(key, true);
+}
+
+bool FrameCache::Contains(const libacsfile::Frame *frame, int mouth) const
+{
+    lock_guard<mutex> lock(p->Lock);
+    return p->Index.find({ frame, mouth }) != p->Index.end();
+}
+
+FrameCache::Counters FrameCache::Stats() const
+{
+    lock_guard<mutex> lock(p->Lock);
+    return p->Counters;
+}
+
+size_t FrameCache::MaxBytes() const
+{
+    lock_guard<mutex> lock(p->Lock);
+    return p->MaxBytes;
+}
+
+void FrameCache::SetMaxBytes(size_t maxBytes)
+{
+    lock_guard<mutex> lock(p->Lock);
+    p->MaxBytes = maxBytes;
+    p->Evict();
+}
+
+void FrameCache::Clear()
+{
+    lock_guard<mutex> lock(p->Lock);
+    p->Entries.clear();
+    p->Index.clear();
+    p->Spare.clear();
+    p->LastFrame = nullptr;
+    p->Last.reset();
+    p->Counters.Bytes = 0;
+    p->Counters.Frames = 0;
+}
@@ -0,0 +1,313 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#include "acsgif.h"
+#include "acsplayer.h"
+#include "acstrace.h"
+
+#include <map>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+
+#define GIF_MAX_CODE        4095
+#define GIF_HASH_SIZE       8192
+
+using namespace libacsrender;
+using namespace std;
+
+vector<uint16_t> libacsrender::PlaybackSequence(const libacsfile::Animation &animation, uint64_t seed,
+                                                unsigned int maxFrames)
+{
+    libacsfile::AnimationPlayer player(seed);
+    player.Play(&animation);
+    vector<uint16_t> sequence;
+    while(sequence.size() < maxFrames)
+    {
+        const libacsfile::PlayerStep &step = player.Next();
+        if(!step.FrameEntered || step.Completed)
+            break;
+        sequence.push_back(step.FrameIndex);
+    }
+    return sequence;
+}
+
+// Codes go out least significant bit first, in sub-blocks of up to
+// 255 bytes
+class GifBits
+{
+public:
+    explicit GifBits(vector<uint8_t> &out) : out(out) {}
+
+    void Put(uint32_t code, int size)
+    {
+        bits |= code << used;
+        used += size;
+        while(used >= 8)
+        {
+            PutByte(static_cast<uint8_t>(bits));
+            bits >>= 8;
+            used -= 8;
+        }
+    }
+
+    void Finish()
+    {
+        if(used > 0)
+            PutByte(static_cast<uint8_t>(bits));
+        if(blockLength > 0)
+            out[blockStart] = static_cast<uint8_t>(blockLength);
+        out.push_back(0);
+    }
+
+private:
+    void PutByte(uint8_t byte)
+    {
+        if(blockLength == 0)
+        {
+            blockStart = out.size();
+            out.push_back(0);
+        }
+        out.push_back(byte);
+        if(++blockLength == 255)
+        {
+            out[blockStart] = 255;
+            blockLength = 0;
+        }
+    }
+
+    vector<uint8_t> &out;
+    uint32_t bits = 0;
+    int used = 0;
+    size_t blockStart = 0;
+    int blockLength = 0;
+};
+
+// GIF LZW over 8-bit indexes. The dictionary is an open addressed table
+// keyed by (prefix code, next index), cleared whenever it fills up.
+static void EncodeLZW(const uint8_t *pixels, size_t count, vector<uint8_t> &out)
+{
+    const uint32_t clearCode = 256;
+    out.push_back(8);
+    GifBits bits(out);
+
+    int32_t keys[GIF_HASH_SIZE];
+    uint16_t codes[GIF_HASH_SIZE];
+    auto reset = [&]() { fill_n(keys, GIF_HASH_SIZE, -1); };
+    reset();
+
+    int codeSize = 9;
+    uint32_t maxCode = clearCode + 1;
+    bits.Put(clearCode, codeSize);
+
+    uint32_t current = pixels[0];
+    for(size_t i = 1; i < count; ++i)
+    {
+        const uint8_t next = pixels[i];
+        const int32_t key = static_cast<int32_t>((current << 8) | next);
+        uint32_t slot = (static_cast<uint32_t>(key) * 2654435761u) >> (32 - 13);
+        while(keys[slot] != -1 && keys[slot] != key)
+            slot = (slot + 1) & (GIF_HASH_SIZE - 1);
+        if(keys[slot] == key)
+        {
+            current = codes[slot];
+            continue;
+        }
+
+        bits.Put(current, codeSize);
+        keys[slot] = key;
+        codes[slot] = static_cast<uint16_t>(++maxCode);
+        if(maxCode >= (1u << codeSize))
+            ++codeSize;
+        if(maxCode == GIF_MAX_CODE)
+        {
+            bits.Put(clearCode, codeSize);
+            reset();
+            codeSize = 9;
+            maxCode = clearCode + 1;
+        }
+        current = next;
+    }
+    bits.Put(current, codeSize);
+    // the decoder adds an entry for the last code as well, which can
+    // widen the end code
+    if(++maxCode >= (1u << codeSize))
+        ++codeSize;
+    bits.Put(clearCode + 1, codeSize);
+    bits.Finish();
+}
+
+namespace {
+    // Top-down palette indexes of one image
+    struct IndexedImage {
+        int Width = 0;
+        int Height = 0;
+        vector<uint8_t> Pixels;
+    };
+
+    struct GifFrame {
+        const libacsfile::Frame *Frame = nullptr;
+        uint32_t Delay = 0;
+        vector<uint8_t> Encoded;
+    };
+}
+
+vector<uint8_t> libacsrender::EncodeGIF(const libacsfile::Character &character, const libacsfile::Animation &animation,
+                                        const GifOptions &options)
+{
+    ACS_TRACE_SCOPE_DETAIL("render", "EncodeGIF", animation.Name());
+    const int width = character.Width(), height = character.Height();
+    const uint8_t transparent = character.TransparentIndex();
+    const map<uint16_t, libacsfile::Frame*> frames = animation.Frames();
+
+    // a frame shown again right away only lengthens the previous delay
+    vector<GifFrame> shown;
+    for(uint16_t index : PlaybackSequence(animation, options.Seed, options.MaxFrames))
+    {
+        const libacsfile::Frame *frame = frames.at(index);
+        if(!shown.empty() && shown.back().Frame == frame)
+            shown.back().Delay += frame->Duration();
+        else
+            shown.push_back({ frame, frame->Duration(), {} });
+    }
+
+    // every image is flipped to top-down indexes once, up front
+    map<const libacsfile::Image*, IndexedImage> images;
+    for(const GifFrame &gif : shown)
+        for(const libacsfile::FrameImage *fimg : gif.Frame->Images())
+        {
+            const libacsfile::Image *img = fimg->GetImage();
+            if(!img || images.count(img))
+                continue;
+            IndexedImage &indexed = images[img];
+            indexed.Width = img->Width();
+            indexed.Height = img->Height();
+            const vector<uint8_t> dib = img->Data();
+            const size_t stride = img->Stride();
+            indexed.Pixels.assign(static_cast<size_t>(indexed.Width) * indexed.Height, transparent);
+            for(int row = 0; row < indexed.Height; ++row)
+            {
+                const size_t src = static_cast<size_t>(indexed.Height - 1 - row) * stride;
+                if(src + indexed.Width <= dib.size())
+                    copy_n(dib.data() + src, indexed.Width, indexed.Pixels.data() + static_cast<size_t>(row) * indexed.Width);
+            }
+        }
+
+    unsigned int threads = options.Threads;
+    if(threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    threads = min<unsigned int>(threads, max<size_t>(1, shown.size()));
+
+    atomic<size_t> next{0};
+    auto worker = [&]() {
+        vector<uint8_t> canvas(static_cast<size_t>(width) * height);
+        vector<uint8_t> cropped;
+        for(size_t i = next++; i < shown.size(); i = next++)
+        {
+            ACS_TRACE_SCOPE("render", "GIF frame");
+            GifFrame &gif = shown[i];
+            fill(canvas.begin(), canvas.end(), transparent);
+            auto fimgs = gif.Frame->Images();
+            // the first listed image is on top
+            for(size_t k = fimgs.size(); k-- > 0;)
+            {
+                auto it = images.find(fimgs[k]->GetImage());
+                if(it == images.end())
+                    continue;
+                const IndexedImage &img = it->second;
+                const int x = fimgs[k]->OffsetX(), y = fimgs[k]->OffsetY();
+                const int rowBegin = max(0, -y), rowEnd = min(img.Height, height - y);
+                const int colBegin = max(0, -x), colEnd = min(img.Width, width - x);
+                for(int row = rowBegin; row < rowEnd; ++row)
+                {
+                    const uint8_t *src = img.Pixels.data() + static_cast<size_t>(row) * img.Width;
+                    uint8_t *dst = canvas.data() + static_cast<size_t>(y + row) * width + x;
+                    for(int col = colBegin; col < colEnd; ++col)
+                        if(src[col] != transparent)
+                            dst[col] = src[col];
+                }
+            }
+
+            // only the box around the visible pixels is stored
+            int left = width, top = height, right = 0, bottom = 0;
+            for(int row = 0; row < height; ++row)
+            {
+                const uint8_t *line = canvas.data() + static_cast<size_t>(row) * width;
+                int l = 0, r = width;
+                while(l < width && line[l] == transparent)
+                    ++l;
+                if(l == width)
+                    continue;
+                while(line[r - 1] == transparent)
+                    --r;
+                left = min(left, l);
+                right = max(right, r);
+                top = min(top, row);
+                bottom = row + 1;
+            }
+            if(bottom == 0)
+                left = top = 0, right = bottom = 1;
+            cropped.clear();
+            for(int row = top; row < bottom; ++row)
+                cropped.insert(cropped.end(), canvas.data() + static_cast<size_t>(row) * width + left,
+                               canvas.data() + static_cast<size_t>(row) * width + right);
+
+            // graphic control: restore to background, transparent index
+            vector<uint8_t> &out = gif.Encoded;
+            const uint16_t delay = static_cast<uint16_t>(min<uint32_t>(gif.Delay, 0xFFFF));
+            out = { 0x21, 0xF9, 4, (2 << 2) | 1, static_cast<uint8_t>(delay), static_cast<uint8_t>(delay >> 8),
+                    transparent, 0 };
+            // image descriptor without a local color table
+            out.insert(out.end(), { 0x2C,
+                                    static_cast<uint8_t>(left), static_cast<uint8_t>(left >> 8),
+                                    static_cast<uint8_t>(top), static_cast<uint8_t>(top >> 8),
+                                    static_cast<uint8_t>(right - left), static_cast<uint8_t>((right - left) >> 8),
+                                    static_cast<uint8_t>(bottom - top), static_cast<uint8_t>((bottom - top) >> 8),
+                                    0 });
+            EncodeLZW(cropped.data(), cropped.size(), out);
+        }
+    };
+
+    vector<thread> pool;
+    for(unsigned int i = 1; i < threads; ++i)
+        pool.emplace_back(worker);
+    worker();
+    for(auto &t : pool)
+        t.join();
+
+    vector<uint8_t> out = { 'G', 'I', 'F', '8', '9', 'a',
+                            static_cast<uint8_t>(width), static_cast<uint8_t>(width >> 8),
+                            static_cast<uint8_t>(height), static_cast<uint8_t>(height >> 8),
+                            0xF7, transparent, 0 };
+    // the global color table always has 256 entries, unused ones are black
+    const vector<RGBQUAD> palette = character.ColorPalette();
+    for(size_t i = 0; i < 256; ++i)
+    {
+        RGBQUAD color = i < palette.size() ? palette[i] : RGBQUAD{};
+        out.insert(out.end(), { color.rgbRed, color.rgbGreen, color.rgbBlue });
+    }
+    if(options.Loop)
+    {
+        const char netscape[] = "NETSCAPE2.0";
+        out.insert(out.end(), { 0x21, 0xFF, 11 });
+        out.insert(out.end(), netscape, netscape + 11);
+        out.insert(out.end(), { 3, 1, 0, 0, 0 });
+    }
+    for(const GifFrame &gif : shown)
+        out.insert(out.end(), gif.Encoded.begin(), gif.Encoded.end());
+    out.push_back(0x3B);
+    return out;
+}
+
+bool libacsrender::WriteGIF(const libacsfile::Character &character, const libacsfile::Animation &animation,
+                            const std::filesystem::path &file, const GifOptions &options)
+{
+    const vector<uint8_t> gif = EncodeGIF(character, animation, options);
+    ofstream ofs(file, ios::out | ios::binary | ios::trunc);
+    if(!ofs)
+        return false;
+
+    ofs.write(reinterpret_cast<const char*>(gif.data()), gif.size());
+    return static_cast<bool>(ofs);
+}
@@ -0,0 +1,223 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#include "acsprefetcher.h"
+#include "acstrace.h"
+
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+using namespace libacsrender;
+using namespace std;
+
+// Frames without images passed through before giving up on a chain of them
+#define MAX_EMPTY_FRAMES 64
+
+namespace libacsrender {
+    class FramePrefetcherPrivate {
+    private:
+        friend class FramePrefetcher;
+        struct Candidate {
+            uint16_t Index;
+            double Probability;
+        };
+
+        FramePrefetcherPrivate(FrameCache &cache, const PrefetchOptions &options)
+            :Cache(cache), Options(options) {}
+        void Run();
+        void Successors(const map<uint16_t, libacsfile::Frame*> &frames, uint16_t index,
+                        double probability, bool stopping, vector<Candidate> &out) const;
+        void Expand(const map<uint16_t, libacsfile::Frame*> &frames, uint16_t start, bool stopping,
+                    const PrefetchOptions &options, vector<Candidate> &out) const;
+
+        FrameCache &Cache;
+
+        mutex Lock;
+        condition_variable Wake;
+        PrefetchOptions Options;
+        const libacsfile::Animation *Animation = nullptr;
+        uint16_t Frame = 0;
+        bool Stopping = false;
+        bool Pending = false;
+        bool Quit = false;
+        // bumped by every Schedule and Cancel, stale work stops between frames
+        uint64_t Generation = 0;
+
+        thread Worker;
+    };
+}
+
+// Where playback goes after the frame at index, with the probability
+// of getting there from the shown frame
+void FramePrefetcherPrivate::Successors(const map<uint16_t, libacsfile::Frame*> &frames, uint16_t index,
+                                        double probability, bool stopping, vector<Candidate> &out) const
+{
+    auto it = frames.find(index);
+    if(it == frames.end() || !it->second)
+        return;
+    const libacsfile::Frame *frame = it->second;
+
+    if(stopping && frame->ExitFrame() >= 0)
+    {
+        out.push_back({ static_cast<uint16_t>(frame->ExitFrame()), probability });
+        return;
+    }
+
+    double remaining = 1.0;
+    for(const libacsfile::Branch *branch : frame->Branches())
+    {
+        double chance = min(remaining, branch->Probability() / 100.0);
+        remaining -= chance;
+        if(chance > 0)
+            out.push_back({ branch->FrameID(), probability * chance });
+    }
+    if(remaining > 0 && index + 1u < frames.size())
+        out.push_back({ static_cast<uint16_t>(index + 1), probability * remaining });
+}
+
+// Breadth first from the shown frame, keeping the best probability each
+// frame is reached with. The result is ordered most likely first.
+void FramePrefetcherPrivate::Expand(const map<uint16_t, libacsfile::Frame*> &frames, uint16_t start,
+                                    bool stopping, const PrefetchOptions &options,
+                                    vector<Candidate> &out) const
+{
+    const double threshold = options.MinProbability / 100.0;
+    vector<Candidate> level, next;
+    Successors(frames, start, 1.0, stopping, level);
+
+    for(unsigned int depth = 0; depth < options.Depth && !level.empty(); ++depth)
+    {
+        next.clear();
+        for(const Candidate &candidate : level)
+        {
+            if(candidate.Probability < threshold)
+                continue;
+
+            // playback skips frames without images straight to their successor
+            Candidate shown = candidate;
+            for(int skipped = 0; skipped < MAX_EMPTY_FRAMES; ++skipped)
+            {
+                auto it = frames.find(shown.Index);
+                if(it == frames.end() || !it->second || !it->second->Images().empty())
+                    break;
+                vector<Candidate> through;
+                Successors(frames, shown.Index, shown.Probability, stopping, through);
+                if(through.empty())
+                    break;
+                shown = through.front();
+            }
+            auto it = frames.find(shown.Index);
+            if(it == frames.end() || !it->second || it->second->Images().empty())
+                continue;
+
+            auto seen = find_if(out.begin(), out.end(),
+                                [&](const Candidate &c) { return c.Index == shown.Index; });
+            if(seen == out.end())
+                out.push_back(shown);
+            else if(seen->Probability < shown.Probability)
+                seen->Probability = shown.Probability;
+            else
+                continue;
+            Successors(frames, shown.Index, shown.Probability, stopping, next);
+        }
+        swap(level, next);
+    }
+
+    stable_sort(out.begin(), out.end(),
+                [](const Candidate &a, const Candidate &b) { return a.Probability > b.Probability; });
+}
+
+void FramePrefetcherPrivate::Run()
+{
+    vector<Candidate> candidates;
+    for(;;)
+    {
+        const libacsfile::Animation *animation;
+        uint16_t start;
+        bool stopping;
+        uint64_t generation;
+        PrefetchOptions options;
+        {
+            unique_lock<mutex> lock(Lock);
+            Wake.wait(lock, [this]() { return Pending || Quit; });
+            if(Quit)
+                return;
+            Pending = false;
+            animation = Animation;
+            start = Frame;
+            stopping = Stopping;
+            generation = Generation;
+            options = Options;
+        }
+
+        ACS_TRACE_SCOPE_DETAIL("render", "Prefetch", animation->Name());
+        const map<uint16_t, libacsfile::Frame*> frames = animation->Frames();
+        candidates.clear();
+        Expand(frames, start, stopping, options, candidates);
+
+        for(const Candidate &candidate : candidates)
+        {
+            {
+                lock_guard<mutex> lock(Lock);
+                if(Generation != generation || Quit)
+                    break;
+            }
+            Cache.Prefetch(frames.at(candidate.Index));
+        }
+    }
+}
+
+FramePrefetcher::FramePrefetcher(FrameCache &cache, const PrefetchOptions &options)
+    :p(new FramePrefetcherPrivate(cache, options))
+{
+    p->Worker = thread(&FramePrefetcherPrivate::Run, p);
+}
+
+FramePrefetcher::~FramePrefetcher()
+{
+    {
+        lock_guard<mutex> lock(p->Lock);
+        p->Quit = true;
+    }
+    p->Wake.notify_one();
+    p->Worker.join();
+    delete p;
+}
+
+void FramePrefetcher::Schedule(const libacsfile::Animation *animation, uint16_t frame, bool stopping)
+{
+    if(!animation)
+        return;
+    {
+        lock_guard<mutex> lock(p->Lock);
+        p->Animation = animation;
+        p->Frame = frame;
+        p->Stopping = stopping;
+        p->Pending = true;
+        ++p->Generation;
+    }
+    p->Wake.notify_one();
+}
+
+void FramePrefetcher::Cancel()
+{
+    lock_guard<mutex> lock(p->Lock);
+    p->Pending = false;
+    ++p->Generation;
+}
+
+PrefetchOptions FramePrefetcher::Options() const
+{
+    lock_guard<mutex> lock(p->Lock);
+    return p->Options;
+}
+
+void FramePrefetcher::SetOptions(const PrefetchOptions &options)
+{
+    lock_guard<mutex> lock(p->Lock);
+    p->Options = options;
+}
@@ -0,0 +1,341 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Y4M and WAV streaming. Both streams advance together one output frame
+// at a time: the frame showing at that instant is composited and
+// converted only when it changes, and the sound samples falling inside
+// the frame interval are mixed into a block that is written right away.
+
+#include "acsvideo.h"
+#include "acsgif.h"
+#include "acsrender.h"
+#include "acstrace.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#define VIDEO_CONVERT_BLOCK     16
+#define VIDEO_DEFAULT_RATE      22050
+
+using namespace libacsrender;
+using namespace std;
+
+namespace {
+    // One frame sound placed on the output sample clock
+    struct SoundEvent {
+        const uint8_t *Data = nullptr;
+        uint32_t Frames = 0;        // source sample frames
+        uint32_t Rate = 0;
+        uint16_t Channels = 0;
+        uint16_t Bits = 0;
+        uint64_t Start = 0;         // output sample frames
+        uint64_t End = 0;
+    };
+}
+
+// BT.601 studio range with 8 fractional bits, chroma takes the sum of
+// a 2x2 block and drops two more
+static inline uint8_t Luma(int r, int g, int b)
+{
+    return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+// Two rows of RGBA into their luma rows and one chroma row. Width is a
+// multiple of Block, which gives the inner loops the fixed trip count
+// the compiler vectorizes, as with the compositing kernels. The alpha is
+// 0 or 255, so its top bit picks the pixel or the background without a
+// branch.
+template<int Block>
+static void ConvertRows(const uint8_t *top, const uint8_t *bottom, int width, const int background[3],
+                        uint8_t *yTop, uint8_t *yBottom, uint8_t *u, uint8_t *v)
+{
+    for(int col = 0; col < width; col += Block)
+    {
+        int r[2][Block], g[2][Block], b[2][Block];
+        for(int i = 0; i < Block; ++i)
+        {
+            const uint8_t *p0 = top + (col + i) * 4, *p1 = bottom + (col + i) * 4;
+            const int m0 = -(p0[3] >> 7), m1 = -(p1[3] >> 7);
+            r[0][i] = (p0[0] & m0) | (background[0] & ~m0);
+            g[0][i] = (p0[1] & m0) | (background[1] & ~m0);
+            b[0][i] = (p0[2] & m0) | (background[2] & ~m0);
+            r[1][i] = (p1[0] & m1) | (background[0] & ~m1);
+            g[1][i] = (p1[1] & m1) | (background[1] & ~m1);
+            b[1][i] = (p1[2] & m1) | (background[2] & ~m1);
+        }
+        for(int i = 0; i < Block; ++i)
+        {
+            yTop[col + i] = Luma(r[0][i], g[0][i], b[0][i]);
+            yBottom[col + i] = Luma(r[1][i], g[1][i], b[1][i]);
+        }
+        for(int i = 0; i < Block / 2; ++i)
+        {
+            const int rs = r[0][2 * i] + r[0][2 * i + 1] + r[1][2 * i] + r[1][2 * i + 1];
+            const int gs = g[0][2 * i] + g[0][2 * i + 1] + g[1][2 * i] + g[1][2 * i + 1];
+            const int bs = b[0][2 * i] + b[0][2 * i + 1] + b[1][2 * i] + b[1][2 * i + 1];
+            u[col / 2 + i] = static_cast<uint8_t>(((-38 * rs - 74 * gs + 112 * bs + 512) >> 10) + 128);
+            v[col / 2 + i] = static_cast<uint8_t>(((112 * rs - 94 * gs - 18 * bs + 512) >> 10) + 128);
+        }
+    }
+}
+
+// The RGBA frame has even dimensions, odd ones were padded by repeating
+// the last row and column
+static void ConvertFrame(const uint8_t *rgba, int width, int height, const int background[3],
+                         uint8_t *y, uint8_t *u, uint8_t *v)
+{
+    const int blocked = width - width % VIDEO_CONVERT_BLOCK;
+    const size_t pitch = static_cast<size_t>(width) * 4;
+    for(int row = 0; row < height; row += 2)
+    {
+        const uint8_t *top = rgba + row * pitch;
+        uint8_t *yTop = y + static_cast<size_t>(row) * width;
+        uint8_t *uRow = u + static_cast<size_t>(row / 2) * (width / 2);
+        uint8_t *vRow = v + static_cast<size_t>(row / 2) * (width / 2);
+        ConvertRows<VIDEO_CONVERT_BLOCK>(top, top + pitch, blocked, background,
+                                         yTop, yTop + width, uRow, vRow);
+        ConvertRows<2>(top + blocked * 4, top + pitch + blocked * 4, width - blocked, background,
+                       yTop + blocked, yTop + width + blocked, uRow + blocked / 2, vRow + blocked / 2);
+    }
+}
+
+static inline int32_t SourceSample(const SoundEvent &sound, uint32_t frame, uint16_t channel)
+{
+    const size_t index = static_cast<size_t>(frame) * sound.Channels + channel;
+    if(sound.Bits == 16)
+        return static_cast<int16_t>(sound.Data[index * 2] | (sound.Data[index * 2 + 1] << 8));
+    return (static_cast<int32_t>(sound.Data[index]) - 128) << 8;
+}
+
+// Adds the part of sound inside [from, to) to mix, resampled linearly.
+// Mono sounds go to both channels of a stereo mix.
+static void MixSound(const SoundEvent &sound, uint64_t from, uint64_t to, uint32_t rate, uint16_t channels,
+                     int32_t *mix)
+{
+    const uint64_t begin = max(from, sound.Start), end = min(to, sound.End);
+    for(uint64_t sample = begin; sample < end; ++sample)
+    {
+        const uint64_t position = (sample - sound.Start) * sound.Rate;
+        const uint32_t frame = static_cast<uint32_t>(position / rate);
+        if(frame >= sound.Frames)
+            break;
+        const int64_t fraction = static_cast<int64_t>(position % rate);
+        const uint32_t next = min(frame + 1, sound.Frames - 1);
+        int32_t *out = mix + (sample - from) * channels;
+        for(uint16_t ch = 0; ch < channels; ++ch)
+        {
+            const uint16_t source = min<uint16_t>(ch, sound.Channels - 1);
+            const int32_t a = SourceSample(sound, frame, source), b = SourceSample(sound, next, source);
+            out[ch] += a + static_cast<int32_t>((b - a) * fraction / rate);
+        }
+    }
+}
+
+static void Put16(string &out, uint16_t v)
+{
+    out.push_back(static_cast<char>(v));
+    out.push_back(static_cast<char>(v >> 8));
+}
+
+static void Put32(string &out, uint32_t v)
+{
+    Put16(out, static_cast<uint16_t>(v));
+    Put16(out, static_cast<uint16_t>(v >> 16));
+}
+
+bool libacsrender::EncodeVideo(const libacsfile::Character &character, const libacsfile::Animation &animation,
+                               ostream *y4m, ostream *wav, const VideoOptions &options, VideoStats *stats)
+{
+    ACS_TRACE_SCOPE("export", "EncodeVideo");
+    const unsigned int fps = max(1u, options.FrameRate);
+    const vector<uint16_t> sequence = PlaybackSequence(animation, options.Seed, options.MaxFrames);
+    if(sequence.empty())
+        return false;
+
+    // when each shown frame starts, durations are in hundredths
+    const map<uint16_t, libacsfile::Frame*> frames = animation.Frames();
+    vector<uint64_t> starts(sequence.size() + 1, 0);
+    for(size_t i = 0; i < sequence.size(); ++i)
+        starts[i + 1] = starts[i] + static_cast<uint64_t>(frames.at(sequence[i])->Duration()) * 10;
+
+    vector<SoundEvent> sounds;
+    uint32_t rate = options.SampleRate;
+    uint16_t channels = 1;
+    if(wav)
+    {
+        uint32_t highest = 0;
+        for(size_t i = 0; i < sequence.size(); ++i)
+        {
+            const libacsfile::Sound *sound = frames.at(sequence[i])->Sound();
+            if(!sound)
+                continue;
+            const libacsfile::WaveFormat &format = sound->Format();
+            const libacsfile::DataView pcm = sound->PCM();
+            if(!pcm.Data || format.FormatTag != libacsfile::Sound::FormatPCM || format.SampleRate == 0
+                || (format.BitsPerSample != 8 && format.BitsPerSample != 16)
+                || (format.Channels != 1 && format.Channels != 2))
+                continue;
+
+            SoundEvent event;
+            event.Data = pcm.Data;
+            event.Rate = format.SampleRate;
+            event.Channels = format.Channels;
+            event.Bits = format.BitsPerSample;
+            event.Frames = static_cast<uint32_t>(pcm.Size / (format.Channels * format.BitsPerSample / 8));
+            if(event.Frames == 0)
+                continue;
+            event.Start = starts[i];    // milliseconds until the rate is known
+            sounds.push_back(event);
+            highest = max(highest, format.SampleRate);
+            channels = max(channels, format.Channels);
+        }
+        if(rate == 0)
+            rate = highest ? highest : VIDEO_DEFAULT_RATE;
+        for(SoundEvent &event : sounds)
+        {
+            event.Start = event.Start * rate / 1000;
+            event.End = event.Start + (static_cast<uint64_t>(event.Frames) * rate + event.Rate - 1) / event.Rate;
+        }
+    }
+    if(rate == 0)
+        rate = VIDEO_DEFAULT_RATE;
+
+    // output frame n shows at n / fps seconds and covers the samples up
+    // to the next one, computed from n each time so nothing drifts
+    auto sampleAt = [&](uint64_t n) { return n * rate / fps; };
+    uint64_t count = max<uint64_t>(1, (starts.back() * fps + 999) / 1000);
+    for(const SoundEvent &event : sounds)
+        while(sampleAt(count) < event.End)
+            ++count;
+
+    const int width = character.Width(), height = character.Height();
+    const int paddedWidth = (width + 1) & ~1, paddedHeight = (height + 1) & ~1;
+    const int background[3] = { static_cast<int>((options.Background >> 16) & 0xFF),
+                                static_cast<int>((options.Background >> 8) & 0xFF),
+                                static_cast<int>(options.Background & 0xFF) };
+    Compositor compositor(character, Compositor::RGBA8888);
+    vector<uint32_t> rgba(static_cast<size_t>(paddedWidth) * paddedHeight);
+    vector<uint8_t> luma(static_cast<size_t>(paddedWidth) * paddedHeight);
+    vector<uint8_t> chroma(static_cast<size_t>(paddedWidth / 2) * (paddedHeight / 2) * 2);
+
+    if(y4m)
+        *y4m << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C420jpeg"
+             << " XCOLORRANGE=LIMITED\n";
+    if(wav)
+    {
+        const uint64_t dataBytes = min<uint64_t>(sampleAt(count) * channels * 2, 0xFFFFFFFFull - 36);
+        string header = "RIFF";
+        Put32(header, static_cast<uint32_t>(36 + dataBytes));
+        header += "WAVEfmt ";
+        Put32(header, 16);
+        Put16(header, libacsfile::Sound::FormatPCM);
+        Put16(header, channels);
+        Put32(header, rate);
+        Put32(header, rate * channels * 2);
+        Put16(header, static_cast<uint16_t>(channels * 2));
+        Put16(header, 16);
+        header += "data";
+        Put32(header, static_cast<uint32_t>(dataBytes));
+        wav->write(header.data(), header.size());
+    }
+
+    vector<int32_t> mix;
+    string samples;
+    size_t shown = 0, converted = sequence.size();
+    size_t nextSound = 0;
+    vector<const SoundEvent*> playing;
+    uint32_t convertedFrames = 0;
+    for(uint64_t n = 0; n < count; ++n)
+    {
+        if(y4m)
+        {
+            // the last frame started at or before this instant, frames
+            // shorter than an output frame may never show
+            while(shown + 1 < sequence.size() && starts[shown + 1] * fps <= n * 1000)
+                ++shown;
+            if(shown != converted)
+            {
+                ACS_TRACE_SCOPE("export", "Video frame");
+                compositor.Composite(frames.at(sequence[shown]), rgba.data(), paddedWidth);
+                if(paddedWidth != width)
+                    for(int row = 0; row < height; ++row)
+                        rgba[static_cast<size_t>(row) * paddedWidth + width] =
+                            rgba[static_cast<size_t>(row) * paddedWidth + width - 1];
+                if(paddedHeight != height)
+                    copy_n(rgba.begin() + static_cast<size_t>(height - 1) * paddedWidth, paddedWidth,
+                           rgba.begin() + static_cast<size_t>(height) * paddedWidth);
+                ConvertFrame(reinterpret_cast<const uint8_t*>(rgba.data()), paddedWidth, paddedHeight, background,
+                             luma.data(), chroma.data(), chroma.data() + chroma.size() / 2);
+                converted = shown;
+                ++convertedFrames;
+            }
+
+            y4m->write("FRAME\n", 6);
+            if(paddedWidth == width)
+                y4m->write(reinterpret_cast<const char*>(luma.data()), static_cast<streamsize>(width) * height);
+            else
+                for(int row = 0; row < height; ++row)
+                    y4m->write(reinterpret_cast<const char*>(luma.data()) + static_cast<size_t>(row) * paddedWidth,
+                               width);
+            y4m->write(reinterpret_cast<const char*>(chroma.data()), chroma.size());
+            if(!*y4m)
+                return false;
+        }
+
+        if(wav)
+        {
+            const uint64_t from = sampleAt(n), to = sampleAt(n + 1);
+            mix.assign((to - from) * channels, 0);
+            while(nextSound < sounds.size() && sounds[nextSound].Start < to)
+                playing.push_back(&sounds[nextSound++]);
+            for(const SoundEvent *sound : playing)
+                MixSound(*sound, from, to, rate, channels, mix.data());
+            playing.erase(remove_if(playing.begin(), playing.end(),
+                                    [to](const SoundEvent *sound) { return sound->End <= to; }),
+                          playing.end());
+
+            samples.clear();
+            for(int32_t sample : mix)
+                Put16(samples, static_cast<uint16_t>(static_cast<int16_t>(clamp(sample, -32768, 32767))));
+            wav->write(samples.data(), samples.size());
+            if(!*wav)
+                return false;
+        }
+    }
+
+    if(stats)
+    {
+        stats->VideoFrames = static_cast<uint32_t>(count);
+        stats->Converted = convertedFrames;
+        stats->Sounds = static_cast<uint32_t>(sounds.size());
+        stats->Milliseconds = count * 1000 / fps;
+        stats->SampleRate = wav ? rate : 0;
+        stats->Channels = wav ? channels : 0;
+    }
+    return true;
+}
+
+bool libacsrender::WriteVideo(const libacsfile::Character &character, const libacsfile::Animation &animation,
+                              const std::filesystem::path &y4m, const std::filesystem::path &wav,
+                              const VideoOptions &options, VideoStats *stats)
+{
+    ofstream video, audio;
+    if(!y4m.empty())
+    {
+        video.open(y4m, ios::out | ios::binary | ios::trunc);
+        if(!video)
+            return false;
+    }
+    if(!wav.empty())
+    {
+        audio.open(wav, ios::out | ios::binary | ios::trunc);
+        if(!audio)
+            return false;
+    }
+
+    return EncodeVideo(character, animation, y4m.empty() ? nullptr : &video, wav.empty() ? nullptr : &audio,
+                       options, stats);
+}
@@ -0,0 +1,174 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Renders character animations to files without Qt.
+//   acsexport [--format=gif|y4m] [--output=dir] [--animation=name] [--seed=N]
+//             [--max-frames=N] [--no-loop] [--fps=N] [--background=RRGGBB]
+//             [--sample-rate=N] [--jobs=N] file.acs
+// Writes <output>/<animation>.gif, or <animation>.y4m with the mixed
+// sounds in <animation>.wav, for the named animation or every one.
+// Animations are spread over the workers, branch choices are seeded so
+// the same options always give the same files.
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+#include "acsfile.h"
+#include "acsgif.h"
+#include "acsvideo.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Animation names become file names
+static string FileName(const string &name)
+{
+    string out = name;
+    for(char &ch : out)
+        if(!isalnum(static_cast<unsigned char>(ch)) && ch != '-' && ch != '_')
+            ch = '_';
+    return out.empty() ? "_" : out;
+}
+
+int main(int argc, char **argv)
+{
+    fs::path output = ".";
+    string only, input;
+    unsigned int jobs = 0;
+    bool video = false;
+    libacsrender::GifOptions gif;
+    libacsrender::VideoOptions y4m;
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool ok = true;
+        try
+        {
+            if(arg == "--format=gif" || arg == "--format=y4m")
+                video = arg == "--format=y4m";
+            else if(arg.rfind("--output=", 0) == 0)
+                output = arg.substr(9);
+            else if(arg.rfind("--animation=", 0) == 0)
+                only = arg.substr(12);
+            else if(arg.rfind("--seed=", 0) == 0)
+                gif.Seed = stoull(arg.substr(7));
+            else if(arg.rfind("--max-frames=", 0) == 0)
+                gif.MaxFrames = stoul(arg.substr(13));
+            else if(arg == "--no-loop")
+                gif.Loop = false;
+            else if(arg.rfind("--fps=", 0) == 0)
+                y4m.FrameRate = stoul(arg.substr(6));
+            else if(arg.rfind("--background=", 0) == 0)
+                y4m.Background = stoul(arg.substr(13), nullptr, 16);
+            else if(arg.rfind("--sample-rate=", 0) == 0)
+                y4m.SampleRate = stoul(arg.substr(14));
+            else if(arg.rfind("--jobs=", 0) == 0)
+                jobs = stoul(arg.substr(7));
+            else if(arg.rfind("--", 0) == 0 || !input.empty())
+                ok = false;
+            else
+                input = arg;
+        }
+        catch(exception &)
+        {
+            ok = false;
+        }
+        if(!ok)
+        {
+            cerr << "Unknown option: " << arg << endl;
+            return 2;
+        }
+    }
+
+    if(input.empty())
+    {
+        cerr << "usage: " << argv[0] << " [--format=gif|y4m] [--output=dir] [--animation=name] [--seed=N]" << endl
+             << "       [--max-frames=N] [--no-loop] [--fps=N] [--background=RRGGBB]" << endl
+             << "       [--sample-rate=N] [--jobs=N] file.acs" << endl;
+        return 2;
+    }
+
+    libacsfile::Character character;
+    if(!character.Load(input))
+    {
+        cerr << input << ": " << character.GetLastError() << endl;
+        return 1;
+    }
+
+    vector<pair<string, libacsfile::Animation*>> animations;
+    for(auto &[name, animation] : character.Animations())
+        if(only.empty() || name == only)
+            animations.emplace_back(name, animation);
+    if(animations.empty())
+    {
+        cerr << input << ": no animation " << only << endl;
+        return 1;
+    }
+
+    error_code ec;
+    fs::create_directories(output, ec);
+    if(ec)
+    {
+        cerr << output.string() << ": " << ec.message() << endl;
+        return 1;
+    }
+
+    // one animation per worker, its frames are encoded on that worker too,
+    // unless there is a single animation to spread over all of them
+    if(jobs == 0)
+        jobs = max(1u, thread::hardware_concurrency());
+    gif.Threads = animations.size() == 1 ? jobs : 1;
+    y4m.Seed = gif.Seed;
+    y4m.MaxFrames = gif.MaxFrames;
+    jobs = min<unsigned int>(jobs, animations.size());
+
+    const auto start = chrono::steady_clock::now();
+    atomic<size_t> next{0};
+    atomic<unsigned int> failures{0};
+    mutex consoleLock;
+    auto worker = [&]() {
+        for(size_t i = next++; i < animations.size(); i = next++)
+        {
+            fs::path file = output / FileName(animations[i].first);
+            bool ok;
+            if(video)
+            {
+                fs::path wav = file;
+                file += ".y4m";
+                wav += ".wav";
+                ok = libacsrender::WriteVideo(character, *animations[i].second, file, wav, y4m);
+            }
+            else
+            {
+                file += ".gif";
+                ok = libacsrender::WriteGIF(character, *animations[i].second, file, gif);
+            }
+            lock_guard<mutex> lock(consoleLock);
+            if(ok)
+                cout << file.string() << endl;
+            else
+            {
+                cerr << file.string() << ": cannot write" << endl;
+                ++failures;
+            }
+        }
+    };
+
+    vector<thread> pool;
+    for(unsigned int i = 1; i < jobs; ++i)
+        pool.emplace_back(worker);
+    worker();
+    for(auto &t : pool)
+        t.join();
+
+    cerr << animations.size() << " animations in "
+         << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+    return failures ? 1 : 0;
+}
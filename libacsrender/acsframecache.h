@@ -0,0 +1,59 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "acsrender.h"
+
+namespace libacsrender {
+    class FrameCachePrivate;
+
+    // Fully composited frames of one character, keyed by frame (which
+    // stands for its animation and index) and mouth overlay. Bounded by
+    // bytes, the least recently used frame is evicted first. A frame that
+    // only swaps a delta image into the frame handed out before it is
+    // made from that frame's pixels. Thread-safe.
+    class FrameCache {
+    public:
+        typedef std::shared_ptr<const std::vector<uint32_t>> Pixels;
+        enum {
+            NoMouth = -1
+        };
+        struct Counters {
+            uint64_t Hits = 0;
+            uint64_t Misses = 0;
+            uint64_t Evictions = 0;
+            uint64_t Prefetches = 0;    // frames composited by Prefetch()
+            // frames composited from the one before, see Frame::FollowsByDelta
+            uint64_t Deltas = 0;
+            size_t Bytes = 0;
+            size_t Frames = 0;
+        };
+
+        FrameCache(const Compositor &compositor, size_t maxBytes);
+        ~FrameCache();
+        FrameCache(const FrameCache&) = delete;
+        FrameCache& operator=(const FrameCache&) = delete;
+
+        // The composited frame, compositing it on a miss. The pixels are
+        // tightly packed in the compositor's format and stay valid for as
+        // long as the caller holds on to them, even once evicted.
+        Pixels Get(const libacsfile::Frame *frame, int mouth = NoMouth);
+        // Composites the frame if it is not cached yet, without touching
+        // the hit/miss counters or the recency of cached frames
+        void Prefetch(const libacsfile::Frame *frame, int mouth = NoMouth);
+        bool Contains(const libacsfile::Frame *frame, int mouth = NoMouth) const;
+
+        Counters Stats() const;
+        size_t MaxBytes() const;
+        void SetMaxBytes(size_t maxBytes);
+        void Clear();
+    private:
+        libacsrender::FrameCachePrivate *p = nullptr;
+    };
+}
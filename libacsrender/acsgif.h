@@ -0,0 +1,35 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <filesystem>
+
+#include "acsfile.h"
+
+namespace libacsrender {
+    struct GifOptions {
+        // Seeds the branch choices, the same seed writes the same GIF
+        uint64_t Seed = 0;
+        // Frames written at most, animations that branch back play forever
+        unsigned int MaxFrames = 256;
+        bool Loop = true;
+        // Frame workers, 0 uses every available core
+        unsigned int Threads = 0;
+    };
+
+    // Frame indexes the animation shows from its first frame, played by
+    // an AnimationPlayer seeded with seed until the animation ends.
+    std::vector<uint16_t> PlaybackSequence(const libacsfile::Animation &animation, uint64_t seed,
+                                           unsigned int maxFrames);
+
+    // Animated GIF over the character palette. Frames are composited as
+    // palette indexes, so there is no quantization, and each frame is LZW
+    // compressed on its own worker. Delays are the frame durations.
+    std::vector<uint8_t> EncodeGIF(const libacsfile::Character &character, const libacsfile::Animation &animation,
+                                   const GifOptions &options = GifOptions());
+    bool WriteGIF(const libacsfile::Character &character, const libacsfile::Animation &animation,
+                  const std::filesystem::path &file, const GifOptions &options = GifOptions());
+}
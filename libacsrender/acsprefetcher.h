@@ -0,0 +1,47 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#pragma once
+
+#include <cstdint>
+
+#include "acsfile.h"
+#include "acsframecache.h"
+
+namespace libacsrender {
+    class FramePrefetcherPrivate;
+
+    struct PrefetchOptions {
+        // Frames ahead of the shown one to follow
+        unsigned int Depth = 3;
+        // Frames less likely than this to be reached (in percent, over
+        // every branch on the way) are left to be composited on demand
+        uint16_t MinProbability = 10;
+    };
+
+    // Composites the frames likely to follow the shown one into a
+    // FrameCache on a background thread, so they are ready by the time
+    // the shown frame's Duration() has elapsed. Successors follow playback:
+    // the exit frame while a stop is pending, else the branch targets by
+    // Probability() and the next frame with what is left, frames without
+    // images are passed through.
+    class FramePrefetcher {
+    public:
+        explicit FramePrefetcher(FrameCache &cache, const PrefetchOptions &options = PrefetchOptions());
+        // Waits for the frame being composited, drops the rest
+        ~FramePrefetcher();
+        FramePrefetcher(const FramePrefetcher&) = delete;
+        FramePrefetcher& operator=(const FramePrefetcher&) = delete;
+
+        // Frame index of animation is being shown, replaces whatever is
+        // still queued from the previous frame. The animation has to
+        // outlive the prefetcher.
+        void Schedule(const libacsfile::Animation *animation, uint16_t frame, bool stopping = false);
+        void Cancel();
+
+        PrefetchOptions Options() const;
+        void SetOptions(const PrefetchOptions &options);
+    private:
+        libacsrender::FramePrefetcherPrivate *p = nullptr;
+    };
+}
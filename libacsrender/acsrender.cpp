@@ -0,0 +1,92 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#include "acsrender.h"
+#include "acstrace.h"
+
+#include <vector>
+#include <cstring>
+
+using namespace libacsrender;
+using namespace std;
+
+namespace libacsrender {
+    class CompositorPrivate {
+    private:
+        friend class Compositor;
+        uint16_t Width{};
+        uint16_t Height{};
+        Compositor::PixelFormat Format{};
+        vector<uint32_t> Palette;
+    };
+}
+
+Compositor::Compositor(const libacsfile::Character &character, PixelFormat format)
+    :p(new CompositorPrivate)
+{
+    p->Width = character.Width();
+    p->Height = character.Height();
+    p->Format = format;
+    p->Palette = character.ARGBPalette();
+    // RGBA bytes read as a little endian word keep alpha in the top byte,
+    // so the compositing kernels work on both formats unchanged
+    if(format == RGBA8888)
+        for(uint32_t &argb : p->Palette)
+            argb = (argb & 0xFF00FF00u) | ((argb >> 16) & 0xFFu) | ((argb & 0xFFu) << 16);
+}
+
+Compositor::~Compositor()
+{
+    delete p;
+}
+
+uint16_t Compositor::Width() const
+{
+    return p->Width;
+}
+
+uint16_t Compositor::Height() const
+{
+    return p->Height;
+}
+
+Compositor::PixelFormat Compositor::Format() const
+{
+    return p->Format;
+}
+
+size_t Compositor::BufferSize() const
+{
+    return static_cast<size_t>(p->Width) * p->Height * sizeof(uint32_t);
+}
+
+const uint32_t *Compositor::Palette() const
+{
+    return p->Palette.data();
+}
+
+void Compositor::Composite(const libacsfile::Frame *frame, uint32_t *target, int stride) const
+{
+    ACS_TRACE_SCOPE("render", "Composite");
+    frame->Composite(target, p->Width, p->Height, stride ? stride : p->Width, p->Palette.data());
+}
+
+void Compositor::Composite(const libacsfile::Frame *frame, libacsfile::Overlay::Type mouth,
+                           uint32_t *target, int stride) const
+{
+    ACS_TRACE_SCOPE("render", "Composite");
+    frame->Composite(target, p->Width, p->Height, stride ? stride : p->Width, p->Palette.data(),
+                     frame->MouthOverlay(mouth));
+}
+
+void Compositor::CompositeDelta(const libacsfile::Frame *frame, const uint32_t *previous,
+                                uint32_t *target, int stride) const
+{
+    ACS_TRACE_SCOPE("render", "CompositeDelta");
+    if(!stride)
+        stride = p->Width;
+    for(int row = 0; row < p->Height; ++row)
+        memcpy(target + static_cast<ptrdiff_t>(row) * stride, previous + static_cast<ptrdiff_t>(row) * stride,
+               p->Width * sizeof(uint32_t));
+    frame->CompositeDelta(target, p->Width, p->Height, stride, p->Palette.data());
+}
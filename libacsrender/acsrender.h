@@ -0,0 +1,52 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "acsfile.h"
+
+namespace libacsrender {
+    class CompositorPrivate;
+
+    // Composites the frames of one character into caller-provided buffers
+    // of character size, without Qt. The compositor only reads the
+    // character after construction and never allocates while drawing, so
+    // one instance can be shared by any number of threads.
+    class Compositor {
+    public:
+        enum PixelFormat {
+            ARGB32,     // 0xAARRGGBB words, as QImage::Format_ARGB32_Premultiplied
+            RGBA8888    // R, G, B, A bytes
+        };
+        explicit Compositor(const libacsfile::Character &character, PixelFormat format = ARGB32);
+        ~Compositor();
+        Compositor(const Compositor&) = delete;
+        Compositor& operator=(const Compositor&) = delete;
+
+        uint16_t Width() const;
+        uint16_t Height() const;
+        PixelFormat Format() const;
+        // Bytes in a tightly packed buffer
+        size_t BufferSize() const;
+        // Palette in the output format, the transparent index is all zero
+        const uint32_t* Palette() const;
+
+        // Clears target and draws frame into it. Stride is in pixels,
+        // 0 means Width(). Pixels are premultiplied, alpha is 0 or 255.
+        void Composite(const libacsfile::Frame *frame, uint32_t *target, int stride = 0) const;
+        // Also draws the frame's mouth overlay of the given type, if it has one
+        void Composite(const libacsfile::Frame *frame, libacsfile::Overlay::Type mouth,
+                       uint32_t *target, int stride = 0) const;
+        // Draws frame into target from previous, the pixels of the frame
+        // before it composited without a mouth at the same stride, by
+        // copying them and redrawing the dirty rectangle. Only valid when
+        // frame->FollowsByDelta() that frame, see Frame::CompositeDelta.
+        void CompositeDelta(const libacsfile::Frame *frame, const uint32_t *previous,
+                            uint32_t *target, int stride = 0) const;
+    private:
+        libacsrender::CompositorPrivate *p = nullptr;
+    };
+}
@@ -0,0 +1,49 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <filesystem>
+
+#include "acsfile.h"
+
+namespace libacsrender {
+    struct VideoOptions {
+        // Seeds the branch choices, see PlaybackSequence()
+        uint64_t Seed = 0;
+        // Animation frames played at most
+        unsigned int MaxFrames = 256;
+        // Output frames per second
+        unsigned int FrameRate = 30;
+        // 0xRRGGBB behind transparent pixels, green keys out easily
+        uint32_t Background = 0x00FF00;
+        // Mixdown rate, 0 takes the highest rate among the sounds played
+        uint32_t SampleRate = 0;
+    };
+
+    struct VideoStats {
+        uint32_t VideoFrames = 0;
+        // Distinct frames converted, the others repeat the previous one
+        uint32_t Converted = 0;
+        uint32_t Sounds = 0;
+        uint64_t Milliseconds = 0;
+        uint32_t SampleRate = 0;
+        uint16_t Channels = 0;
+    };
+
+    // Plays the animation on a virtual clock at a fixed frame rate and
+    // streams it as Y4M (4:2:0, BT.601 studio range) along with a 16-bit
+    // WAV of the frame sounds mixed at the times their frames show. Only
+    // one frame is held at a time and both headers are written up front,
+    // so either stream can be a pipe. A null stream is skipped. When the
+    // sounds outlast the animation the last frame is held until they end.
+    bool EncodeVideo(const libacsfile::Character &character, const libacsfile::Animation &animation,
+                     std::ostream *y4m, std::ostream *wav, const VideoOptions &options = VideoOptions(),
+                     VideoStats *stats = nullptr);
+    // Either path may be empty to skip that stream
+    bool WriteVideo(const libacsfile::Character &character, const libacsfile::Animation &animation,
+                    const std::filesystem::path &y4m, const std::filesystem::path &wav,
+                    const VideoOptions &options = VideoOptions(), VideoStats *stats = nullptr);
+}
@@ -0,0 +1,262 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Decodes the GIFs written for generated characters with a strict LZW
+// decoder and checks every frame against Frame::Composite.
+
+#include <string>
+#include <map>
+#include <vector>
+
+#include "acsfile.h"
+#include "acsgenerator.h"
+#include "acsgif.h"
+#include "acs_test.h"
+
+using namespace std;
+using namespace libacsfile;
+using namespace libacsrender;
+
+namespace {
+    struct DecodedFrame {
+        int Left = 0, Top = 0, Width = 0, Height = 0;
+        uint16_t Delay = 0;
+        int Transparent = -1;
+        vector<uint8_t> Pixels;
+    };
+
+    // Reads the sub-blocks at pos, leaves pos after the terminator
+    bool ReadSubBlocks(const vector<uint8_t> &gif, size_t &pos, vector<uint8_t> &data)
+    {
+        while(pos < gif.size())
+        {
+            const uint8_t length = gif[pos++];
+            if(length == 0)
+                return true;
+            if(pos + length > gif.size())
+                return false;
+            data.insert(data.end(), gif.begin() + pos, gif.begin() + pos + length);
+            pos += length;
+        }
+        return false;
+    }
+}
+
+// GIF LZW with 8-bit roots. Fails on a code the table does not hold yet,
+// on data running out before the end code and on bytes after it.
+static bool DecodeLZW(const vector<uint8_t> &data, size_t count, vector<uint8_t> &pixels, string &error)
+{
+    const uint32_t clearCode = 256, endCode = 257;
+    uint16_t prefix[4096];
+    uint8_t suffix[4096], first[4096];
+    for(uint32_t i = 0; i < 256; ++i)
+        suffix[i] = first[i] = static_cast<uint8_t>(i);
+
+    int codeSize = 9;
+    uint32_t next = endCode + 1;
+    int32_t previous = -1;
+    size_t bit = 0;
+    vector<uint8_t> stack;
+    for(;;)
+    {
+        if(bit + codeSize > data.size() * 8)
+        {
+            error = "data ends without an end code";
+            return false;
+        }
+        uint32_t code = 0;
+        for(int i = 0; i < codeSize; ++i, ++bit)
+            code |= ((data[bit / 8] >> (bit % 8)) & 1u) << i;
+
+        if(code == clearCode)
+        {
+            codeSize = 9;
+            next = endCode + 1;
+            previous = -1;
+            continue;
+        }
+        if(code == endCode)
+            break;
+        if(code > next || (code == next && previous < 0))
+        {
+            error = "invalid code " + to_string(code) + " (size " + to_string(codeSize)
+                  + ", table " + to_string(next) + ")";
+            return false;
+        }
+
+        const uint8_t head = code == next ? first[previous] : first[code];
+        stack.clear();
+        if(code == next)
+            stack.push_back(head);
+        for(uint32_t c = code == next ? static_cast<uint32_t>(previous) : code;; c = prefix[c])
+        {
+            stack.push_back(suffix[c]);
+            if(c < 256)
+                break;
+        }
+        pixels.insert(pixels.end(), stack.rbegin(), stack.rend());
+
+        if(previous >= 0 && next < 4096)
+        {
+            prefix[next] = static_cast<uint16_t>(previous);
+            suffix[next] = head;
+            first[next] = first[previous];
+            if(++next == (1u << codeSize) && codeSize < 12)
+                ++codeSize;
+        }
+        previous = static_cast<int32_t>(code);
+    }
+
+    if((bit + 7) / 8 != data.size())
+    {
+        error = to_string(data.size() - (bit + 7) / 8) + " bytes after the end code";
+        return false;
+    }
+    if(pixels.size() != count)
+    {
+        error = to_string(pixels.size()) + " pixels of " + to_string(count);
+        return false;
+    }
+    return true;
+}
+
+static bool DecodeGIF(const vector<uint8_t> &gif, int &width, int &height, vector<DecodedFrame> &frames,
+                      string &error)
+{
+    if(gif.size() < 13 + 768 || string(gif.begin(), gif.begin() + 6) != "GIF89a" || gif[10] != 0xF7)
+    {
+        error = "no GIF89a header with a 256 color table";
+        return false;
+    }
+    width = gif[6] | gif[7] << 8;
+    height = gif[8] | gif[9] << 8;
+
+    size_t pos = 13 + 768;
+    DecodedFrame frame;
+    while(pos < gif.size())
+    {
+        const uint8_t kind = gif[pos++];
+        if(kind == 0x3B)
+            return pos == gif.size();
+        if(kind == 0x21 && pos < gif.size())
+        {
+            const uint8_t label = gif[pos++];
+            vector<uint8_t> data;
+            if(!ReadSubBlocks(gif, pos, data))
+                break;
+            if(label == 0xF9 && data.size() == 4)
+            {
+                frame.Delay = static_cast<uint16_t>(data[1] | data[2] << 8);
+                frame.Transparent = data[0] & 1 ? data[3] : -1;
+            }
+        }
+        else if(kind == 0x2C && pos + 10 <= gif.size())
+        {
+            frame.Left = gif[pos] | gif[pos + 1] << 8;
+            frame.Top = gif[pos + 2] | gif[pos + 3] << 8;
+            frame.Width = gif[pos + 4] | gif[pos + 5] << 8;
+            frame.Height = gif[pos + 6] | gif[pos + 7] << 8;
+            pos += 9;
+            if(pos + 1 >= gif.size() || gif[pos] != 8)
+                break;
+            ++pos;
+            vector<uint8_t> data;
+            if(!ReadSubBlocks(gif, pos, data))
+                break;
+            if(!DecodeLZW(data, static_cast<size_t>(frame.Width) * frame.Height, frame.Pixels, error))
+            {
+                error = "frame " + to_string(frames.size()) + ": " + error;
+                return false;
+            }
+            frames.push_back(move(frame));
+            frame = DecodedFrame();
+        }
+        else
+            break;
+    }
+    error = "malformed block at " + to_string(pos);
+    return false;
+}
+
+static void CheckAnimations(const string &preset)
+{
+    Character character;
+    const string path = WriteTemporary("libacsrender_test_gif_" + preset + ".acs",
+                                       GenerateCharacter(GeneratorPreset(preset)));
+    if(!character.Load(path))
+    {
+        CHECK(false, preset + ": load: " + character.GetLastError());
+        return;
+    }
+    filesystem::remove(path);
+
+    const vector<uint32_t> palette = character.ARGBPalette();
+    const int width = character.Width(), height = character.Height();
+    vector<uint32_t> expected(static_cast<size_t>(width) * height);
+    for(auto &[name, animation] : character.Animations())
+    {
+        const string which = preset + ": " + name;
+        GifOptions options;
+        options.Seed = 5;
+        options.MaxFrames = 64;
+        options.Threads = 1;
+        int gifWidth = 0, gifHeight = 0;
+        vector<DecodedFrame> decoded;
+        string error;
+        if(!DecodeGIF(EncodeGIF(character, *animation, options), gifWidth, gifHeight, decoded, error))
+        {
+            CHECK(false, which + ": " + error);
+            continue;
+        }
+        CHECK(gifWidth == width && gifHeight == height, which + ": screen size");
+
+        // the frames EncodeGIF shows, a repeat only lengthens the one before
+        const map<uint16_t, Frame*> frames = animation->Frames();
+        vector<pair<const Frame*, uint32_t>> shown;
+        for(uint16_t index : PlaybackSequence(*animation, options.Seed, options.MaxFrames))
+        {
+            const Frame *frame = frames.at(index);
+            if(!shown.empty() && shown.back().first == frame)
+                shown.back().second += frame->Duration();
+            else
+                shown.push_back({ frame, frame->Duration() });
+        }
+        CHECK(decoded.size() == shown.size(), which + ": " + to_string(decoded.size()) + " frames, expected "
+                                                  + to_string(shown.size()));
+
+        for(size_t i = 0; i < decoded.size() && i < shown.size(); ++i)
+        {
+            const DecodedFrame &gif = decoded[i];
+            const string at = which + " frame " + to_string(i);
+            CHECK(gif.Delay == shown[i].second && gif.Transparent == character.TransparentIndex(), at + " control");
+            CHECK(gif.Left + gif.Width <= width && gif.Top + gif.Height <= height, at + " outside the screen");
+            if(gif.Left + gif.Width > width || gif.Top + gif.Height > height)
+                continue;
+
+            // every frame restores to the background, so it stands alone
+            shown[i].first->Composite(expected.data(), width, height, width, palette.data());
+            bool same = true;
+            for(int y = 0; y < height && same; ++y)
+                for(int x = 0; x < width; ++x)
+                {
+                    int index = gif.Transparent;
+                    if(x >= gif.Left && x < gif.Left + gif.Width && y >= gif.Top && y < gif.Top + gif.Height)
+                        index = gif.Pixels[static_cast<size_t>(y - gif.Top) * gif.Width + (x - gif.Left)];
+                    const uint32_t argb = index == gif.Transparent ? 0 : palette[index];
+                    if(argb != expected[static_cast<size_t>(y) * width + x])
+                    {
+                        same = false;
+                        break;
+                    }
+                }
+            CHECK(same, at + " pixels");
+        }
+    }
+}
+
+int main()
+{
+    for(const char *preset : { "small", "default", "large" })
+        CheckAnimations(preset);
+    return TestResult();
+}
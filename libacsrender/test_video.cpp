@@ -0,0 +1,151 @@
+// libacsrender - Authored in 2025 by ~cat - SOSUMI BONZIBROS
+// The code is Public Domain
+
+// Decodes the Y4M streams written for generated characters and checks
+// every plane against a floating point BT.601 conversion of
+// Frame::Composite, for even, odd and block sized widths.
+
+#include <cmath>
+#include <string>
+#include <map>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+#include "acsfile.h"
+#include "acsgenerator.h"
+#include "acsgif.h"
+#include "acsvideo.h"
+#include "acs_test.h"
+
+using namespace std;
+using namespace libacsfile;
+using namespace libacsrender;
+
+// Largest distance from the exact value, the integer coefficients and
+// rounding must stay within one step
+#define VIDEO_TEST_TOLERANCE    1.0
+
+// Studio range luma and chroma of one RGB pixel
+static void ReferenceYUV(double r, double g, double b, double &y, double &u, double &v)
+{
+    y = 16 + (65.481 * r + 128.553 * g + 24.966 * b) / 255;
+    u = 128 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255;
+    v = 128 + (112.0 * r - 93.786 * g - 18.214 * b) / 255;
+}
+
+static void CheckVideo(const string &name, GeneratorOptions generator, uint32_t background)
+{
+    Character character;
+    const string path = WriteTemporary("libacsrender_test_video_" + name + ".acs", GenerateCharacter(generator));
+    if(!character.Load(path))
+    {
+        CHECK(false, name + ": load: " + character.GetLastError());
+        return;
+    }
+    filesystem::remove(path);
+
+    const vector<uint32_t> palette = character.ARGBPalette();
+    const int width = character.Width(), height = character.Height();
+    const int paddedWidth = (width + 1) & ~1, paddedHeight = (height + 1) & ~1;
+    const size_t chromaSize = static_cast<size_t>(paddedWidth / 2) * (paddedHeight / 2);
+    vector<uint32_t> argb(static_cast<size_t>(width) * height);
+    for(auto &[animationName, animation] : character.Animations())
+    {
+        const string which = name + ": " + animationName;
+        VideoOptions options;
+        options.Seed = 3;
+        options.MaxFrames = 32;
+        options.FrameRate = 25;
+        options.Background = background;
+        ostringstream stream;
+        if(!EncodeVideo(character, *animation, &stream, nullptr, options))
+        {
+            CHECK(false, which + ": encode");
+            continue;
+        }
+        const string y4m = stream.str();
+
+        const size_t headerEnd = y4m.find('\n');
+        CHECK(headerEnd != string::npos && y4m.compare(0, 10, "YUV4MPEG2 ") == 0, which + ": header");
+        if(headerEnd == string::npos)
+            continue;
+
+        // the frame showing at each output instant, as EncodeVideo picks it
+        const map<uint16_t, Frame*> frames = animation->Frames();
+        const vector<uint16_t> sequence = PlaybackSequence(*animation, options.Seed, options.MaxFrames);
+        vector<uint64_t> starts(sequence.size() + 1, 0);
+        for(size_t i = 0; i < sequence.size(); ++i)
+            starts[i + 1] = starts[i] + static_cast<uint64_t>(frames.at(sequence[i])->Duration()) * 10;
+        const uint64_t count = max<uint64_t>(1, (starts.back() * options.FrameRate + 999) / 1000);
+        const size_t frameBytes = 6 + static_cast<size_t>(width) * height + 2 * chromaSize;
+        CHECK(y4m.size() == headerEnd + 1 + count * frameBytes, which + ": " + to_string(y4m.size())
+                                                                   + " bytes, expected "
+                                                                   + to_string(count) + " frames");
+        if(y4m.size() != headerEnd + 1 + count * frameBytes)
+            continue;
+
+        size_t shown = 0;
+        double worst = 0;
+        for(uint64_t n = 0; n < count; ++n)
+        {
+            while(shown + 1 < sequence.size() && starts[shown + 1] * options.FrameRate <= n * 1000)
+                ++shown;
+            const string at = which + " frame " + to_string(n);
+            const char *data = y4m.data() + headerEnd + 1 + n * frameBytes;
+            CHECK(string(data, 6) == "FRAME\n", at + " marker");
+            const uint8_t *luma = reinterpret_cast<const uint8_t*>(data + 6);
+            const uint8_t *u = luma + static_cast<size_t>(width) * height, *v = u + chromaSize;
+
+            // odd sizes repeat the last row and column
+            frames.at(sequence[shown])->Composite(argb.data(), width, height, width, palette.data());
+            vector<double> ys(static_cast<size_t>(paddedWidth) * paddedHeight), us(ys.size()), vs(ys.size());
+            for(int row = 0; row < paddedHeight; ++row)
+                for(int col = 0; col < paddedWidth; ++col)
+                {
+                    uint32_t pixel = argb[static_cast<size_t>(min(row, height - 1)) * width + min(col, width - 1)];
+                    if(!(pixel >> 24))
+                        pixel = background;
+                    const size_t i = static_cast<size_t>(row) * paddedWidth + col;
+                    ReferenceYUV((pixel >> 16) & 0xFF, (pixel >> 8) & 0xFF, pixel & 0xFF, ys[i], us[i], vs[i]);
+                }
+
+            for(int row = 0; row < height; ++row)
+                for(int col = 0; col < width; ++col)
+                {
+                    const double expected = ys[static_cast<size_t>(row) * paddedWidth + col];
+                    const int got = luma[static_cast<size_t>(row) * width + col];
+                    worst = max(worst, fabs(got - expected));
+                }
+            for(int row = 0; row < paddedHeight / 2; ++row)
+                for(int col = 0; col < paddedWidth / 2; ++col)
+                {
+                    double eu = 0, ev = 0;
+                    for(int k = 0; k < 4; ++k)
+                    {
+                        const size_t i = static_cast<size_t>(2 * row + k / 2) * paddedWidth + 2 * col + k % 2;
+                        eu += us[i] / 4;
+                        ev += vs[i] / 4;
+                    }
+                    const size_t i = static_cast<size_t>(row) * (paddedWidth / 2) + col;
+                    worst = max(worst, fabs(u[i] - eu));
+                    worst = max(worst, fabs(v[i] - ev));
+                }
+        }
+        CHECK(worst < VIDEO_TEST_TOLERANCE, which + ": off by " + to_string(worst) + " from the reference");
+    }
+}
+
+int main()
+{
+    GeneratorOptions odd = GeneratorPreset("small");
+    odd.Width = 75;
+    odd.Height = 51;
+    GeneratorOptions wide = GeneratorPreset("default");
+    wide.Width = 144;
+
+    CheckVideo("small", GeneratorPreset("small"), 0x00FF00);
+    CheckVideo("odd", odd, 0x336699);
+    CheckVideo("wide", wide, 0xFFFFFF);
+    return TestResult();
+}